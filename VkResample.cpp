@@ -13,9 +13,23 @@
 #include <array>
 #include <iostream>
 #include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <complex>
+#include <functional>
+#if defined(VKRESAMPLE_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 #include "vkFFT.h"
 #include "vulkan/vulkan.h"
 #include "half.hpp"
+#include "VkResampleCPU.h"
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image.h"
@@ -28,6 +42,11 @@ typedef half half2[2];
 
 const bool enableValidationLayers = false;
 
+typedef struct {
+	VkFFTStagingRing ring;
+	std::mutex mutex;//guards the ring
+	std::condition_variable condition;//signaled when an allocation is released
+} VkResampleStaging;//persistently mapped staging memory shared by all threads
 typedef struct {
 	VkInstance instance;//a connection between the application and the Vulkan library 
 	VkPhysicalDevice physicalDevice;//a handle for the graphics card used in the application
@@ -36,26 +55,56 @@ typedef struct {
 	VkDevice device;//a logical device, interacting with physical device
 	VkDebugUtilsMessengerEXT debugMessenger;//extension for debugging
 	uint32_t queueFamilyIndex;//if multiple queues are available, specify the used one
+	uint32_t timestampValidBits;//number of valid bits in timestamps written by the queue, 0 - timestamps are not supported
 	VkQueue queue;//a place, where all operations are submitted
+	uint32_t transferQueueFamilyIndex;//transfer-only queue family, equal to queueFamilyIndex if the device has none
+	VkQueue transferQueue;//queue of the transfer-only family for staging copies concurrent with compute, VK_NULL_HANDLE if the device has none
 	VkCommandPool commandPool;//an opaque objects that command buffer memory is allocated from
 	VkFence fence;//a vkGPU->fence used to synchronize dispatches
 	uint32_t device_id;//an id of a device, reported by Vulkan device list
 	std::vector<const char*> enabledDeviceExtensions;
+	VkFFTShaderCache* shaderCache;//optional on-disk SPIR-V and pipeline cache, 0 if disabled
+	std::mutex* queueMutex;//guards submits to the queue, if it is shared between threads
+	std::mutex* transferQueueMutex;//guards submits to the transfer queue
+	VkResampleStaging* staging;//staging ring used for transfers, 0 - staging buffer is allocated for each transfer
+	VkFFTMemoryAllocator* memoryAllocator;//block sub-allocator all buffers of the device are bound to
 } VkGPU;//an example structure containing Vulkan primitives
 typedef struct {
 	char* png_input_name;
 	char* png_output_name;
 	char* ifolder_prefix;
 	char* ofolder_prefix;
-	float upscale;
+	float upscaleX;
+	float upscaleY;
+	uint32_t outputWidth;//-W and -H target size, 0 - input size multiplied by the upscale factor
+	uint32_t outputHeight;
 	uint32_t fileUpload;
 	uint32_t precision;
 	uint32_t numIter;
 	uint32_t numFiles;
 	uint32_t device_id;
+	uint32_t numDevices;//-d list: batched mode shards the files across deviceIds[0..numDevices - 1], one context per device
+	uint32_t deviceIds[16];
 	float sharpenConst;
 	uint32_t numThreads;
 	uint32_t threadId;
+	uint32_t numBuffers;
+	char* cacheDir;
+	uint32_t shiftPass;
+	uint32_t batchSize;//number of images packed in one buffer set, 0 - chosen from available VRAM
+	uint32_t batchSweep;
+	uint32_t timestamps;
+	uint32_t validate;
+	uint32_t backend;//0 - Vulkan, 1 - CPU
+	uint32_t maxVRAM;//VRAM budget of all buffer sets in MB, 0 - half of the largest device local heap
+	uint32_t tileCompare;
+	uint32_t transform;//0 - FFT, 1 - DCT
+	uint32_t color;//0 - RGB, 1 - YCbCr: only luma is resampled with FFT, chroma is upscaled bilinearly
+	uint32_t padMode;//sizes VkFFT can not transform are padded: 0 - to the nearest supported size, 1 - to the Bluestein convolution length, used by -padbench
+	uint32_t padBenchmark;
+	uint32_t singleQueue;//staging copies use the compute queue even if the device has a transfer-only queue family
+	uint32_t recordMode;//0 - submits of a buffer set are recorded once and replayed, 1 - recorded again before every submit, used by -recordbench
+	uint32_t recordBenchmark;
 }VkResampleConfiguration;
 const char validationLayers[28] = "VK_LAYER_KHRONOS_validation";
 
@@ -85,10 +134,181 @@ typedef struct {
 	VkBuffer* outputBuffer;
 	//VkDeviceMemory* outputBufferDeviceMemory;
 	uint32_t numCoordinates;
+	uint32_t imageSize[3];//width, height and number of channels of the interleaved image, used by unpack and pack shaders
+	uint32_t bitDepth;//8 or 16 bits per sample of the interleaved image
 	uint32_t precision; //0-single, 1-double, 2-half
 	uint32_t r2c;
+	uint32_t tileSize[2];//tiled mode: size of one upscaled tile in the FFT buffer
+	uint32_t tileStep[2];//tiled mode: distance between neighbouring tiles, 0 - whole images are processed
+	uint32_t numTiles;//tiles in one row of tiles
+	uint32_t ringHeight;//rows of the blend accumulator, pack reads it instead of the inverse FFT result if not 0
+	uint32_t outputOffset;//in uints
+	uint32_t pushConstantsSize;//in bytes, 0 - shader has no push constants
+	uint32_t pushConstants[4];
+	uint32_t dct;//DCT mode: unpack and pack convert images to and from the even-odd order, whose FFT gives the DCT
+	uint32_t fftSize[2];//DCT spectrum: size of the inverse FFT
+	uint32_t color;//YCbCr mode: FFT buffers hold only the luma plane of each image, unpack writes and pack reads the chroma planes in auxBuffer
+	uint32_t chromaSize[2];//YCbCr mode: size of the chroma planes, the mirror-padded input size
+	VkDeviceSize auxBufferSize;
+	VkBuffer* auxBuffer;//optional third buffer, bound if not NULL
 	char* code0;
 } VkShiftApplication;//sample shader specific data
+typedef struct {
+	VkGPU vkGPU;//view of the shared device with its own command pool and fence
+	VkDeviceSize inputBufferSize;
+	VkDeviceSize bufferSize;
+	VkBuffer inputBuffer;
+	VkBuffer buffer;
+	VkBuffer tempBuffer;
+	VkFFTMemoryAllocation fftAllocation;//one range for inputBuffer, buffer and tempBuffer, placed in it by planAliasedRanges
+	VkBuffer* outputBuffer;//buffer with the upscaled image, points to buffer or tempBuffer
+	VkBuffer rgbBuffer;//interleaved 8- or 16-bit image: input before unpack, upscaled image after pack
+	VkFFTMemoryAllocation rgbBufferAllocation;
+	VkBuffer chromaBuffer;//YCbCr mode: Cb and Cr planes of the batch, written by unpack and read by pack
+	VkFFTMemoryAllocation chromaBufferAllocation;
+	VkFFTApplication app_forward;
+	VkFFTApplication app_inverse;
+	VkShiftApplication appShift;
+	VkBool32 performShift;//spectrum is shifted by appShift only if the inverse FFT can not read it split
+	VkShiftApplication appDCT;//DCT mode: converts the forward spectrum to the spectrum of the zero-padded inverse DCT, replaces the shift
+	VkBool32 performDCT;
+	VkShiftApplication appCrop;//downscale: copies the retained band of the spectrum out of place, only if the inverse FFT can not read it cropped
+	VkBool32 performCrop;
+	VkShiftApplication appUnpack;
+	VkShiftApplication appPack;
+	VkBuffer tileBuffer;//tiled mode: blend accumulator
+	VkFFTMemoryAllocation tileBufferAllocation;
+	VkShiftApplication appBlend;//tiled mode: windowed blend of a row of tiles into the accumulator
+	VkQueryPool timestampQueryPool;//timestamps written between stages of one submit, VK_NULL_HANDLE if disabled
+	std::vector<uint32_t> timestampStages;//stage measured between timestamps i and i + 1
+	VkDeviceSize stagingOffset;//staging frame of the buffer set, kept for the whole run so recorded copies stay valid
+	std::vector<VkCommandBuffer> commandBuffers;//recorded submits: the whole batch, or one per row of tiles in tiled mode
+	VkCommandPool transferCommandPool;//transfer queue mode: command pool of the transfer queue family
+	VkCommandBuffer transferCommandBuffers[2];//transfer queue mode: upload and readback of the batch, commandBuffers[0] has only the compute part
+	VkSemaphore uploadSemaphore;//transfer queue mode: signaled by the upload, waited by the compute submit
+	VkSemaphore computeSemaphore;//transfer queue mode: signaled by the compute submit, waited by the readback
+} VkResampleBufferSet;//GPU resources needed to upscale one batch of images
+typedef struct {
+	uint32_t tileSize;//input tiles are tileSize x tileSize pixels
+	uint32_t outputTileSize[2];
+	uint32_t overlap;//input pixels shared by neighbouring tiles
+	uint32_t step;//input distance between neighbouring tiles
+	uint32_t outputStep[2];
+	uint32_t numTiles[2];
+	uint32_t ringHeight;//output rows kept in the blend accumulator
+	VkDeviceSize stripInputSize;//8-bit input rows of one row of tiles
+	VkDeviceSize stripOutputSize;//space for the packed output rows finished by one row of tiles
+	VkDeviceSize tileBufferSize;
+} VkResampleTiling;//images that do not fit the VRAM budget are upscaled in rows of overlapping tiles
+typedef struct {
+	uint32_t size;
+	double sign;//-1 - forward, 1 - inverse
+	std::vector<uint32_t> radix;//radix of each Stockham stage
+	std::vector<std::vector<float>> twiddles;//interleaved twiddles of each stage
+	std::vector<std::vector<float>> roots;//roots of unity of the radix of each stage
+	VkResampleCPUFFTStages stages;//the plan as it is passed to the FFT kernel
+} VkResampleCPUFFTPlan;
+typedef struct {
+	const std::function<void(uint32_t)>* task;
+	uint32_t numTasks;
+	uint32_t nextTask;//first task not taken yet, guarded by the pool mutex
+	uint32_t numFinished;
+} VkResampleCPUJob;//one parallelFor call
+typedef struct {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable workAvailable;
+	std::condition_variable jobFinished;
+	std::vector<VkResampleCPUJob*> jobs;//jobs with tasks not taken yet, in order of submission
+	VkBool32 stop;
+} VkResampleCPUPool;//worker threads of the CPU backend, started with the context and shared by the passes of all images
+typedef struct {
+	VkResampleCPUFFTPlan forwardX;
+	VkResampleCPUFFTPlan forwardY;
+	VkResampleCPUFFTPlan inverseX;
+	VkResampleCPUFFTPlan inverseY;
+	VkResampleCPUFFTKernel kernel;//FFT kernel of the best instruction set the CPU supports
+	uint32_t numThreads;//threads that split the passes of one image
+	VkResampleCPUPool pool;
+	float sharpenConst;
+} VkResampleCPU;//CPU backend plans, used instead of buffer sets
+typedef struct {
+	VkGPU vkGPU;//instance, device and queue shared by all threads
+	VkFFTShaderCache shaderCache;
+	VkFFTMemoryAllocator memoryAllocator;//owns device memory of the buffer sets, plan LUTs and the staging ring
+	std::mutex queueMutex;
+	std::mutex transferQueueMutex;
+	std::mutex poolMutex;
+	std::condition_variable poolCondition;
+	std::vector<VkResampleBufferSet> bufferSets;
+	std::vector<VkResampleBufferSet*> freeBufferSets;//buffer sets not used by any thread
+	std::atomic<uint32_t>* nextFile;//work queue shared by the threads of all devices: index of the next file to be taken
+	uint32_t numFiles;
+	VkResult gpuResult;//first failure of the worker threads: a missing or mismatched file or a failed submit. The run is aborted and returns it
+	std::mutex statsMutex;
+	uint32_t numInFlight;//number of submits the GPU is working on, used to measure GPU busy time
+	std::chrono::system_clock::time_point gpuBusyStart;
+	double gpuBusyTime;
+	double stageTime[4];//total time threads spent in decode, upload, readback and encode stages
+	double recordTime;//CPU time spent recording command buffers of all buffer sets, ms
+	double submitTime;//CPU time spent in vkQueueSubmit, ms
+	uint32_t numSubmits;
+	uint32_t recordMode;
+	uint32_t transferQueue;//upload and readback of whole image mode are submitted to the transfer queue, ownership of rgbBuffer is transferred between the queue families
+	std::vector<std::string> timestampStageNames;//GPU stages measured with timestamps, same for all buffer sets
+	std::vector<std::vector<double>> timestampSamples;//GPU time of each stage in ms, one sample per execution
+	uint32_t numValidationFailures;//images that differ from the CPU reference more than allowed
+	uint32_t validationMaxError;
+	double validationMinPSNR;
+	double validationMinSSIM;
+	uint32_t numProcessedFiles;
+	VkFFTConfiguration forward_configuration;//plan configurations without buffer pointers, same for all buffer sets
+	VkFFTConfiguration inverse_configuration;
+	VkDeviceSize inputBufferSize;
+	VkDeviceSize bufferSize;
+	uint32_t fftRangeStages[3][2];//first and last stage of a submit that use inputBuffer, buffer and tempBuffer: 0 - unpack, 1 - forward FFT, 2 - shift, DCT or crop, 3 - inverse FFT, 4 - pack or blend. First > last if unused
+	VkBool32 forwardUsesTempBuffer;//forward plan is a four step FFT that transposes through tempBuffer
+	VkDeviceSize fftMemorySize;//peak VRAM of inputBuffer, buffer and tempBuffer with the planned aliasing, 256 byte alignment
+	uint32_t batchSize;//number of images transformed by one submit of a buffer set
+	VkDeviceSize rgbInputSize;//size of one interleaved input image
+	VkDeviceSize outputSize;//size of one interleaved upscaled image
+	VkDeviceSize rgbBufferSize;
+	VkDeviceSize chromaBufferSize;//YCbCr mode: Cb and Cr planes of all images in the batch, 0 otherwise
+	uint32_t outputWidth;
+	uint32_t outputHeight;
+	uint32_t resampleWidth;//size the inverse FFT resamples to: the nearest size supported by VkFFT, output is its top-left outputWidth x outputHeight part
+	uint32_t resampleHeight;
+	uint32_t paddedWidth;//size the forward FFT transforms: input is mirror-padded to it, if VkFFT does not support the input size
+	uint32_t paddedHeight;
+	uint32_t outputPitch;//row pitch of the upscaled image in bytes, rows are padded to 4 pixels
+	VkResampleStaging staging;
+	VkDeviceSize stagingFrameSize;//staging space of one batch: input images at offset 0, upscaled images at stagingOutputOffset
+	VkDeviceSize stagingOutputOffset;
+	uint32_t complexSize;
+	uint32_t complexSizeCalc;
+	int width;//resolution of all images in the batch
+	int height;
+	int channels;
+	uint32_t planes;//planes transformed by the FFT per image: channels, or luma and alpha in YCbCr mode
+	uint32_t bitDepth;//8 or 16 bits per sample of the input and upscaled images
+	uint32_t pixelSize;//bytes of one interleaved pixel
+	uint32_t color;//YCbCr mode is used, grayscale images have no chroma and are transformed as they are
+	uint32_t backend;//0 - Vulkan, 1 - CPU
+	VkResampleCPU cpu;
+	uint32_t tiled;//image does not fit the VRAM budget and is upscaled in rows of overlapping tiles
+	VkResampleTiling tiling;
+} VkResampleContext;
+typedef struct {
+	uint32_t batchSize;
+	double imagesPerSecond;//all stages, png decode and encode included
+	double gpuImagesPerSecond;//GPU busy time only
+	uint32_t numValidationFailures;
+	uint32_t tiled;
+	uint32_t paddedWidth;
+	uint32_t paddedHeight;
+	double recordTimePerSubmit;//CPU time per submit, ms
+	double submitTimePerSubmit;
+} VkResampleRunStats;
 
 /*static VKAPI_ATTR VkBool32 VKAPI_CALL debugReportCallbackFn(
 	VkDebugReportFlagsEXT                       flags,
@@ -232,10 +452,25 @@ VkResult findPhysicalDevice(VkGPU* vkGPU) {
 	VkPhysicalDevice* devices = (VkPhysicalDevice*)malloc(sizeof(VkPhysicalDevice) * deviceCount);
 	res = vkEnumeratePhysicalDevices(vkGPU->instance, &deviceCount, devices);
 	if (res != VK_SUCCESS) return res;
+	if (vkGPU->device_id >= deviceCount) {
+		free(devices);
+		return VK_ERROR_DEVICE_LOST;
+	}
 	vkGPU->physicalDevice = devices[vkGPU->device_id];
 	free(devices);
 	return VK_SUCCESS;
 }
+VkResult getDeviceCount(uint32_t* deviceCount) {
+	//number of available devices, used by -d all
+	VkResult res = VK_SUCCESS;
+	VkInstance local_instance = { 0 };
+	VkInstanceCreateInfo createInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+	res = vkCreateInstance(&createInfo, NULL, &local_instance);
+	if (res != VK_SUCCESS) return res;
+	res = vkEnumeratePhysicalDevices(local_instance, deviceCount, NULL);
+	vkDestroyInstance(local_instance, NULL);
+	return res;
+}
 VkResult devices_list() {
 	//this function creates an instance and prints the list of available devices
 	VkResult res = VK_SUCCESS;
@@ -278,6 +513,7 @@ VkResult getComputeQueueFamilyIndex(VkGPU* vkGPU) {
 		VkQueueFamilyProperties props = queueFamilies[i];
 
 		if (props.queueCount > 0 && (props.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
+			vkGPU->timestampValidBits = props.timestampValidBits;
 			break;
 		}
 	}
@@ -288,17 +524,40 @@ VkResult getComputeQueueFamilyIndex(VkGPU* vkGPU) {
 	vkGPU->queueFamilyIndex = i;
 	return VK_SUCCESS;
 }
+void getTransferQueueFamilyIndex(VkGPU* vkGPU) {
+	//find a transfer-only queue family: such families are usually backed by copy engines, that run in parallel with compute. Falls back to the compute family if there is none
+	uint32_t queueFamilyCount;
+	vkGetPhysicalDeviceQueueFamilyProperties(vkGPU->physicalDevice, &queueFamilyCount, NULL);
+
+	VkQueueFamilyProperties* queueFamilies = (VkQueueFamilyProperties*)malloc(sizeof(VkQueueFamilyProperties) * queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(vkGPU->physicalDevice, &queueFamilyCount, queueFamilies);
+	vkGPU->transferQueueFamilyIndex = vkGPU->queueFamilyIndex;
+	for (uint32_t i = 0; i < queueFamilyCount; i++) {
+		VkQueueFamilyProperties props = queueFamilies[i];
+
+		if (props.queueCount > 0 && (props.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			vkGPU->transferQueueFamilyIndex = i;
+			break;
+		}
+	}
+	free(queueFamilies);
+}
 
 VkResult createDevice(VkGPU* vkGPU) {
 	//create logical device representation
 	VkResult res = VK_SUCCESS;
-	VkDeviceQueueCreateInfo queueCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+	VkDeviceQueueCreateInfo queueCreateInfo[2] = { { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO }, { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO } };
 	res = getComputeQueueFamilyIndex(vkGPU);
 	if (res != VK_SUCCESS) return res;
-	queueCreateInfo.queueFamilyIndex = vkGPU->queueFamilyIndex;
-	queueCreateInfo.queueCount = 1;
+	getTransferQueueFamilyIndex(vkGPU);
+	uint32_t queueCreateInfoCount = (vkGPU->transferQueueFamilyIndex != vkGPU->queueFamilyIndex) ? 2 : 1;
 	float queuePriorities = 1.0;
-	queueCreateInfo.pQueuePriorities = &queuePriorities;
+	queueCreateInfo[0].queueFamilyIndex = vkGPU->queueFamilyIndex;
+	queueCreateInfo[0].queueCount = 1;
+	queueCreateInfo[0].pQueuePriorities = &queuePriorities;
+	queueCreateInfo[1].queueFamilyIndex = vkGPU->transferQueueFamilyIndex;
+	queueCreateInfo[1].queueCount = 1;
+	queueCreateInfo[1].pQueuePriorities = &queuePriorities;
 	VkDeviceCreateInfo deviceCreateInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.shaderFloat64 = true;
@@ -316,12 +575,14 @@ VkResult createDevice(VkGPU* vkGPU) {
 	vkGPU->enabledDeviceExtensions.push_back("VK_KHR_shader_float16_int8");
 	deviceCreateInfo.enabledExtensionCount = vkGPU->enabledDeviceExtensions.size();
 	deviceCreateInfo.ppEnabledExtensionNames = vkGPU->enabledDeviceExtensions.data();
-	deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
-	deviceCreateInfo.queueCreateInfoCount = 1;
+	deviceCreateInfo.pQueueCreateInfos = queueCreateInfo;
+	deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
 	deviceCreateInfo.pEnabledFeatures = NULL;
 	res = vkCreateDevice(vkGPU->physicalDevice, &deviceCreateInfo, NULL, &vkGPU->device);
 	if (res != VK_SUCCESS) return res;
 	vkGetDeviceQueue(vkGPU->device, vkGPU->queueFamilyIndex, 0, &vkGPU->queue);
+	vkGPU->transferQueue = VK_NULL_HANDLE;
+	if (queueCreateInfoCount == 2) vkGetDeviceQueue(vkGPU->device, vkGPU->transferQueueFamilyIndex, 0, &vkGPU->transferQueue);
 
 	return res;
 }
@@ -333,68 +594,136 @@ VkResult createFence(VkGPU* vkGPU) {
 	res = vkCreateFence(vkGPU->device, &fenceCreateInfo, NULL, &vkGPU->fence);
 	return res;
 }
-VkResult createCommandPool(VkGPU* vkGPU) {
+VkResult createCommandPool(VkGPU* vkGPU, uint32_t queueFamilyIndex, VkCommandPool* commandPool) {
 	//create a place, command buffer memory is allocated from
 	VkResult res = VK_SUCCESS;
 	VkCommandPoolCreateInfo commandPoolCreateInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
 	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	commandPoolCreateInfo.queueFamilyIndex = vkGPU->queueFamilyIndex;
-	res = vkCreateCommandPool(vkGPU->device, &commandPoolCreateInfo, NULL, &vkGPU->commandPool);
+	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+	res = vkCreateCommandPool(vkGPU->device, &commandPoolCreateInfo, NULL, commandPool);
 	return res;
 }
 
-VkResult findMemoryType(VkGPU* vkGPU, uint32_t memoryTypeBits, uint32_t memorySize, VkMemoryPropertyFlags properties, uint32_t* memoryTypeIndex) {
-	VkPhysicalDeviceMemoryProperties memoryProperties = { 0 };
-
-	vkGetPhysicalDeviceMemoryProperties(vkGPU->physicalDevice, &memoryProperties);
-
-	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
-		if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) && (memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size >= memorySize))
-		{
-			memoryTypeIndex[0] = i;
-			return VK_SUCCESS;
+VkResult allocateFFTBuffer(VkGPU* vkGPU, VkBuffer* buffer, VkFFTMemoryAllocation* allocation, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceSize size) {
+	//allocate the buffer used by the GPU with specified properties, bound to a range of a block of the device sub-allocator
+	return VkFFTAllocatorCreateBuffer(vkGPU->memoryAllocator, buffer, allocation, usageFlags, propertyFlags, size, 0, 0);
+}
+void deleteFFTBuffer(VkGPU* vkGPU, VkBuffer* buffer, VkFFTMemoryAllocation* allocation) {
+	VkFFTAllocatorDestroyBuffer(vkGPU->memoryAllocator, buffer, allocation);
+}
+VkDeviceSize planAliasedRanges(uint32_t numRanges, const VkDeviceSize* sizes, const uint32_t(*stages)[2], VkDeviceSize alignment, VkDeviceSize* offsets) {
+	//ranges used by a common stage must not overlap, ranges with disjoint lifetimes may. Larger ranges are placed first, each at the lowest aligned offset that is free of the placed ranges it shares a stage with. Returns the peak size
+	std::vector<uint32_t> order(numRanges);
+	for (uint32_t i = 0; i < numRanges; i++)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sizes[a] > sizes[b]; });
+	VkDeviceSize peak = 0;
+	for (uint32_t i = 0; i < numRanges; i++) {
+		uint32_t r = order[i];
+		VkDeviceSize offset = 0;
+		bool moved = true;
+		while (moved) {
+			moved = false;
+			for (uint32_t j = 0; j < i; j++) {
+				uint32_t p = order[j];
+				bool shareStage = (stages[r][0] <= stages[r][1]) && (stages[p][0] <= stages[p][1]) && (stages[r][0] <= stages[p][1]) && (stages[p][0] <= stages[r][1]);
+				if ((shareStage) && (offset < offsets[p] + sizes[p]) && (offsets[p] < offset + sizes[r])) {
+					offset = ((offsets[p] + sizes[p] + alignment - 1) / alignment) * alignment;
+					moved = true;
+				}
+			}
 		}
+		offsets[r] = offset;
+		if (offset + sizes[r] > peak) peak = offset + sizes[r];
 	}
-	return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	return peak;
 }
-
-VkResult allocateFFTBuffer(VkGPU* vkGPU, VkBuffer* buffer, VkDeviceMemory* deviceMemory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceSize size) {
-	//allocate the buffer used by the GPU with specified properties
+VkResult allocateAliasedBuffers(VkGPU* vkGPU, uint32_t numBuffers, VkBuffer** buffers, const VkDeviceSize* sizes, const uint32_t(*stages)[2], VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkFFTMemoryAllocation* allocation) {
+	//create buffers and bind them to one range of the sub-allocator at the offsets planned from their lifetimes. On failure all buffers and the range are released
+	VkMemoryRequirements rangeRequirements = { 0, 1, 0xFFFFFFFF };
+	std::vector<VkDeviceSize> rangeSizes(numBuffers);
+	std::vector<VkDeviceSize> rangeOffsets(numBuffers);
 	VkResult res = VK_SUCCESS;
-	uint32_t queueFamilyIndices;
-	VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	bufferCreateInfo.queueFamilyIndexCount = 1;
-	bufferCreateInfo.pQueueFamilyIndices = &queueFamilyIndices;
-	bufferCreateInfo.size = size;
-	bufferCreateInfo.usage = usageFlags;
-	res = vkCreateBuffer(vkGPU->device, &bufferCreateInfo, NULL, buffer);
-	if (res != VK_SUCCESS) return res;
-	VkMemoryRequirements memoryRequirements = { 0 };
-	vkGetBufferMemoryRequirements(vkGPU->device, buffer[0], &memoryRequirements);
-	VkMemoryAllocateInfo memoryAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-	memoryAllocateInfo.allocationSize = memoryRequirements.size;
-	res = findMemoryType(vkGPU, memoryRequirements.memoryTypeBits, memoryRequirements.size, propertyFlags, &memoryAllocateInfo.memoryTypeIndex);
-	if (res != VK_SUCCESS) return res;
-	res = vkAllocateMemory(vkGPU->device, &memoryAllocateInfo, NULL, deviceMemory);
-	if (res != VK_SUCCESS) return res;
-	res = vkBindBufferMemory(vkGPU->device, buffer[0], deviceMemory[0], 0);
-	if (res != VK_SUCCESS) return res;
+	uint32_t numCreated = 0;
+	for (; numCreated < numBuffers; numCreated++) {
+		uint32_t i = numCreated;
+		VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		bufferCreateInfo.size = sizes[i];
+		bufferCreateInfo.usage = usageFlags;
+		res = vkCreateBuffer(vkGPU->device, &bufferCreateInfo, NULL, buffers[i]);
+		if (res != VK_SUCCESS) break;
+		VkMemoryRequirements memoryRequirements = { 0 };
+		vkGetBufferMemoryRequirements(vkGPU->device, buffers[i][0], &memoryRequirements);
+		rangeSizes[i] = memoryRequirements.size;
+		if (memoryRequirements.alignment > rangeRequirements.alignment) rangeRequirements.alignment = memoryRequirements.alignment;
+		rangeRequirements.memoryTypeBits &= memoryRequirements.memoryTypeBits;
+	}
+	if (res == VK_SUCCESS) {
+		rangeRequirements.size = planAliasedRanges(numBuffers, rangeSizes.data(), stages, rangeRequirements.alignment, rangeOffsets.data());
+		res = VkFFTAllocatorAllocate(vkGPU->memoryAllocator, &rangeRequirements, propertyFlags, allocation);
+		if (res == VK_SUCCESS) {
+			for (uint32_t i = 0; (res == VK_SUCCESS) && (i < numBuffers); i++)
+				res = vkBindBufferMemory(vkGPU->device, buffers[i][0], allocation->memory, allocation->offset + rangeOffsets[i]);
+			if (res != VK_SUCCESS) VkFFTAllocatorFree(vkGPU->memoryAllocator, allocation);
+		}
+	}
+	if (res != VK_SUCCESS) {
+		for (uint32_t i = 0; i < numCreated; i++) {
+			vkDestroyBuffer(vkGPU->device, buffers[i][0], NULL);
+			buffers[i][0] = VK_NULL_HANDLE;
+		}
+	}
+	return res;
+}
+VkResult submitToQueueWithFence(VkQueue queue, std::mutex* queueMutex, VkSubmitInfo* submitInfo, VkFence fence) {
+	//submit to a queue, that can be shared between threads. fence can be VK_NULL_HANDLE, if completion is signaled by a later submit
+	if (queueMutex) {
+		std::lock_guard<std::mutex> lock(queueMutex[0]);
+		return vkQueueSubmit(queue, 1, submitInfo, fence);
+	}
+	return vkQueueSubmit(queue, 1, submitInfo, fence);
+}
+VkResult submitToQueue(VkGPU* vkGPU, VkSubmitInfo* submitInfo) {
+	//submit to the compute queue. Completion is signaled with the fence of vkGPU
+	return submitToQueueWithFence(vkGPU->queue, vkGPU->queueMutex, submitInfo, vkGPU->fence);
+}
+VkResult allocateStaging(VkGPU* vkGPU, VkDeviceSize size, VkDeviceSize* offset) {
+	//sub-allocate the staging ring, wait until the GPU is done with enough space
+	std::unique_lock<std::mutex> lock(vkGPU->staging->mutex);
+	VkResult res = VK_NOT_READY;
+	vkGPU->staging->condition.wait(lock, [&] {
+		res = VkFFTStagingRingAllocate(&vkGPU->staging->ring, size, offset);
+		return res != VK_NOT_READY;
+		});
 	return res;
 }
+void releaseStaging(VkGPU* vkGPU, VkDeviceSize offset) {
+	//call after the fence of the submit that used the allocation has signaled
+	{
+		std::lock_guard<std::mutex> lock(vkGPU->staging->mutex);
+		VkFFTStagingRingRelease(&vkGPU->staging->ring, offset);
+	}
+	vkGPU->staging->condition.notify_all();
+}
 VkResult transferDataFromCPU(VkGPU* vkGPU, void* arr, VkBuffer* buffer, VkDeviceSize bufferSize) {
 	//a function that transfers data from the CPU to the GPU using staging buffer, because the GPU memory is not host-coherent
 	VkResult res = VK_SUCCESS;
 	VkDeviceSize stagingBufferSize = bufferSize;
 	VkBuffer stagingBuffer = { 0 };
-	VkDeviceMemory stagingBufferMemory = { 0 };
-	res = allocateFFTBuffer(vkGPU, &stagingBuffer, &stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
-	if (res != VK_SUCCESS) return res;
-	void* data;
-	res = vkMapMemory(vkGPU->device, stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-	if (res != VK_SUCCESS) return res;
-	memcpy(data, arr, stagingBufferSize);
-	vkUnmapMemory(vkGPU->device, stagingBufferMemory);
+	VkFFTMemoryAllocation stagingAllocation = { 0 };
+	VkDeviceSize stagingOffset = 0;
+	if (vkGPU->staging) {
+		res = allocateStaging(vkGPU, stagingBufferSize, &stagingOffset);
+		if (res != VK_SUCCESS) return res;
+		stagingBuffer = vkGPU->staging->ring.buffer;
+		memcpy((char*)vkGPU->staging->ring.data + stagingOffset, arr, stagingBufferSize);
+	}
+	else {
+		res = allocateFFTBuffer(vkGPU, &stagingBuffer, &stagingAllocation, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
+		if (res != VK_SUCCESS) return res;
+		memcpy(stagingAllocation.data, arr, stagingBufferSize);
+	}
 	VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
 	commandBufferAllocateInfo.commandPool = vkGPU->commandPool;
 	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -407,7 +736,7 @@ VkResult transferDataFromCPU(VkGPU* vkGPU, void* arr, VkBuffer* buffer, VkDevice
 	res = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 	if (res != VK_SUCCESS) return res;
 	VkBufferCopy copyRegion = { 0 };
-	copyRegion.srcOffset = 0;
+	copyRegion.srcOffset = stagingOffset;
 	copyRegion.dstOffset = 0;
 	copyRegion.size = stagingBufferSize;
 	vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer[0], 1, &copyRegion);
@@ -416,15 +745,19 @@ VkResult transferDataFromCPU(VkGPU* vkGPU, void* arr, VkBuffer* buffer, VkDevice
 	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
-	res = vkQueueSubmit(vkGPU->queue, 1, &submitInfo, vkGPU->fence);
+	res = submitToQueue(vkGPU, &submitInfo);
 	if (res != VK_SUCCESS) return res;
 	res = vkWaitForFences(vkGPU->device, 1, &vkGPU->fence, VK_TRUE, 100000000000);
 	if (res != VK_SUCCESS) return res;
 	res = vkResetFences(vkGPU->device, 1, &vkGPU->fence);
 	if (res != VK_SUCCESS) return res;
 	vkFreeCommandBuffers(vkGPU->device, vkGPU->commandPool, 1, &commandBuffer);
-	vkDestroyBuffer(vkGPU->device, stagingBuffer, NULL);
-	vkFreeMemory(vkGPU->device, stagingBufferMemory, NULL);
+	if (vkGPU->staging) {
+		releaseStaging(vkGPU, stagingOffset);
+	}
+	else {
+		deleteFFTBuffer(vkGPU, &stagingBuffer, &stagingAllocation);
+	}
 	return res;
 }
 VkResult transferDataToCPU(VkGPU* vkGPU, void* arr, VkBuffer* buffer, VkDeviceSize bufferSize) {
@@ -432,9 +765,17 @@ VkResult transferDataToCPU(VkGPU* vkGPU, void* arr, VkBuffer* buffer, VkDeviceSi
 	VkResult res = VK_SUCCESS;
 	VkDeviceSize stagingBufferSize = bufferSize;
 	VkBuffer stagingBuffer = { 0 };
-	VkDeviceMemory stagingBufferMemory = { 0 };
-	res = allocateFFTBuffer(vkGPU, &stagingBuffer, &stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
-	if (res != VK_SUCCESS) return res;
+	VkFFTMemoryAllocation stagingAllocation = { 0 };
+	VkDeviceSize stagingOffset = 0;
+	if (vkGPU->staging) {
+		res = allocateStaging(vkGPU, stagingBufferSize, &stagingOffset);
+		if (res != VK_SUCCESS) return res;
+		stagingBuffer = vkGPU->staging->ring.buffer;
+	}
+	else {
+		res = allocateFFTBuffer(vkGPU, &stagingBuffer, &stagingAllocation, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
+		if (res != VK_SUCCESS) return res;
+	}
 	VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
 	commandBufferAllocateInfo.commandPool = vkGPU->commandPool;
 	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -448,27 +789,27 @@ VkResult transferDataToCPU(VkGPU* vkGPU, void* arr, VkBuffer* buffer, VkDeviceSi
 	if (res != VK_SUCCESS) return res;
 	VkBufferCopy copyRegion = { 0 };
 	copyRegion.srcOffset = 0;
-	copyRegion.dstOffset = 0;
+	copyRegion.dstOffset = stagingOffset;
 	copyRegion.size = stagingBufferSize;
 	vkCmdCopyBuffer(commandBuffer, buffer[0], stagingBuffer, 1, &copyRegion);
 	vkEndCommandBuffer(commandBuffer);
 	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
-	res = vkQueueSubmit(vkGPU->queue, 1, &submitInfo, vkGPU->fence);
+	res = submitToQueue(vkGPU, &submitInfo);
 	if (res != VK_SUCCESS) return res;
 	res = vkWaitForFences(vkGPU->device, 1, &vkGPU->fence, VK_TRUE, 100000000000);
 	if (res != VK_SUCCESS) return res;
 	res = vkResetFences(vkGPU->device, 1, &vkGPU->fence);
 	if (res != VK_SUCCESS) return res;
 	vkFreeCommandBuffers(vkGPU->device, vkGPU->commandPool, 1, &commandBuffer);
-	void* data;
-	res = vkMapMemory(vkGPU->device, stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-	if (res != VK_SUCCESS) return res;
-	memcpy(arr, data, stagingBufferSize);
-	vkUnmapMemory(vkGPU->device, stagingBufferMemory);
-	vkDestroyBuffer(vkGPU->device, stagingBuffer, NULL);
-	vkFreeMemory(vkGPU->device, stagingBufferMemory, NULL);
+	if (vkGPU->staging) {
+		memcpy(arr, (char*)vkGPU->staging->ring.data + stagingOffset, stagingBufferSize);
+		releaseStaging(vkGPU, stagingOffset);
+		return res;
+	}
+	memcpy(arr, stagingAllocation.data, stagingBufferSize);
+	deleteFFTBuffer(vkGPU, &stagingBuffer, &stagingAllocation);
 	return res;
 }
 
@@ -546,12 +887,12 @@ void main()\n\
 	}
 	//printf("%s\n", app->code0);
 }
-VkResult createShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
-	//create an application interface to Vulkan. This function binds the shader to the compute pipeline, so it can be used as a part of the command buffer later
+VkResult createComputeApp(VkGPU* vkGPU, VkShiftApplication* app, void (*shaderGen)(VkShiftApplication*)) {
+	//create an application interface to Vulkan. This function binds the shader, generated by shaderGen, to the compute pipeline, so it can be used as a part of the command buffer later
 	VkResult res = VK_SUCCESS;
-	//we have two storage buffer objects in one set in one pool
+	//we have two storage buffer objects in one set in one pool, three if the app has an auxiliary buffer
 	VkDescriptorPoolSize descriptorPoolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
-	descriptorPoolSize.descriptorCount = 2;
+	descriptorPoolSize.descriptorCount = (app->auxBuffer) ? 3 : 2;
 
 	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
 	descriptorPoolCreateInfo.poolSizeCount = 1;
@@ -560,7 +901,7 @@ VkResult createShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
 	res = vkCreateDescriptorPool(vkGPU->device, &descriptorPoolCreateInfo, NULL, &app->descriptorPool);
 	if (res != VK_SUCCESS) return res;
 	//specify each object from the set as a storage buffer
-	const VkDescriptorType descriptorType[2] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	const VkDescriptorType descriptorType[3] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
 	VkDescriptorSetLayoutBinding* descriptorSetLayoutBindings = (VkDescriptorSetLayoutBinding*)malloc(descriptorPoolSize.descriptorCount * sizeof(VkDescriptorSetLayoutBinding));
 	for (uint32_t i = 0; i < descriptorPoolSize.descriptorCount; ++i) {
 		descriptorSetLayoutBindings[i].binding = i;
@@ -597,6 +938,11 @@ VkResult createShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
 			descriptorBufferInfo.range = app->outputBufferSize;
 			descriptorBufferInfo.offset = 0;
 		}
+		if (i == 2) {
+			descriptorBufferInfo.buffer = app->auxBuffer[0];
+			descriptorBufferInfo.range = app->auxBufferSize;
+			descriptorBufferInfo.offset = 0;
+		}
 
 		VkWriteDescriptorSet writeDescriptorSet = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
 		writeDescriptorSet.dstSet = app->descriptorSet;
@@ -613,6 +959,12 @@ VkResult createShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
 	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
 	pipelineLayoutCreateInfo.setLayoutCount = 1;
 	pipelineLayoutCreateInfo.pSetLayouts = &app->descriptorSetLayout;
+	//values that change between dispatches of one command buffer are passed as push constants
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, app->pushConstantsSize };
+	if (app->pushConstantsSize) {
+		pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+		pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	}
 
 	//create pipeline layout
 	res = vkCreatePipelineLayout(vkGPU->device, &pipelineLayoutCreateInfo, NULL, &app->pipelineLayout);
@@ -625,205 +977,209 @@ VkResult createShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
 
 	pipelineShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 	//create a shader module from the byte code
-	uint32_t filelength;
 	app->code0 = (char*)malloc(sizeof(char) * 100000);
-	shaderGenShift(app);
+	shaderGen(app);
 	//printf("%s\n", app->code0);
-	const glslang_resource_t default_resource = {
-		/* .MaxLights = */ 32,
-		/* .MaxClipPlanes = */ 6,
-		/* .MaxTextureUnits = */ 32,
-		/* .MaxTextureCoords = */ 32,
-		/* .MaxVertexAttribs = */ 64,
-		/* .MaxVertexUniformComponents = */ 4096,
-		/* .MaxVaryingFloats = */ 64,
-		/* .MaxVertexTextureImageUnits = */ 32,
-		/* .MaxCombinedTextureImageUnits = */ 80,
-		/* .MaxTextureImageUnits = */ 32,
-		/* .MaxFragmentUniformComponents = */ 4096,
-		/* .MaxDrawBuffers = */ 32,
-		/* .MaxVertexUniformVectors = */ 128,
-		/* .MaxVaryingVectors = */ 8,
-		/* .MaxFragmentUniformVectors = */ 16,
-		/* .MaxVertexOutputVectors = */ 16,
-		/* .MaxFragmentInputVectors = */ 15,
-		/* .MinProgramTexelOffset = */ -8,
-		/* .MaxProgramTexelOffset = */ 7,
-		/* .MaxClipDistances = */ 8,
-		/* .MaxComputeWorkGroupCountX = */ 65535,
-		/* .MaxComputeWorkGroupCountY = */ 65535,
-		/* .MaxComputeWorkGroupCountZ = */ 65535,
-		/* .MaxComputeWorkGroupSizeX = */ 1024,
-		/* .MaxComputeWorkGroupSizeY = */ 1024,
-		/* .MaxComputeWorkGroupSizeZ = */ 64,
-		/* .MaxComputeUniformComponents = */ 1024,
-		/* .MaxComputeTextureImageUnits = */ 16,
-		/* .MaxComputeImageUniforms = */ 8,
-		/* .MaxComputeAtomicCounters = */ 8,
-		/* .MaxComputeAtomicCounterBuffers = */ 1,
-		/* .MaxVaryingComponents = */ 60,
-		/* .MaxVertexOutputComponents = */ 64,
-		/* .MaxGeometryInputComponents = */ 64,
-		/* .MaxGeometryOutputComponents = */ 128,
-		/* .MaxFragmentInputComponents = */ 128,
-		/* .MaxImageUnits = */ 8,
-		/* .MaxCombinedImageUnitsAndFragmentOutputs = */ 8,
-		/* .MaxCombinedShaderOutputResources = */ 8,
-		/* .MaxImageSamples = */ 0,
-		/* .MaxVertexImageUniforms = */ 0,
-		/* .MaxTessControlImageUniforms = */ 0,
-		/* .MaxTessEvaluationImageUniforms = */ 0,
-		/* .MaxGeometryImageUniforms = */ 0,
-		/* .MaxFragmentImageUniforms = */ 8,
-		/* .MaxCombinedImageUniforms = */ 8,
-		/* .MaxGeometryTextureImageUnits = */ 16,
-		/* .MaxGeometryOutputVertices = */ 256,
-		/* .MaxGeometryTotalOutputComponents = */ 1024,
-		/* .MaxGeometryUniformComponents = */ 1024,
-		/* .MaxGeometryVaryingComponents = */ 64,
-		/* .MaxTessControlInputComponents = */ 128,
-		/* .MaxTessControlOutputComponents = */ 128,
-		/* .MaxTessControlTextureImageUnits = */ 16,
-		/* .MaxTessControlUniformComponents = */ 1024,
-		/* .MaxTessControlTotalOutputComponents = */ 4096,
-		/* .MaxTessEvaluationInputComponents = */ 128,
-		/* .MaxTessEvaluationOutputComponents = */ 128,
-		/* .MaxTessEvaluationTextureImageUnits = */ 16,
-		/* .MaxTessEvaluationUniformComponents = */ 1024,
-		/* .MaxTessPatchComponents = */ 120,
-		/* .MaxPatchVertices = */ 32,
-		/* .MaxTessGenLevel = */ 64,
-		/* .MaxViewports = */ 16,
-		/* .MaxVertexAtomicCounters = */ 0,
-		/* .MaxTessControlAtomicCounters = */ 0,
-		/* .MaxTessEvaluationAtomicCounters = */ 0,
-		/* .MaxGeometryAtomicCounters = */ 0,
-		/* .MaxFragmentAtomicCounters = */ 8,
-		/* .MaxCombinedAtomicCounters = */ 8,
-		/* .MaxAtomicCounterBindings = */ 1,
-		/* .MaxVertexAtomicCounterBuffers = */ 0,
-		/* .MaxTessControlAtomicCounterBuffers = */ 0,
-		/* .MaxTessEvaluationAtomicCounterBuffers = */ 0,
-		/* .MaxGeometryAtomicCounterBuffers = */ 0,
-		/* .MaxFragmentAtomicCounterBuffers = */ 1,
-		/* .MaxCombinedAtomicCounterBuffers = */ 1,
-		/* .MaxAtomicCounterBufferSize = */ 16384,
-		/* .MaxTransformFeedbackBuffers = */ 4,
-		/* .MaxTransformFeedbackInterleavedComponents = */ 64,
-		/* .MaxCullDistances = */ 8,
-		/* .MaxCombinedClipAndCullDistances = */ 8,
-		/* .MaxSamples = */ 4,
-		/* .maxMeshOutputVerticesNV = */ 256,
-		/* .maxMeshOutputPrimitivesNV = */ 512,
-		/* .maxMeshWorkGroupSizeX_NV = */ 32,
-		/* .maxMeshWorkGroupSizeY_NV = */ 1,
-		/* .maxMeshWorkGroupSizeZ_NV = */ 1,
-		/* .maxTaskWorkGroupSizeX_NV = */ 32,
-		/* .maxTaskWorkGroupSizeY_NV = */ 1,
-		/* .maxTaskWorkGroupSizeZ_NV = */ 1,
-		/* .maxMeshViewCountNV = */ 4,
-		/* .maxDualSourceDrawBuffersEXT = */ 1,
-
-		/* .limits = */ {
-			/* .nonInductiveForLoops = */ 1,
-			/* .whileLoops = */ 1,
-			/* .doWhileLoops = */ 1,
-			/* .generalUniformIndexing = */ 1,
-			/* .generalAttributeMatrixVectorIndexing = */ 1,
-			/* .generalVaryingIndexing = */ 1,
-			/* .generalSamplerIndexing = */ 1,
-			/* .generalVariableIndexing = */ 1,
-			/* .generalConstantMatrixVectorIndexing = */ 1,
-		} };
-	glslang_target_client_version_t client_version = (app->precision == 2) ? GLSLANG_TARGET_VULKAN_1_1 : GLSLANG_TARGET_VULKAN_1_0;
-	glslang_target_language_version_t target_language_version = (app->precision == 2) ? GLSLANG_TARGET_SPV_1_3 : GLSLANG_TARGET_SPV_1_0;
-	const glslang_input_t input =
-	{
-		GLSLANG_SOURCE_GLSL,
-		GLSLANG_STAGE_COMPUTE,
-		GLSLANG_CLIENT_VULKAN,
-		client_version,
-		GLSLANG_TARGET_SPV,
-		target_language_version,
-		app->code0,
-		450,
-		GLSLANG_NO_PROFILE,
-		1,
-		0,
-		GLSLANG_MSG_DEFAULT_BIT,
-		&default_resource,
-	};
-
-	glslang_shader_t* shader = glslang_shader_create(&input);
-	const char* err;
-	if (!glslang_shader_preprocess(shader, &input))
-	{
-		err = glslang_shader_get_info_log(shader);
-		printf("%s\n", app->code0);
-		printf("%s\n", err);
-		glslang_shader_delete(shader);
-		free(app->code0);
-		return VK_ERROR_INITIALIZATION_FAILED;
-
-	}
-
-	if (!glslang_shader_parse(shader, &input))
-	{
-		err = glslang_shader_get_info_log(shader);
-		printf("%s\n", app->code0);
-		printf("%s\n", err);
-		glslang_shader_delete(shader);
-		free(app->code0);
-		return VK_ERROR_INITIALIZATION_FAILED;
-	}
-	glslang_program_t* program = glslang_program_create();
-	glslang_program_add_shader(program, shader);
-	if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT))
-	{
-		err = glslang_program_get_info_log(program);
-		printf("%s\n", app->code0);
-		printf("%s\n", err);
-		glslang_shader_delete(shader);
-		free(app->code0);
-		return VK_ERROR_INITIALIZATION_FAILED;
-	}
-
-	glslang_program_SPIRV_generate(program, input.stage);
-
-	if (glslang_program_SPIRV_get_messages(program))
-	{
-		printf("%s", glslang_program_SPIRV_get_messages(program));
-	}
-
-	glslang_shader_delete(shader);
+	res = VkFFTCompileShader(vkGPU->shaderCache, vkGPU->device, app->code0, (app->precision == 2), &pipelineShaderStageCreateInfo.module);
 	free(app->code0);
-
-	VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-	createInfo.pCode = glslang_program_SPIRV_get_ptr(program);
-	createInfo.codeSize = glslang_program_SPIRV_get_size(program) * sizeof(uint32_t);
-	vkCreateShaderModule(vkGPU->device, &createInfo, NULL, &pipelineShaderStageCreateInfo.module);
+	if (res != VK_SUCCESS) return res;
 
 	pipelineShaderStageCreateInfo.pName = "main";
 	pipelineShaderStageCreateInfo.pSpecializationInfo = 0;// &specializationInfo;
 	computePipelineCreateInfo.stage = pipelineShaderStageCreateInfo;
 	computePipelineCreateInfo.layout = app->pipelineLayout;
 
-
-
-	vkCreateComputePipelines(vkGPU->device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &app->pipeline);
+	vkCreateComputePipelines(vkGPU->device, (vkGPU->shaderCache) ? vkGPU->shaderCache->pipelineCache : VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &app->pipeline);
 	vkDestroyShaderModule(vkGPU->device, pipelineShaderStageCreateInfo.module, NULL);
-	glslang_program_delete(program);
 	return res;
 }
+VkResult createShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
+	return createComputeApp(vkGPU, app, shaderGenShift);
+}
+static inline void shaderGenDCT(VkShiftApplication* app) {
+	//DCT mode (Makhoul): the FFT of the even-odd reordered image gives its DCT-II coefficients C(k1, k2) after a twiddle multiplication. They are real and not wrapped, so zero padding just appends zeros and no shift is needed.
+	//Each thread computes one element of the spectrum, whose inverse FFT is the DCT-III of C zero-padded to fftSize, in the layout the inverse FFT reads. Reads the forward spectrum of imageSize[0] x imageSize[1] images
+	//R2C spectra store frequencies below N/2 in rows of inputStride[0] elements and the N/2 column after them, the upper half is restored from Hermitian symmetry. z is the coordinate
+	sprintf(app->code0, "#version 450\n");
+	sprintf(app->code0 + strlen(app->code0), "layout (local_size_x = %d, local_size_y = %d, local_size_z = %d) in;\n", app->localSize[0], app->localSize[1], app->localSize[2]);
+
+	char vecType[10];
+	char calcType[10];
+	char LFending[4] = "";
+	switch (app->precision) {
+	case 1: {
+		sprintf(vecType, "dvec2");
+		sprintf(calcType, "double");
+		sprintf(LFending, "LF");
+		break;
+	}
+	default: {
+		sprintf(vecType, "vec2");
+		sprintf(calcType, "float");
+		break;
+	}
+	}
+	sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 0) readonly buffer Input\n\
+{\n\
+	%s inputs[];\n\
+};\n\
+layout(std430, binding = 1) writeonly buffer Output\n\
+{\n\
+	%s outputs[];\n\
+};\n", vecType, vecType);
+	if (app->precision == 1)
+		//GLSL has no double cos and sin: minimax polynomial of sin on 0..pi/2 with the quadrant folded in, as sincos_20 of VkFFT, with double constants
+		sprintf(app->code0 + strlen(app->code0), "\
+dvec2 twiddle(double angle) {\n\
+	double y = abs(angle * 0.63661977236758134307553505349006LF);\n\
+	double q = floor(y);\n\
+	int quadrant = int(q) & 3;\n\
+	double t = (((quadrant & 1) != 0) ? 1 - y + q : y - q) * 1.5707963267948966192313216916398LF;\n\
+	double t2 = t * t;\n\
+	double r = fma(fma(fma(fma(fma(fma(fma(fma(fma(-7.97989713648499642889739108679114937e-18LF, t2, 2.81018528153898622636194976499656274e-15LF), t2, -7.64712637907716970380859898835680587e-13LF), t2, 1.60590431721336942356660057796782021e-10LF), t2, -2.50521083781017605729370231280411712e-8LF), t2, 2.75573192239364018847578909205399262e-6LF), t2, -0.000198412698412696489459896530659927773LF), t2, 0.00833333333333333295212653322266277182LF), t2, -0.166666666666666666637194166219637268LF), t2 * t, t);\n\
+	double c = sqrt(1 - r * r);\n\
+	r = (angle < 0) ? -r : r;\n\
+	return dvec2(((quadrant == 0) || (quadrant == 3)) ? c : -c, ((quadrant & 2) != 0) ? -r : r);\n\
+}\n");
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+vec2 twiddle(float angle) {\n\
+	return vec2(cos(angle), sin(angle));\n\
+}\n");
+	if (app->r2c)
+		sprintf(app->code0 + strlen(app->code0), "\
+uint index(uint k1, uint k2, uint nyquist) {\n\
+	return ((k1 < nyquist) ? k1 + k2 * %d : %d + k2) + gl_GlobalInvocationID.z * %d;\n\
+}\n\
+%s spectrum(uint k1, uint k2) {\n\
+	if (k1 > %d) {\n\
+		%s v = inputs[index(%d - k1, (%d - k2) %% %d, %d)];\n\
+		return %s(v.x, -v.y);\n\
+	}\n\
+	return inputs[index(k1, k2, %d)];\n\
+}\n", app->inputStride[0], app->inputStride[0] * app->inputStride[1], app->inputStride[2], vecType, app->imageSize[0] / 2, vecType, app->imageSize[0], app->imageSize[1], app->imageSize[1], app->imageSize[0] / 2, vecType, app->imageSize[0] / 2);
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+uint index(uint k1, uint k2, uint nyquist) {\n\
+	return k1 + k2 * %d + gl_GlobalInvocationID.z * %d;\n\
+}\n\
+%s spectrum(uint k1, uint k2) {\n\
+	return inputs[index(k1, k2, 0)];\n\
+}\n", app->inputStride[0], app->inputStride[2], vecType);
+	sprintf(app->code0 + strlen(app->code0), "\
+%s coefficient(uint k1, uint k2) {\n\
+	if ((k1 >= %d) || (k2 >= %d)) return 0.0;\n\
+	%s w1 = twiddle(%.17f%s * k1);\n\
+	%s w2 = twiddle(%.17f%s * k2);\n\
+	%s a = spectrum(k1, k2);\n\
+	%s b = spectrum(k1, (%d - k2) %% %d);\n\
+	%s s = %s(w2.x * (a.x + b.x) - w2.y * (a.y - b.y), w2.x * (a.y + b.y) + w2.y * (a.x - b.x));\n\
+	return 0.5 * (w1.x * s.x - w1.y * s.y);\n\
+}\n", calcType, app->imageSize[0], app->imageSize[1], vecType, -M_PI / (2.0 * app->imageSize[0]), LFending, vecType, -M_PI / (2.0 * app->imageSize[1]), LFending, vecType, vecType, app->imageSize[1], app->imageSize[1], vecType, vecType);
+	sprintf(app->code0 + strlen(app->code0), "\
+void main()\n\
+{\n\
+	uint k1 = gl_GlobalInvocationID.x;\n\
+	uint k2 = gl_GlobalInvocationID.y;\n\
+	if ((k1 < %d) && (k2 < %d)) {\n\
+		%s a = coefficient(k1, k2);\n\
+		%s b = 0.0;\n\
+		if ((k1 > 0) && (k2 > 0)) a -= coefficient(%d - k1, %d - k2);\n\
+		if (k1 > 0) b += coefficient(%d - k1, k2);\n\
+		if (k2 > 0) b += coefficient(k1, %d - k2);\n\
+		%s w = twiddle(%.17f%s * k1 + %.17f%s * k2);\n\
+		outputs[index(k1, k2, %d)] = %s(w.x * a + w.y * b, w.y * a - w.x * b);\n\
+	}\n\
+}\n", app->size[0], app->size[1], calcType, calcType, app->fftSize[0], app->fftSize[1], app->fftSize[0], app->fftSize[1], vecType, M_PI / (2.0 * app->fftSize[0]), LFending, M_PI / (2.0 * app->fftSize[1]), LFending, app->fftSize[0] / 2, vecType);
+	//printf("%s\n", app->code0);
+}
+VkResult createDCTApp(VkGPU* vkGPU, VkShiftApplication* app) {
+	return createComputeApp(vkGPU, app, shaderGenDCT);
+}
+static inline void shaderGenCrop(VkShiftApplication* app) {
+	//downscale: copy the frequencies retained by the fftSize[0] x fftSize[1] inverse FFT from the forward spectrum of imageSize[0] x imageSize[1] images to the positions the inverse FFT reads them from. Both spectra use the forward buffer layout
+	//Lower frequencies stay in place, upper frequencies are taken from the end of the forward spectrum. If one axis is upscaled, its frequencies missing in the forward spectrum are written as zeros. One thread per element of the inverse spectrum, z is the coordinate
+	sprintf(app->code0, "#version 450\n");
+	sprintf(app->code0 + strlen(app->code0), "layout (local_size_x = %d, local_size_y = %d, local_size_z = %d) in;\n", app->localSize[0], app->localSize[1], app->localSize[2]);
+
+	char vecType[10];
+	switch (app->precision) {
+	case 1: {
+		sprintf(vecType, "dvec2");
+		break;
+	}
+	default: {
+		sprintf(vecType, "vec2");
+		break;
+	}
+	}
+	sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 0) readonly buffer Input\n\
+{\n\
+	%s inputs[];\n\
+};\n\
+layout(std430, binding = 1) writeonly buffer Output\n\
+{\n\
+	%s outputs[];\n\
+};\n", vecType, vecType);
+	//frequencies below low are kept in place, frequencies from high on are moved by shift. R2C keeps only the Nyquist column above low, it is read from the Nyquist column of the forward spectrum
+	uint32_t n[2];
+	int32_t low[2];
+	int32_t high[2];
+	int32_t shift[2];
+	for (uint32_t i = 0; i < 2; i++) {
+		n[i] = (app->imageSize[i] < app->fftSize[i]) ? app->imageSize[i] : app->fftSize[i];
+		low[i] = n[i] / 2;
+		high[i] = app->fftSize[i] - (n[i] - n[i] / 2);
+		shift[i] = (int32_t)app->imageSize[i] - (int32_t)app->fftSize[i];
+	}
+	if (app->r2c) {
+		high[0] = app->fftSize[0] / 2;
+		shift[0] = (int32_t)(n[0] / 2) - (int32_t)(app->fftSize[0] / 2);
+		sprintf(app->code0 + strlen(app->code0), "\
+uint index(uint k1, uint k2, uint nyquist) {\n\
+	return ((k1 < nyquist) ? k1 + k2 * %d : %d + k2) + gl_GlobalInvocationID.z * %d;\n\
+}\n", app->inputStride[0], app->inputStride[0] * app->inputStride[1], app->inputStride[2]);
+	}
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+uint index(uint k1, uint k2, uint nyquist) {\n\
+	return k1 + k2 * %d + gl_GlobalInvocationID.z * %d;\n\
+}\n", app->inputStride[0], app->inputStride[2]);
+	sprintf(app->code0 + strlen(app->code0), "\
+void main()\n\
+{\n\
+	uint k1 = gl_GlobalInvocationID.x;\n\
+	uint k2 = gl_GlobalInvocationID.y;\n\
+	if ((k1 < %d) && (k2 < %d)) {\n\
+		%s value = %s(0.0);\n\
+		if (((k1 < %d) || (k1 >= %d)) && ((k2 < %d) || (k2 >= %d))) {\n\
+			uint k1_in = (k1 < %d) ? k1 : uint(int(k1) + (%d));\n\
+			uint k2_in = (k2 < %d) ? k2 : uint(int(k2) + (%d));\n\
+			value = inputs[index(k1_in, k2_in, %d)];\n\
+		}\n\
+		outputs[index(k1, k2, %d)] = value;\n\
+	}\n\
+}\n", app->size[0], app->size[1], vecType, vecType, low[0], high[0], low[1], high[1], low[0], shift[0], low[1], shift[1], app->imageSize[0] / 2, app->fftSize[0] / 2);
+	//printf("%s\n", app->code0);
+}
+VkResult createCropApp(VkGPU* vkGPU, VkShiftApplication* app) {
+	return createComputeApp(vkGPU, app, shaderGenCrop);
+}
 
-static inline void shaderGenSharpen(VkShiftApplication* app) {
-	//FidelityFX-CAS sharpener implementation
+static inline void shaderGenUnpack(VkShiftApplication* app) {
+	//convert interleaved 8- or 16-bit images to planar normalized values in the layout of the FFT input buffer. One thread per pixel per channel, z is channel + image * imageSize[2]
+	//images are inputStride[2] samples apart in the input buffer. Planes of all images follow each other in the output buffer, as VkFFT batches are stored
+	//in tiled mode images are the tiles of one row of tiles, tileStep[0] pixels apart in the input strip. Tiles past the right edge repeat the last column
+	//in DCT mode pixels are written in the even-odd order: even pixels in ascending order, then odd pixels in descending order
+	//if size is larger than imageSize, the image is mirror-padded to it. Padding wider than the image repeats the first pixel
+	//in YCbCr mode z is plane + image * planes: luma plane, and alpha plane of 4 channel images. Cb and Cr planes of size[0] x size[1] pixels are written to the chroma buffer with luma
+	uint32_t planes = (app->color) ? app->imageSize[2] - 2 : app->imageSize[2];
 	sprintf(app->code0, "#version 450\n");
-	char endingNum[10] = "";
 	if (app->precision == 2) {
 		sprintf(app->code0 + strlen(app->code0), "#extension GL_EXT_shader_16bit_storage : require\n\
 #extension GL_EXT_shader_explicit_arithmetic_types_float16 : require\n");
-		sprintf(endingNum, "HF");
 	}
 	sprintf(app->code0 + strlen(app->code0), "layout (local_size_x = %d, local_size_y = %d, local_size_z = %d) in;\n", app->localSize[0], app->localSize[1], app->localSize[2]);
 
@@ -846,350 +1202,350 @@ static inline void shaderGenSharpen(VkShiftApplication* app) {
 		break;
 	}
 	}
-	if (app->r2c)
-		sprintf(app->code0 + strlen(app->code0), "\
-layout(std430, binding = 0) buffer Input\n\
+	sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 0) readonly buffer Input\n\
 {\n\
-	%s inputs[];\n\
+	uint inputs[];\n\
 };\n\
-layout(std430, binding = 1) buffer Output\n\
+layout(std430, binding = 1) writeonly buffer Output\n\
 {\n\
 	%s outputs[];\n\
-};\n", floatType, floatType);
-	else
-		sprintf(app->code0 + strlen(app->code0), "\
-layout(std430, binding = 0) buffer Input\n\
-{\n\
-	%s inputs[];\n\
 };\n\
-layout(std430, binding = 1) buffer Output\n\
+float unpackSample(uint id_sample) {\n\
+	return float((inputs[id_sample / %d] >> (%d * (id_sample %% %d))) & %d) / %d.0;\n\
+}\n", (app->r2c) ? floatType : vecType, 32 / app->bitDepth, app->bitDepth, 32 / app->bitDepth, (1 << app->bitDepth) - 1, (1 << app->bitDepth) - 1);
+	if (app->color)
+		sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 2) writeonly buffer Chroma\n\
 {\n\
-	%s outputs[];\n\
-};\n", vecType, floatType);
-	sprintf(app->code0 + strlen(app->code0), "\
-uint index(uint index_x, uint index_y) {\n\
-	return index_x + index_y * %d + gl_GlobalInvocationID.z * %d;\n\
-}\n", app->inputStride[0], app->inputStride[2]);
-	sprintf(app->code0 + strlen(app->code0), "\
-uint index_out(uint index_x, uint index_y) {\n\
-	return index_x + index_y * %d + gl_GlobalInvocationID.z * %d;\n\
-}\n", app->outputStride[0], app->outputStride[2]);
+	float chroma[];\n\
+};\n");
 	sprintf(app->code0 + strlen(app->code0), "\
 void main()\n\
 {\n\
-if((gl_GlobalInvocationID.x<%d)&&(gl_GlobalInvocationID.y<%d)){", app->size[0], app->size[1]);
-	if (app->r2c)
+	if ((gl_GlobalInvocationID.x < %d) && (gl_GlobalInvocationID.y < %d)) {\n", app->size[0], app->size[1]);
+	if (app->dct)
 		sprintf(app->code0 + strlen(app->code0), "\
-	%s tex[9];\n", floatType);
+		uint x = (gl_GlobalInvocationID.x < %d) ? 2 * gl_GlobalInvocationID.x : %d - 2 * gl_GlobalInvocationID.x;\n\
+		uint y = (gl_GlobalInvocationID.y < %d) ? 2 * gl_GlobalInvocationID.y : %d - 2 * gl_GlobalInvocationID.y;\n", (app->size[0] + 1) / 2, 2 * app->size[0] - 1, (app->size[1] + 1) / 2, 2 * app->size[1] - 1);
 	else
 		sprintf(app->code0 + strlen(app->code0), "\
-	%s tex[9];\n", vecType);
-	sprintf(app->code0 + strlen(app->code0), "\
-	%s len[9];\n\
-	uint id_x_m=(gl_GlobalInvocationID.x>0) ? gl_GlobalInvocationID.x-1 : gl_GlobalInvocationID.x;\n\
-	uint id_y_m=(gl_GlobalInvocationID.y>0) ? gl_GlobalInvocationID.y-1 : gl_GlobalInvocationID.y;\n\
-	uint id_x_p=(gl_GlobalInvocationID.x<%d) ? gl_GlobalInvocationID.x+1 : gl_GlobalInvocationID.x;\n\
-	uint id_y_p=(gl_GlobalInvocationID.y<%d) ? gl_GlobalInvocationID.y+1 : gl_GlobalInvocationID.y;\n\
-	tex[0]= %f%s*inputs[index(id_x_m, id_y_m)];\n\
-	tex[1]= %f%s*inputs[index(gl_GlobalInvocationID.x, id_y_m)];\n\
-	tex[2]= %f%s*inputs[index(id_x_p, id_y_m)];\n\
-	tex[3]= %f%s*inputs[index(id_x_m, gl_GlobalInvocationID.y)];\n\
-	tex[4]= %f%s*inputs[index(gl_GlobalInvocationID.x, gl_GlobalInvocationID.y)];\n\
-	tex[5]= %f%s*inputs[index(id_x_p, gl_GlobalInvocationID.y)];\n\
-	tex[6]= %f%s*inputs[index(id_x_m, id_y_p)];\n\
-	tex[7]= %f%s*inputs[index(gl_GlobalInvocationID.x, id_y_p)];\n\
-	tex[8]= %f%s*inputs[index(id_x_p, id_y_p)];\n", floatType, app->size[0], app->size[1], app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum, app->upscale, endingNum);
-	sprintf(app->code0 + strlen(app->code0), "\
-	for(uint i=0;i<9;i++){\n\
-		len[i]=length(tex[i]);\n\
-		if(len[i]>1.0%s) len[i]=1.0%s;\n\
-		if(len[i]<0.0%s) len[i]=0.0%s;\n\
-	}\n", endingNum, endingNum, endingNum, endingNum);
-	sprintf(app->code0 + strlen(app->code0), "\
-	%s minL[2];\n\
-	minL[0]= min(len[1], min(len[3], min(len[4], min(len[5],len[7]))));\n\
-	minL[1]= min(minL[0], min(len[0], min(len[2], min(len[6], len[8]))));\n\
-	%s maxL[2];\n\
-	maxL[0]= max(len[1], max(len[3], max(len[4], max(len[5],len[7]))));\n\
-	maxL[1]= max(maxL[0], max(len[0], max(len[2], max(len[6], len[8]))));\n\
-	%s minlen=0.5%s*(minL[0]+minL[1]);\n\
-	%s maxlen=0.5%s*(maxL[0]+maxL[1]);\n\
-	minlen=minlen/(1.0%s-minlen);\n\
-	maxlen=(1.0%s-maxlen)/maxlen;\n\
-	%s scale = (minlen<maxlen) ? minlen : maxlen;\n\
-	scale=-%f%s*sqrt(scale);\n", floatType, floatType, floatType, endingNum, floatType, endingNum, endingNum, endingNum, floatType, app->sharpenCoeff, endingNum);
+		uint x = gl_GlobalInvocationID.x;\n\
+		uint y = gl_GlobalInvocationID.y;\n");
+	if (app->color)
+		sprintf(app->code0 + strlen(app->code0), "\
+		uint id_chroma = x + y * %d + (gl_GlobalInvocationID.z / %d) * %d;\n", app->size[0], planes, 2 * app->size[0] * app->size[1]);
+	if ((!app->tileStep[0]) && (app->size[0] > app->imageSize[0]))
+		sprintf(app->code0 + strlen(app->code0), "\
+		x = (x < %d) ? x : uint(max(%d - int(x), 0));\n", app->imageSize[0], 2 * app->imageSize[0] - 2);
+	if ((!app->tileStep[0]) && (app->size[1] > app->imageSize[1]))
+		sprintf(app->code0 + strlen(app->code0), "\
+		y = (y < %d) ? y : uint(max(%d - int(y), 0));\n", app->imageSize[1], 2 * app->imageSize[1] - 2);
+	if (app->color) {
+		//BT.601 full range YCbCr, the same as in JPEG
+		sprintf(app->code0 + strlen(app->code0), "\
+		uint id_sample = (gl_GlobalInvocationID.z / %d) * %d + %d * (x + y * %d);\n\
+		%s value;\n\
+		if (gl_GlobalInvocationID.z %% %d == 0) {\n\
+			float r = unpackSample(id_sample);\n\
+			float g = unpackSample(id_sample + 1);\n\
+			float b = unpackSample(id_sample + 2);\n\
+			chroma[id_chroma] = -0.168736 * r - 0.331264 * g + 0.5 * b;\n\
+			chroma[id_chroma + %d] = 0.5 * r - 0.418688 * g - 0.081312 * b;\n\
+			value = %s(0.299 * r + 0.587 * g + 0.114 * b);\n\
+		}\n\
+		else\n\
+			value = %s(unpackSample(id_sample + 3));\n", planes, app->inputStride[2], app->imageSize[2], app->inputStride[0], (app->precision == 1) ? "double" : "float", planes, app->size[0] * app->size[1], (app->precision == 1) ? "double" : "float", (app->precision == 1) ? "double" : "float");
+	}
+	else {
+		if (app->tileStep[0])
+			sprintf(app->code0 + strlen(app->code0), "\
+		uint id_sample = %d * (min((gl_GlobalInvocationID.z / %d) * %d + x, %d) + y * %d) + gl_GlobalInvocationID.z %% %d;\n", app->imageSize[2], app->imageSize[2], app->tileStep[0], app->imageSize[0] - 1, app->inputStride[0], app->imageSize[2]);
+		else
+			sprintf(app->code0 + strlen(app->code0), "\
+		uint id_sample = (gl_GlobalInvocationID.z / %d) * %d + %d * (x + y * %d) + gl_GlobalInvocationID.z %% %d;\n", app->imageSize[2], app->inputStride[2], app->imageSize[2], app->inputStride[0], app->imageSize[2]);
+		sprintf(app->code0 + strlen(app->code0), "\
+		%s value = %s(unpackSample(id_sample));\n", (app->precision == 1) ? "double" : "float", (app->precision == 1) ? "double" : "float");
+	}
 	sprintf(app->code0 + strlen(app->code0), "\
-	outputs[index_out(gl_GlobalInvocationID.x, gl_GlobalInvocationID.y)] = (len[4]+scale*(len[1]+len[3]+len[5]+len[7]))/(1.0%s+scale*4.0%s);\n\
-}}", endingNum, endingNum);
+		uint id = gl_GlobalInvocationID.x + gl_GlobalInvocationID.y * %d + gl_GlobalInvocationID.z * %d;\n", app->outputStride[0], app->outputStride[2]);
+	if (app->r2c)
+		sprintf(app->code0 + strlen(app->code0), "\
+		outputs[id] = %s(value);\n\
+	}\n\
+}\n", floatType);
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+		outputs[id] = %s(value, 0);\n\
+	}\n\
+}\n", vecType);
 	//printf("%s\n", app->code0);
 }
-VkResult createSharpenApp(VkGPU* vkGPU, VkShiftApplication* app) {
-	//create an application interface to Vulkan. This function binds the shader to the compute pipeline, so it can be used as a part of the command buffer later
-	VkResult res = VK_SUCCESS;
-	//we have two storage buffer objects in one set in one pool
-	VkDescriptorPoolSize descriptorPoolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
-	descriptorPoolSize.descriptorCount = 2;
-
-	VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-	descriptorPoolCreateInfo.poolSizeCount = 1;
-	descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
-	descriptorPoolCreateInfo.maxSets = 1;
-	res = vkCreateDescriptorPool(vkGPU->device, &descriptorPoolCreateInfo, NULL, &app->descriptorPool);
-	if (res != VK_SUCCESS) return res;
-	//specify each object from the set as a storage buffer
-	const VkDescriptorType descriptorType[2] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
-	VkDescriptorSetLayoutBinding* descriptorSetLayoutBindings = (VkDescriptorSetLayoutBinding*)malloc(descriptorPoolSize.descriptorCount * sizeof(VkDescriptorSetLayoutBinding));
-	for (uint32_t i = 0; i < descriptorPoolSize.descriptorCount; ++i) {
-		descriptorSetLayoutBindings[i].binding = i;
-		descriptorSetLayoutBindings[i].descriptorType = descriptorType[i];
-		descriptorSetLayoutBindings[i].descriptorCount = 1;
-		descriptorSetLayoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+VkResult createUnpackApp(VkGPU* vkGPU, VkShiftApplication* app) {
+	return createComputeApp(vkGPU, app, shaderGenUnpack);
+}
+static inline void shaderGenPack(VkShiftApplication* app) {
+	//FidelityFX-CAS sharpener fused with conversion to interleaved 8- or 16-bit image. Input is the inverse FFT result, already scaled and clamped to [0,1] by the VkFFT write callback.
+	//One thread sharpens and packs 4 pixels of all imageSize[2] channels, every thread writes whole uints and image rows are padded to 4 pixels
+	//the work group cooperatively loads its (4 * localSize[0] + 2) x (localSize[1] + 2) window of each plane into shared memory, so every pixel is read from the input about once and not 9 times
+	//z is the image in the batch, packed images are outputStride[2] uints apart
+	//in tiled mode rows rowStart..rowEnd of the blend accumulator ring are packed to the output strip at outputOffset
+	//in DCT mode the inverse FFT result is in the even-odd order and pixels are read from their positions in it
+	//in YCbCr mode only luma (and alpha) is sharpened, chroma is sampled bilinearly from the chroma planes at the input position of the pixel and the result is converted back to RGB
+	sprintf(app->code0, "#version 450\n");
+	if (app->precision == 2) {
+		sprintf(app->code0 + strlen(app->code0), "#extension GL_EXT_shader_16bit_storage : require\n\
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require\n");
 	}
+	sprintf(app->code0 + strlen(app->code0), "layout (local_size_x = %d, local_size_y = %d, local_size_z = %d) in;\n", app->localSize[0], app->localSize[1], app->localSize[2]);
 
-	VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-	descriptorSetLayoutCreateInfo.bindingCount = descriptorPoolSize.descriptorCount;
-	descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings;
-	//create layout
-	res = vkCreateDescriptorSetLayout(vkGPU->device, &descriptorSetLayoutCreateInfo, NULL, &app->descriptorSetLayout);
-	if (res != VK_SUCCESS) return res;
-	free(descriptorSetLayoutBindings);
-	//provide the layout with actual buffers and their sizes
-	VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-	descriptorSetAllocateInfo.descriptorPool = app->descriptorPool;
-	descriptorSetAllocateInfo.descriptorSetCount = 1;
-	descriptorSetAllocateInfo.pSetLayouts = &app->descriptorSetLayout;
-	res = vkAllocateDescriptorSets(vkGPU->device, &descriptorSetAllocateInfo, &app->descriptorSet);
-	if (res != VK_SUCCESS) return res;
-	for (uint32_t i = 0; i < descriptorPoolSize.descriptorCount; ++i) {
-
-
-		VkDescriptorBufferInfo descriptorBufferInfo = { 0 };
-		if (i == 0) {
-			descriptorBufferInfo.buffer = app->inputBuffer[0];
-			descriptorBufferInfo.range = app->inputBufferSize;
-			descriptorBufferInfo.offset = 0;
-		}
-		if (i == 1) {
-			descriptorBufferInfo.buffer = app->outputBuffer[0];
-			descriptorBufferInfo.range = app->outputBufferSize;
-			descriptorBufferInfo.offset = 0;
-		}
-
-		VkWriteDescriptorSet writeDescriptorSet = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
-		writeDescriptorSet.dstSet = app->descriptorSet;
-		writeDescriptorSet.dstBinding = i;
-		writeDescriptorSet.dstArrayElement = 0;
-		writeDescriptorSet.descriptorType = descriptorType[i];
-		writeDescriptorSet.descriptorCount = 1;
-		writeDescriptorSet.pBufferInfo = &descriptorBufferInfo;
-		vkUpdateDescriptorSets(vkGPU->device, 1, &writeDescriptorSet, 0, NULL);
+	char vecType[10];
+	char floatType[10];
+	switch (app->precision) {
+	case 0: {
+		sprintf(vecType, "vec2");
+		sprintf(floatType, "float");
+		break;
 	}
-
-
-
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-	pipelineLayoutCreateInfo.setLayoutCount = 1;
-	pipelineLayoutCreateInfo.pSetLayouts = &app->descriptorSetLayout;
-	//create pipeline layout
-	res = vkCreatePipelineLayout(vkGPU->device, &pipelineLayoutCreateInfo, NULL, &app->pipelineLayout);
-	if (res != VK_SUCCESS) return res;
-	VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-
-	VkComputePipelineCreateInfo computePipelineCreateInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-	//specify specialization constants - structure that sets constants in the shader after first compilation (done by glslangvalidator, for example) but before final shader module creation
-	//first three values - workgroup dimensions 
-
-	pipelineShaderStageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	//create a shader module from the byte code
-	uint32_t filelength;
-	app->code0 = (char*)malloc(sizeof(char) * 100000);
-	shaderGenSharpen(app);
+	case 1: {
+		sprintf(vecType, "dvec2");
+		sprintf(floatType, "double");
+		break;
+	}
+	case 2: {
+		sprintf(vecType, "f16vec2");
+		sprintf(floatType, "float16_t");
+		break;
+	}
+	}
+	const char* calcType = (app->precision == 1) ? "double" : "float";
+	uint32_t planes = (app->color) ? app->imageSize[2] - 2 : app->imageSize[2];
+	uint32_t maxValue = (1 << app->bitDepth) - 1;
+	sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 0) readonly buffer Input\n\
+{\n\
+	%s inputs[];\n\
+};\n\
+layout(std430, binding = 1) writeonly buffer Output\n\
+{\n\
+	uint outputs[];\n\
+};\n", (app->ringHeight) ? "float" : ((app->r2c) ? floatType : vecType));
+	if (app->color) {
+		//output pixel i of the FFT resample is at input position i * size / outputSize, of the DCT resample at (i + 0.5) * size / outputSize - 0.5
+		const char* offset = (app->dct) ? "0.5" : "0.0";
+		sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 2) readonly buffer Chroma\n\
+{\n\
+	float chroma[];\n\
+};\n\
+vec2 chromaAt(uint x, uint y, uint z) {\n\
+	uint id = x + y * %d + z * %d;\n\
+	return vec2(chroma[id], chroma[id + %d]);\n\
+}\n\
+vec2 sampleChroma(uint x, uint y, uint z) {\n\
+	vec2 position = clamp((vec2(x, y) + %s) * vec2(%d.0, %d.0) / vec2(%d.0, %d.0) - %s, vec2(0.0), vec2(%d.0, %d.0));\n\
+	uvec2 p0 = uvec2(position);\n\
+	uvec2 p1 = min(p0 + 1, uvec2(%d, %d));\n\
+	vec2 f = position - vec2(p0);\n\
+	return mix(mix(chromaAt(p0.x, p0.y, z), chromaAt(p1.x, p0.y, z), f.x), mix(chromaAt(p0.x, p1.y, z), chromaAt(p1.x, p1.y, z), f.x), f.y);\n\
+}\n", app->chromaSize[0], 2 * app->chromaSize[0] * app->chromaSize[1], app->chromaSize[0] * app->chromaSize[1], offset, app->chromaSize[0], app->chromaSize[1], app->fftSize[0], app->fftSize[1], offset, app->chromaSize[0] - 1, app->chromaSize[1] - 1, app->chromaSize[0] - 1, app->chromaSize[1] - 1);
+	}
+	if (app->ringHeight) {
+		sprintf(app->code0 + strlen(app->code0), "\
+layout(push_constant) uniform PushConstants\n\
+{\n\
+	uint rowStart;\n\
+	uint rowEnd;\n\
+} pc;\n\
+%s len(uint index_x, uint index_y, uint v) {\n\
+	return %s(inputs[index_x + (index_y %% %d) * %d + v * %d]);\n\
+}\n", calcType, calcType, app->ringHeight, app->imageSize[0], app->ringHeight * app->imageSize[0]);
+	}
+	else if (app->dct)
+		sprintf(app->code0 + strlen(app->code0), "\
+%s len(uint index_x, uint index_y, uint v) {\n\
+	index_x = (index_x %% 2 == 0) ? index_x / 2 : %d - (index_x + 1) / 2;\n\
+	index_y = (index_y %% 2 == 0) ? index_y / 2 : %d - (index_y + 1) / 2;\n\
+	return %s(inputs[index_x + index_y * %d + v * %d]%s);\n\
+}\n", calcType, app->fftSize[0], app->fftSize[1], calcType, app->inputStride[0], app->inputStride[2], (app->r2c) ? "" : ".x");
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+%s len(uint index_x, uint index_y, uint v) {\n\
+	return %s(inputs[index_x + index_y * %d + v * %d]%s);\n\
+}\n", calcType, calcType, app->inputStride[0], app->inputStride[2], (app->r2c) ? "" : ".x");
+	//tile column i and row j hold input pixel x0 + i - 1, y0 + j - 1 clamped to the image, threads of the group read consecutive columns of a row
+	uint32_t tileWidth = 4 * app->localSize[0] + 2;
+	uint32_t tileHeight = app->localSize[1] + 2;
+	sprintf(app->code0 + strlen(app->code0), "\
+shared %s tile[%d][%d];\n\
+void main()\n\
+{\n", calcType, tileHeight, tileWidth);
+	if (app->ringHeight)
+		sprintf(app->code0 + strlen(app->code0), "\
+	uint y = pc.rowStart + gl_GlobalInvocationID.y;\n\
+	bool inside = (gl_GlobalInvocationID.x < %d) && (y < pc.rowEnd);\n", app->size[0]);
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+	uint y = gl_GlobalInvocationID.y;\n\
+	bool inside = (gl_GlobalInvocationID.x < %d) && (y < %d);\n", app->size[0], app->size[1]);
+	//all threads take part in the tile loads and barriers, only the threads inside the image sharpen and write
+	sprintf(app->code0 + strlen(app->code0), "\
+	uint x0 = 4 * gl_WorkGroupID.x * %d;\n\
+	uint y0 = y - gl_LocalInvocationID.y;\n\
+	uint samples[%d];\n\
+	for (uint v = 0; v < %d; v++) {\n\
+		barrier();\n\
+		for (uint i = gl_LocalInvocationIndex; i < %d; i += %d) {\n\
+			uint id_x = min(max(x0 + i %% %d, 1) - 1, %d);\n\
+			uint id_y = min(max(y0 + i / %d, 1) - 1, %d);\n\
+			tile[i / %d][i %% %d] = len(id_x, id_y, gl_GlobalInvocationID.z * %d + v);\n\
+		}\n\
+		barrier();\n\
+		if (inside) {\n\
+			%s l[3][6];\n\
+			for (uint r = 0; r < 3; r++)\n\
+				for (uint c = 0; c < 6; c++)\n\
+					l[r][c] = tile[gl_LocalInvocationID.y + r][4 * gl_LocalInvocationID.x + c];\n\
+			for (uint p = 0; p < 4; p++) {\n\
+				uint c = p + 1;\n\
+				%s minL0 = min(l[0][c], min(l[1][c - 1], min(l[1][c], min(l[1][c + 1], l[2][c]))));\n\
+				%s minL1 = min(minL0, min(l[0][c - 1], min(l[0][c + 1], min(l[2][c - 1], l[2][c + 1]))));\n\
+				%s maxL0 = max(l[0][c], max(l[1][c - 1], max(l[1][c], max(l[1][c + 1], l[2][c]))));\n\
+				%s maxL1 = max(maxL0, max(l[0][c - 1], max(l[0][c + 1], max(l[2][c - 1], l[2][c + 1]))));\n\
+				%s minlen = 0.5 * (minL0 + minL1);\n\
+				%s maxlen = 0.5 * (maxL0 + maxL1);\n\
+				minlen = minlen / (1.0 - minlen);\n\
+				maxlen = (1.0 - maxlen) / maxlen;\n\
+				%s scale = -%f * sqrt((minlen < maxlen) ? minlen : maxlen);\n\
+				%s value = (l[1][c] + scale * (l[0][c] + l[1][c - 1] + l[1][c + 1] + l[2][c])) / (1.0 + scale * 4.0);\n", app->localSize[0], 4 * app->imageSize[2], planes, tileWidth * tileHeight, app->localSize[0] * app->localSize[1], tileWidth, app->imageSize[0] - 1, tileWidth, app->imageSize[1] - 1, tileWidth, tileWidth, planes, calcType, calcType, calcType, calcType, calcType, calcType, calcType, calcType, app->sharpenCoeff, calcType);
+	if (app->color)
+		sprintf(app->code0 + strlen(app->code0), "\
+				uint px = 4 * gl_GlobalInvocationID.x + p;\n\
+				if (v == 0) {\n\
+					vec2 cbcr = sampleChroma(px, y, gl_GlobalInvocationID.z);\n\
+					float luma = float(clamp(value, 0.0, 1.0));\n\
+					vec3 rgb = vec3(luma + 1.402 * cbcr.y, luma - 0.344136 * cbcr.x - 0.714136 * cbcr.y, luma + 1.772 * cbcr.x);\n\
+					for (uint k = 0; k < 3; k++)\n\
+						samples[p * %d + k] = (px < %d) ? uint(%d.0 * clamp(rgb[k], 0.0, 1.0)) : 0;\n\
+				}\n\
+				else\n\
+					samples[p * %d + 3] = (px < %d) ? uint(%d.0 * clamp(value, 0.0, 1.0)) : 0;\n", app->imageSize[2], app->imageSize[0], maxValue, app->imageSize[2], app->imageSize[0], maxValue);
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+				samples[p * %d + v] = (4 * gl_GlobalInvocationID.x + p < %d) ? uint(%d.0 * clamp(value, 0.0, 1.0)) : 0;\n", app->imageSize[2], app->imageSize[0], maxValue);
+	//4 pixels of imageSize[2] channels are imageSize[2] uints of 8-bit samples or 2 * imageSize[2] uints of 16-bit samples
+	uint32_t uintsPerThread = app->imageSize[2] * app->bitDepth / 8;
+	sprintf(app->code0 + strlen(app->code0), "\
+			}\n\
+		}\n\
+	}\n\
+	if (inside) {\n\
+		uint id = %d + gl_GlobalInvocationID.z * %d + %d * (gl_GlobalInvocationID.x + gl_GlobalInvocationID.y * %d);\n\
+		for (uint i = 0; i < %d; i++)\n", app->outputOffset, app->outputStride[2], uintsPerThread, app->size[0], uintsPerThread);
+	if (app->bitDepth == 16)
+		sprintf(app->code0 + strlen(app->code0), "\
+			outputs[id + i] = samples[2 * i] | (samples[2 * i + 1] << 16);\n");
+	else
+		sprintf(app->code0 + strlen(app->code0), "\
+			outputs[id + i] = samples[4 * i] | (samples[4 * i + 1] << 8) | (samples[4 * i + 2] << 16) | (samples[4 * i + 3] << 24);\n");
+	sprintf(app->code0 + strlen(app->code0), "\
+	}\n\
+}\n");
 	//printf("%s\n", app->code0);
-	const glslang_resource_t default_resource = {
-		/* .MaxLights = */ 32,
-		/* .MaxClipPlanes = */ 6,
-		/* .MaxTextureUnits = */ 32,
-		/* .MaxTextureCoords = */ 32,
-		/* .MaxVertexAttribs = */ 64,
-		/* .MaxVertexUniformComponents = */ 4096,
-		/* .MaxVaryingFloats = */ 64,
-		/* .MaxVertexTextureImageUnits = */ 32,
-		/* .MaxCombinedTextureImageUnits = */ 80,
-		/* .MaxTextureImageUnits = */ 32,
-		/* .MaxFragmentUniformComponents = */ 4096,
-		/* .MaxDrawBuffers = */ 32,
-		/* .MaxVertexUniformVectors = */ 128,
-		/* .MaxVaryingVectors = */ 8,
-		/* .MaxFragmentUniformVectors = */ 16,
-		/* .MaxVertexOutputVectors = */ 16,
-		/* .MaxFragmentInputVectors = */ 15,
-		/* .MinProgramTexelOffset = */ -8,
-		/* .MaxProgramTexelOffset = */ 7,
-		/* .MaxClipDistances = */ 8,
-		/* .MaxComputeWorkGroupCountX = */ 65535,
-		/* .MaxComputeWorkGroupCountY = */ 65535,
-		/* .MaxComputeWorkGroupCountZ = */ 65535,
-		/* .MaxComputeWorkGroupSizeX = */ 1024,
-		/* .MaxComputeWorkGroupSizeY = */ 1024,
-		/* .MaxComputeWorkGroupSizeZ = */ 64,
-		/* .MaxComputeUniformComponents = */ 1024,
-		/* .MaxComputeTextureImageUnits = */ 16,
-		/* .MaxComputeImageUniforms = */ 8,
-		/* .MaxComputeAtomicCounters = */ 8,
-		/* .MaxComputeAtomicCounterBuffers = */ 1,
-		/* .MaxVaryingComponents = */ 60,
-		/* .MaxVertexOutputComponents = */ 64,
-		/* .MaxGeometryInputComponents = */ 64,
-		/* .MaxGeometryOutputComponents = */ 128,
-		/* .MaxFragmentInputComponents = */ 128,
-		/* .MaxImageUnits = */ 8,
-		/* .MaxCombinedImageUnitsAndFragmentOutputs = */ 8,
-		/* .MaxCombinedShaderOutputResources = */ 8,
-		/* .MaxImageSamples = */ 0,
-		/* .MaxVertexImageUniforms = */ 0,
-		/* .MaxTessControlImageUniforms = */ 0,
-		/* .MaxTessEvaluationImageUniforms = */ 0,
-		/* .MaxGeometryImageUniforms = */ 0,
-		/* .MaxFragmentImageUniforms = */ 8,
-		/* .MaxCombinedImageUniforms = */ 8,
-		/* .MaxGeometryTextureImageUnits = */ 16,
-		/* .MaxGeometryOutputVertices = */ 256,
-		/* .MaxGeometryTotalOutputComponents = */ 1024,
-		/* .MaxGeometryUniformComponents = */ 1024,
-		/* .MaxGeometryVaryingComponents = */ 64,
-		/* .MaxTessControlInputComponents = */ 128,
-		/* .MaxTessControlOutputComponents = */ 128,
-		/* .MaxTessControlTextureImageUnits = */ 16,
-		/* .MaxTessControlUniformComponents = */ 1024,
-		/* .MaxTessControlTotalOutputComponents = */ 4096,
-		/* .MaxTessEvaluationInputComponents = */ 128,
-		/* .MaxTessEvaluationOutputComponents = */ 128,
-		/* .MaxTessEvaluationTextureImageUnits = */ 16,
-		/* .MaxTessEvaluationUniformComponents = */ 1024,
-		/* .MaxTessPatchComponents = */ 120,
-		/* .MaxPatchVertices = */ 32,
-		/* .MaxTessGenLevel = */ 64,
-		/* .MaxViewports = */ 16,
-		/* .MaxVertexAtomicCounters = */ 0,
-		/* .MaxTessControlAtomicCounters = */ 0,
-		/* .MaxTessEvaluationAtomicCounters = */ 0,
-		/* .MaxGeometryAtomicCounters = */ 0,
-		/* .MaxFragmentAtomicCounters = */ 8,
-		/* .MaxCombinedAtomicCounters = */ 8,
-		/* .MaxAtomicCounterBindings = */ 1,
-		/* .MaxVertexAtomicCounterBuffers = */ 0,
-		/* .MaxTessControlAtomicCounterBuffers = */ 0,
-		/* .MaxTessEvaluationAtomicCounterBuffers = */ 0,
-		/* .MaxGeometryAtomicCounterBuffers = */ 0,
-		/* .MaxFragmentAtomicCounterBuffers = */ 1,
-		/* .MaxCombinedAtomicCounterBuffers = */ 1,
-		/* .MaxAtomicCounterBufferSize = */ 16384,
-		/* .MaxTransformFeedbackBuffers = */ 4,
-		/* .MaxTransformFeedbackInterleavedComponents = */ 64,
-		/* .MaxCullDistances = */ 8,
-		/* .MaxCombinedClipAndCullDistances = */ 8,
-		/* .MaxSamples = */ 4,
-		/* .maxMeshOutputVerticesNV = */ 256,
-		/* .maxMeshOutputPrimitivesNV = */ 512,
-		/* .maxMeshWorkGroupSizeX_NV = */ 32,
-		/* .maxMeshWorkGroupSizeY_NV = */ 1,
-		/* .maxMeshWorkGroupSizeZ_NV = */ 1,
-		/* .maxTaskWorkGroupSizeX_NV = */ 32,
-		/* .maxTaskWorkGroupSizeY_NV = */ 1,
-		/* .maxTaskWorkGroupSizeZ_NV = */ 1,
-		/* .maxMeshViewCountNV = */ 4,
-		/* .maxDualSourceDrawBuffersEXT = */ 1,
-
-		/* .limits = */ {
-			/* .nonInductiveForLoops = */ 1,
-			/* .whileLoops = */ 1,
-			/* .doWhileLoops = */ 1,
-			/* .generalUniformIndexing = */ 1,
-			/* .generalAttributeMatrixVectorIndexing = */ 1,
-			/* .generalVaryingIndexing = */ 1,
-			/* .generalSamplerIndexing = */ 1,
-			/* .generalVariableIndexing = */ 1,
-			/* .generalConstantMatrixVectorIndexing = */ 1,
-		} };
-	glslang_target_client_version_t client_version = (app->precision == 2) ? GLSLANG_TARGET_VULKAN_1_1 : GLSLANG_TARGET_VULKAN_1_0;
-	glslang_target_language_version_t target_language_version = (app->precision == 2) ? GLSLANG_TARGET_SPV_1_3 : GLSLANG_TARGET_SPV_1_0;
-	const glslang_input_t input =
-	{
-		GLSLANG_SOURCE_GLSL,
-		GLSLANG_STAGE_COMPUTE,
-		GLSLANG_CLIENT_VULKAN,
-		client_version,
-		GLSLANG_TARGET_SPV,
-		target_language_version,
-		app->code0,
-		450,
-		GLSLANG_NO_PROFILE,
-		1,
-		0,
-		GLSLANG_MSG_DEFAULT_BIT,
-		&default_resource,
-	};
-
-	glslang_shader_t* shader = glslang_shader_create(&input);
-	const char* err;
-	if (!glslang_shader_preprocess(shader, &input))
-	{
-		err = glslang_shader_get_info_log(shader);
-		printf("%s\n", app->code0);
-		printf("%s\n", err);
-		glslang_shader_delete(shader);
-		free(app->code0);
-		return VK_ERROR_INITIALIZATION_FAILED;
-
+}
+VkResult createPackApp(VkGPU* vkGPU, VkShiftApplication* app) {
+	return createComputeApp(vkGPU, app, shaderGenPack);
+}
+static inline void shaderGenBlend(VkShiftApplication* app) {
+	//tiled mode: windowed overlap-add of one row of tiles into the blend accumulator ring. One thread per output pixel of the row of tiles gathers all tiles covering it, so no atomics are needed
+	//weights are sin^2 ramps over the overlap on the sides that have a neighbouring tile: ramps of two neighbours sum to 1, so the blend needs no normalization
+	//rows below rowStart of the previous row of tiles already hold its contribution and are accumulated, the rest of the slots are overwritten
+	sprintf(app->code0, "#version 450\n");
+	if (app->precision == 2) {
+		sprintf(app->code0 + strlen(app->code0), "#extension GL_EXT_shader_16bit_storage : require\n\
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require\n");
 	}
+	sprintf(app->code0 + strlen(app->code0), "layout (local_size_x = %d, local_size_y = %d, local_size_z = %d) in;\n", app->localSize[0], app->localSize[1], app->localSize[2]);
 
-	if (!glslang_shader_parse(shader, &input))
-	{
-		err = glslang_shader_get_info_log(shader);
-		printf("%s\n", app->code0);
-		printf("%s\n", err);
-		glslang_shader_delete(shader);
-		free(app->code0);
-		return VK_ERROR_INITIALIZATION_FAILED;
+	char vecType[10];
+	char floatType[10];
+	switch (app->precision) {
+	case 0: {
+		sprintf(vecType, "vec2");
+		sprintf(floatType, "float");
+		break;
 	}
-	glslang_program_t* program = glslang_program_create();
-	glslang_program_add_shader(program, shader);
-	if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT))
-	{
-		err = glslang_program_get_info_log(program);
-		printf("%s\n", app->code0);
-		printf("%s\n", err);
-		glslang_shader_delete(shader);
-		free(app->code0);
-		return VK_ERROR_INITIALIZATION_FAILED;
+	case 1: {
+		sprintf(vecType, "dvec2");
+		sprintf(floatType, "double");
+		break;
 	}
-
-	glslang_program_SPIRV_generate(program, input.stage);
-
-	if (glslang_program_SPIRV_get_messages(program))
-	{
-		printf("%s", glslang_program_SPIRV_get_messages(program));
+	case 2: {
+		sprintf(vecType, "f16vec2");
+		sprintf(floatType, "float16_t");
+		break;
 	}
-
-	glslang_shader_delete(shader);
-	free(app->code0);
-
-	VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-	createInfo.pCode = glslang_program_SPIRV_get_ptr(program);
-	createInfo.codeSize = glslang_program_SPIRV_get_size(program) * sizeof(uint32_t);
-	vkCreateShaderModule(vkGPU->device, &createInfo, NULL, &pipelineShaderStageCreateInfo.module);
-
-	pipelineShaderStageCreateInfo.pName = "main";
-	pipelineShaderStageCreateInfo.pSpecializationInfo = 0;// &specializationInfo;
-	computePipelineCreateInfo.stage = pipelineShaderStageCreateInfo;
-	computePipelineCreateInfo.layout = app->pipelineLayout;
-
-
-
-	vkCreateComputePipelines(vkGPU->device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &app->pipeline);
-	vkDestroyShaderModule(vkGPU->device, pipelineShaderStageCreateInfo.module, NULL);
-	glslang_program_delete(program);
-	return res;
+	}
+	uint32_t overlap[2] = { app->tileSize[0] - app->tileStep[0], app->tileSize[1] - app->tileStep[1] };
+	sprintf(app->code0 + strlen(app->code0), "\
+layout(std430, binding = 0) readonly buffer Input\n\
+{\n\
+	%s inputs[];\n\
+};\n\
+layout(std430, binding = 1) buffer Output\n\
+{\n\
+	float outputs[];\n\
+};\n\
+layout(push_constant) uniform PushConstants\n\
+{\n\
+	uint rowStart;\n\
+	uint previousRowEnd;\n\
+	uint neighbours;\n\
+} pc;\n\
+float weight(uint p, uint n, uint overlap, bool low, bool high) {\n\
+	float w = 1.0;\n\
+	if (low && (p < overlap)) {\n\
+		float s = sin(1.5707963267948966 * (float(p) + 0.5) / float(overlap));\n\
+		w *= s * s;\n\
+	}\n\
+	if (high && (p + overlap >= n)) {\n\
+		float s = sin(1.5707963267948966 * (float(n - 1 - p) + 0.5) / float(overlap));\n\
+		w *= s * s;\n\
+	}\n\
+	return w;\n\
+}\n", (app->r2c) ? floatType : vecType);
+	sprintf(app->code0 + strlen(app->code0), "\
+void main()\n\
+{\n\
+	uint x = gl_GlobalInvocationID.x;\n\
+	uint tile_y = gl_GlobalInvocationID.y;\n\
+	uint y = pc.rowStart + tile_y;\n\
+	if ((x < %d) && (tile_y < %d) && (y < %d)) {\n\
+		float weight_y = weight(tile_y, %d, %d, (pc.neighbours & 1) != 0, (pc.neighbours & 2) != 0);\n\
+		float sum[%d];\n\
+		for (uint v = 0; v < %d; v++)\n\
+			sum[v] = 0;\n\
+		uint firstTile = (x >= %d) ? (x - %d) / %d + 1 : 0;\n\
+		uint lastTile = min(x / %d, %d);\n\
+		for (uint k = firstTile; k <= lastTile; k++) {\n\
+			uint tile_x = x - k * %d;\n\
+			float w = weight_y * weight(tile_x, %d, %d, k > 0, k < %d);\n\
+			for (uint v = 0; v < %d; v++)\n\
+				sum[v] += w * float(inputs[tile_x + tile_y * %d + (k * %d + v) * %d]%s);\n\
+		}\n\
+		uint id = x + (y %% %d) * %d;\n\
+		for (uint v = 0; v < %d; v++) {\n\
+			if (y < pc.previousRowEnd)\n\
+				outputs[id + v * %d] += sum[v];\n\
+			else\n\
+				outputs[id + v * %d] = sum[v];\n\
+		}\n\
+	}\n\
+}\n", app->imageSize[0], app->tileSize[1], app->imageSize[1], app->tileSize[1], overlap[1], app->imageSize[2], app->imageSize[2], app->tileSize[0], app->tileSize[0], app->tileStep[0], app->tileStep[0], app->numTiles - 1, app->tileStep[0], app->tileSize[0], overlap[0], app->numTiles - 1, app->imageSize[2], app->inputStride[0], app->imageSize[2], app->inputStride[2], (app->r2c) ? "" : ".x", app->ringHeight, app->imageSize[0], app->imageSize[2], app->ringHeight * app->imageSize[0], app->ringHeight * app->imageSize[0]);
+	//printf("%s\n", app->code0);
+}
+VkResult createBlendApp(VkGPU* vkGPU, VkShiftApplication* app) {
+	return createComputeApp(vkGPU, app, shaderGenBlend);
 }
 
 void deleteShiftApp(VkGPU* vkGPU, VkShiftApplication* app) {
@@ -1207,6 +1563,7 @@ void appendShiftApp(VkShiftApplication* app, VkCommandBuffer commandBuffer) {
 				VK_ACCESS_SHADER_WRITE_BIT,
 				VK_ACCESS_SHADER_READ_BIT,
 	};
+	if (app->pushConstantsSize) vkCmdPushConstants(commandBuffer, app->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, app->pushConstantsSize, app->pushConstants);
 	//bind compute pipeline to the command buffer
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, app->pipeline);
 	//bind descriptors to the command buffer
@@ -1219,7 +1576,7 @@ void appendShiftApp(VkShiftApplication* app, VkCommandBuffer commandBuffer) {
 }
 
 
-void performVulkanFFT(VkGPU* vkGPU, VkFFTApplication* app, uint32_t batch) {
+double performVulkanFFT(VkGPU* vkGPU, VkFFTApplication* app, uint32_t batch) {
 	VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
 	commandBufferAllocateInfo.commandPool = vkGPU->commandPool;
 	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -1238,137 +1595,1283 @@ void performVulkanFFT(VkGPU* vkGPU, VkFFTApplication* app, uint32_t batch) {
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 	auto timeSubmit = std::chrono::system_clock::now();
-	vkQueueSubmit(vkGPU->queue, 1, &submitInfo, vkGPU->fence);
+	submitToQueue(vkGPU, &submitInfo);
 	vkWaitForFences(vkGPU->device, 1, &vkGPU->fence, VK_TRUE, 100000000000);
 	auto timeEnd = std::chrono::system_clock::now();
 	double totTime = std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeSubmit).count() * 0.001;
 	//printf("Pure submit execution time per batch: %.3f ms\n", totTime / batch);
 	vkResetFences(vkGPU->device, 1, &vkGPU->fence);
 	vkFreeCommandBuffers(vkGPU->device, vkGPU->commandPool, 1, &commandBuffer);
+	return totTime / batch;
+}
+void appendOwnershipTransfer(VkCommandBuffer commandBuffer, VkBuffer buffer, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask) {
+	//release (recorded on the source family, dstAccessMask is 0) or acquire (recorded on the destination family, srcAccessMask is 0) half of a queue family ownership transfer of the whole buffer
+	VkBufferMemoryBarrier buffer_barrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+	buffer_barrier.srcAccessMask = srcAccessMask;
+	buffer_barrier.dstAccessMask = dstAccessMask;
+	buffer_barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+	buffer_barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+	buffer_barrier.buffer = buffer;
+	buffer_barrier.offset = 0;
+	buffer_barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, NULL, 1, &buffer_barrier, 0, NULL);
+}
+void writeTimestamp(VkResampleBufferSet* set, VkCommandBuffer commandBuffer, VkPipelineStageFlagBits stage, uint32_t* query) {
+	//timestamp i marks the end of stage set->timestampStages[i - 1]
+	if (set->timestampQueryPool) {
+		vkCmdWriteTimestamp(commandBuffer, stage, set->timestampQueryPool, *query);
+		(*query)++;
+	}
+}
+void collectTimestamps(VkResampleContext* context, VkResampleBufferSet* set) {
+	//read timestamps of a finished submit and add the time of each stage to the statistics
+	uint32_t numTimestamps = (uint32_t)set->timestampStages.size() + 1;
+	std::vector<uint64_t> timestamps(numTimestamps);
+	if (vkGetQueryPoolResults(set->vkGPU.device, set->timestampQueryPool, 0, numTimestamps, numTimestamps * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) return;
+	uint64_t mask = (set->vkGPU.timestampValidBits < 64) ? (((uint64_t)1 << set->vkGPU.timestampValidBits) - 1) : (uint64_t)-1;
+	double period = set->vkGPU.physicalDeviceProperties.limits.timestampPeriod * 1e-6;//ticks to ms
+	std::lock_guard<std::mutex> lock(context->statsMutex);
+	for (uint32_t i = 0; i < set->timestampStages.size(); i++)
+		context->timestampSamples[set->timestampStages[i]].push_back(((timestamps[i + 1] - timestamps[i]) & mask) * period);
+	context->timestampSamples.back().push_back(((timestamps[numTimestamps - 1] - timestamps[0]) & mask) * period);
 }
-double performVulkanUpscale(VkGPU* vkGPU, VkFFTApplication* app_forward, VkShiftApplication* appShift, VkFFTApplication* app_inverse, VkShiftApplication* appSharpen, uint32_t batch) {
+VkResult allocateCommandBuffers(VkResampleBufferSet* set, uint32_t count) {
+	//command buffers are allocated once, vkBeginCommandBuffer resets them before they are recorded again
+	if (set->commandBuffers.size() == count) return VK_SUCCESS;
+	set->commandBuffers.resize(count);
 	VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
-	commandBufferAllocateInfo.commandPool = vkGPU->commandPool;
+	commandBufferAllocateInfo.commandPool = set->vkGPU.commandPool;
 	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	commandBufferAllocateInfo.commandBufferCount = 1;
-	VkCommandBuffer commandBuffer = {};
-	vkAllocateCommandBuffers(vkGPU->device, &commandBufferAllocateInfo, &commandBuffer);
+	commandBufferAllocateInfo.commandBufferCount = count;
+	return vkAllocateCommandBuffers(set->vkGPU.device, &commandBufferAllocateInfo, set->commandBuffers.data());
+}
+VkResult recordVulkanResample(VkResampleContext* context, VkResampleBufferSet* set, uint32_t batch) {
+	//upload, unpack+FFT+shift+iFFT+sharpen/pack and readback of the whole batch in one command buffer. Buffers, plans and the staging frame of the set do not change, so it is recorded once and replayed by every submit
+	//all batchSize images of the set are transformed and transferred, the last batch of a run may have fewer valid ones
+	//in transfer queue mode the upload and the readback are recorded in command buffers of the transfer queue family. rgbBuffer is released and acquired between the families around them, semaphores of the set order the three submits
+	VkResult res = allocateCommandBuffers(set, 1);
+	if (res != VK_SUCCESS) return res;
+	VkCommandBuffer commandBuffer = set->commandBuffers[0];
+	VkCommandBuffer uploadCommandBuffer = (context->transferQueue) ? set->transferCommandBuffers[0] : commandBuffer;
+	VkCommandBuffer readbackCommandBuffer = (context->transferQueue) ? set->transferCommandBuffers[1] : commandBuffer;
+	uint32_t computeFamily = set->vkGPU.queueFamilyIndex;
+	uint32_t transferFamily = set->vkGPU.transferQueueFamilyIndex;
 	VkCommandBufferBeginInfo commandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	if (context->transferQueue) {
+		res = vkBeginCommandBuffer(uploadCommandBuffer, &commandBufferBeginInfo);
+		if (res != VK_SUCCESS) return res;
+	}
+	res = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	if (res != VK_SUCCESS) return res;
+	uint32_t query = 0;
+	if (set->timestampQueryPool) vkCmdResetQueryPool(commandBuffer, set->timestampQueryPool, 0, (uint32_t)set->timestampStages.size() + 1);
+	writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, &query);
+	VkBufferCopy copyRegion = { 0 };
+	copyRegion.srcOffset = set->stagingOffset;
+	copyRegion.dstOffset = 0;
+	copyRegion.size = context->batchSize * context->rgbInputSize;
+	vkCmdCopyBuffer(uploadCommandBuffer, context->staging.ring.buffer, set->rgbBuffer, 1, &copyRegion);
+	VkMemoryBarrier memory_barrier = {
+			VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			0,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+	};
+	if (context->transferQueue) {
+		appendOwnershipTransfer(uploadCommandBuffer, set->rgbBuffer, transferFamily, computeFamily, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		res = vkEndCommandBuffer(uploadCommandBuffer);
+		if (res != VK_SUCCESS) return res;
+		//the compute submit waits for uploadSemaphore at the compute shader stage, the acquire is chained to that wait
+		appendOwnershipTransfer(commandBuffer, set->rgbBuffer, transferFamily, computeFamily, 0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+	else
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+	writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, &query);
+	appendShiftApp(&set->appUnpack, commandBuffer);
+	writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, &query);
 	//Record commands batch times. Allows to perform multiple convolutions/transforms in one submit.
 	for (uint32_t i = 0; i < batch; i++) {
-		VkFFTAppend(app_forward, commandBuffer);
-		appendShiftApp(appShift, commandBuffer);
-		VkFFTAppend(app_inverse, commandBuffer);
-		appendShiftApp(appSharpen, commandBuffer);
+		if (set->timestampQueryPool) VkFFTAppendTimestamps(&set->app_forward, commandBuffer, set->timestampQueryPool, &query);
+		else VkFFTAppend(&set->app_forward, commandBuffer);
+		if (set->performShift) {
+			appendShiftApp(&set->appShift, commandBuffer);
+			writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, &query);
+		}
+		if (set->performDCT) {
+			appendShiftApp(&set->appDCT, commandBuffer);
+			writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, &query);
+		}
+		if (set->performCrop) {
+			appendShiftApp(&set->appCrop, commandBuffer);
+			writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, &query);
+		}
+		if (set->timestampQueryPool) VkFFTAppendTimestamps(&set->app_inverse, commandBuffer, set->timestampQueryPool, &query);
+		else VkFFTAppend(&set->app_inverse, commandBuffer);
 	}
-	vkEndCommandBuffer(commandBuffer);
+	appendShiftApp(&set->appPack, commandBuffer);
+	writeTimestamp(set, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, &query);
+	if (context->transferQueue) {
+		appendOwnershipTransfer(commandBuffer, set->rgbBuffer, computeFamily, transferFamily, VK_ACCESS_SHADER_WRITE_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		res = vkEndCommandBuffer(commandBuffer);
+		if (res != VK_SUCCESS) return res;
+		res = vkBeginCommandBuffer(readbackCommandBuffer, &commandBufferBeginInfo);
+		if (res != VK_SUCCESS) return res;
+		//the readback waits for computeSemaphore at the transfer stage. rgbBuffer stays with the transfer family, the next upload writes it there
+		appendOwnershipTransfer(readbackCommandBuffer, set->rgbBuffer, computeFamily, transferFamily, 0, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
+	else {
+		memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+	}
+	copyRegion.srcOffset = 0;
+	copyRegion.dstOffset = set->stagingOffset + context->stagingOutputOffset;
+	copyRegion.size = context->batchSize * context->outputSize;
+	vkCmdCopyBuffer(readbackCommandBuffer, set->rgbBuffer, context->staging.ring.buffer, 1, &copyRegion);
+	writeTimestamp(set, readbackCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, &query);
+	memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memory_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(readbackCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+	return vkEndCommandBuffer(readbackCommandBuffer);
+}
+VkResult submitRecorded(VkResampleContext* context, VkResampleBufferSet* set, VkCommandBuffer commandBuffer, VkBool32 transferQueue, double* time) {
+	//submit a recorded command buffer and wait for the fence of the set. time is set to the time from submit to the signaled fence in ms
+	//with transferQueue the upload and readback command buffers of the set are submitted to the transfer queue before and after it, the fence is signaled by the readback
+	VkGPU* vkGPU = &set->vkGPU;
+	VkResult res = VK_SUCCESS;
 	VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 	auto timeSubmit = std::chrono::system_clock::now();
-	vkQueueSubmit(vkGPU->queue, 1, &submitInfo, vkGPU->fence);
-	vkWaitForFences(vkGPU->device, 1, &vkGPU->fence, VK_TRUE, 100000000000);
+	{
+		std::lock_guard<std::mutex> lock(context->statsMutex);
+		if (context->numInFlight == 0) context->gpuBusyStart = timeSubmit;
+		context->numInFlight++;
+	}
+	if (transferQueue) {
+		VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		VkPipelineStageFlags transferWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		VkSubmitInfo uploadSubmitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		uploadSubmitInfo.commandBufferCount = 1;
+		uploadSubmitInfo.pCommandBuffers = &set->transferCommandBuffers[0];
+		uploadSubmitInfo.signalSemaphoreCount = 1;
+		uploadSubmitInfo.pSignalSemaphores = &set->uploadSemaphore;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &set->uploadSemaphore;
+		submitInfo.pWaitDstStageMask = &computeWaitStage;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &set->computeSemaphore;
+		VkSubmitInfo readbackSubmitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		readbackSubmitInfo.waitSemaphoreCount = 1;
+		readbackSubmitInfo.pWaitSemaphores = &set->computeSemaphore;
+		readbackSubmitInfo.pWaitDstStageMask = &transferWaitStage;
+		readbackSubmitInfo.commandBufferCount = 1;
+		readbackSubmitInfo.pCommandBuffers = &set->transferCommandBuffers[1];
+		res = submitToQueueWithFence(vkGPU->transferQueue, vkGPU->transferQueueMutex, &uploadSubmitInfo, VK_NULL_HANDLE);
+		if (res == VK_SUCCESS) res = submitToQueueWithFence(vkGPU->queue, vkGPU->queueMutex, &submitInfo, VK_NULL_HANDLE);
+		if (res == VK_SUCCESS) res = submitToQueueWithFence(vkGPU->transferQueue, vkGPU->transferQueueMutex, &readbackSubmitInfo, vkGPU->fence);
+	}
+	else
+		res = submitToQueue(vkGPU, &submitInfo);
+	auto timeSubmitted = std::chrono::system_clock::now();
+	//the fence is signaled only if all submits succeeded. Timeout is returned as VK_TIMEOUT and treated as a failure too
+	if (res == VK_SUCCESS) res = vkWaitForFences(vkGPU->device, 1, &vkGPU->fence, VK_TRUE, 100000000000);
 	auto timeEnd = std::chrono::system_clock::now();
-	double totTime = std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeSubmit).count() * 0.001;
-	//printf("Pure submit execution time per batch: %.3f ms\n", totTime / batch);
-	vkResetFences(vkGPU->device, 1, &vkGPU->fence);
-	vkFreeCommandBuffers(vkGPU->device, vkGPU->commandPool, 1, &commandBuffer);
-	return totTime / batch;
-}
-static VkResult launchResample(VkResampleConfiguration config) {
-	//Sample Vulkan project GPU initialization.
-	VkGPU vkGPU = {};
-	vkGPU.device_id = config.device_id;
-	VkResult res = VK_SUCCESS;
-	//create instance - a connection between the application and the Vulkan library 
-	res = createInstance(&vkGPU);
-	if (res != VK_SUCCESS) {
-		printf("Instance creation failed, error code: %d\n", res);
-		return res;
+	{
+		//GPU is busy while at least one buffer set is in flight
+		std::lock_guard<std::mutex> lock(context->statsMutex);
+		context->numInFlight--;
+		if (context->numInFlight == 0) context->gpuBusyTime += std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - context->gpuBusyStart).count() * 0.001;
+		context->submitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(timeSubmitted - timeSubmit).count() * 0.000001;
+		context->numSubmits++;
 	}
-	//set up the debugging messenger 
-	res = setupDebugMessenger(&vkGPU);
 	if (res != VK_SUCCESS) {
-		printf("Debug messenger creation failed, error code: %d\n", res);
+		printf("Submit of the recorded command buffers failed, error code: %d\n", res);
 		return res;
 	}
-	//check if there are GPUs that support Vulkan and select one
-	res = findPhysicalDevice(&vkGPU);
-	if (res != VK_SUCCESS) {
-		printf("Physical device not found, error code: %d\n", res);
-		return res;
+	res = vkResetFences(vkGPU->device, 1, &vkGPU->fence);
+	time[0] = std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeSubmit).count() * 0.001;
+	return res;
+}
+VkResult recordTiledResample(VkResampleContext* context, VkResampleBufferSet* set, uint32_t batch) {
+	//one command buffer per row of tiles: upload of the input rows, unpack of the tiles as VkFFT batches, FFT+shift+iFFT, blend into the accumulator and sharpen/pack of the rows no later row of tiles contributes to
+	//the last packed row stays unfinished until the next row of tiles, as sharpening needs the row below it. Rows of tiles differ only in push constants, which are recorded with them
+	VkResampleTiling* tiling = &context->tiling;
+	VkResult res = allocateCommandBuffers(set, tiling->numTiles[1]);
+	if (res != VK_SUCCESS) return res;
+	uint32_t packStart = 0;
+	for (uint32_t r = 0; r < tiling->numTiles[1]; r++) {
+		uint32_t outputRowStart = r * tiling->outputStep[1];
+		uint32_t packEnd = (r + 1 < tiling->numTiles[1]) ? outputRowStart + tiling->outputStep[1] - 1 : context->outputHeight;
+		VkCommandBuffer commandBuffer = set->commandBuffers[r];
+		VkCommandBufferBeginInfo commandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		res = vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+		if (res != VK_SUCCESS) return res;
+		VkBufferCopy copyRegion = { 0 };
+		copyRegion.srcOffset = set->stagingOffset;
+		copyRegion.dstOffset = 0;
+		copyRegion.size = tiling->stripInputSize;
+		vkCmdCopyBuffer(commandBuffer, context->staging.ring.buffer, set->rgbBuffer, 1, &copyRegion);
+		VkMemoryBarrier memory_barrier = {
+				VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+				0,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT,
+		};
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+		appendShiftApp(&set->appUnpack, commandBuffer);
+		for (uint32_t i = 0; i < batch; i++) {
+			VkFFTAppend(&set->app_forward, commandBuffer);
+			if (set->performShift) appendShiftApp(&set->appShift, commandBuffer);
+			VkFFTAppend(&set->app_inverse, commandBuffer);
+		}
+		set->appBlend.pushConstants[0] = outputRowStart;
+		set->appBlend.pushConstants[1] = (r > 0) ? outputRowStart - tiling->outputStep[1] + tiling->outputTileSize[1] : 0;
+		set->appBlend.pushConstants[2] = ((r > 0) ? 1 : 0) | ((r + 1 < tiling->numTiles[1]) ? 2 : 0);
+		appendShiftApp(&set->appBlend, commandBuffer);
+		set->appPack.pushConstants[0] = packStart;
+		set->appPack.pushConstants[1] = packEnd;
+		appendShiftApp(&set->appPack, commandBuffer);
+		memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memory_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+		copyRegion.srcOffset = tiling->stripInputSize;
+		copyRegion.dstOffset = set->stagingOffset + context->stagingOutputOffset;
+		copyRegion.size = (VkDeviceSize)(packEnd - packStart) * context->outputPitch;
+		vkCmdCopyBuffer(commandBuffer, set->rgbBuffer, context->staging.ring.buffer, 1, &copyRegion);
+		memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memory_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+		res = vkEndCommandBuffer(commandBuffer);
+		if (res != VK_SUCCESS) return res;
+		packStart = packEnd;
 	}
-	//create logical device representation
-	res = createDevice(&vkGPU);
-	if (res != VK_SUCCESS) {
-		printf("Device creation failed, error code: %d\n", res);
-		return res;
+	return res;
+}
+VkResult recordResampleTimed(VkResampleContext* context, VkResampleBufferSet* set, uint32_t batch) {
+	//record the submits of the set and add the CPU time it took to the statistics
+	auto timeStart = std::chrono::system_clock::now();
+	VkResult res = (context->tiled) ? recordTiledResample(context, set, batch) : recordVulkanResample(context, set, batch);
+	double recordTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now() - timeStart).count() * 0.000001;
+	std::lock_guard<std::mutex> lock(context->statsMutex);
+	context->recordTime += recordTime;
+	return res;
+}
+VkResult performVulkanResample(VkResampleContext* context, VkResampleBufferSet* set, uint32_t batch, double* time) {
+	//the thread only waits for the fence of its buffer set. Input images are expected at the staging frame of the set, upscaled images are read back to stagingOutputOffset of it. time is set to the time per image in ms
+	VkResult res = VK_SUCCESS;
+	if (context->recordMode) {
+		//a failed recording leaves the command buffer unusable, so it is not submitted
+		res = recordResampleTimed(context, set, batch);
+		if (res != VK_SUCCESS) return res;
+	}
+	double totTime = 0;
+	res = submitRecorded(context, set, set->commandBuffers[0], context->transferQueue, &totTime);
+	if (res != VK_SUCCESS) return res;
+	//printf("Pure submit execution time per batch: %.3f ms\n", totTime / batch);
+	if (set->timestampQueryPool) collectTimestamps(context, set);
+	time[0] = totTime / batch;
+	return res;
+}
+VkResult performTiledResample(VkResampleContext* context, VkResampleBufferSet* set, const unsigned char* input, unsigned char* output, uint32_t batch, double* time) {
+	//one submit per row of tiles, input rows are copied to the staging frame of the set before each of them and the finished output rows are copied out after it
+	VkResampleTiling* tiling = &context->tiling;
+	uint32_t pixelSize = context->pixelSize;
+	char* staging = (char*)context->staging.ring.data + set->stagingOffset;
+	uint32_t packStart = 0;
+	double totTime = 0;
+	if (context->recordMode) {
+		VkResult res = recordResampleTimed(context, set, batch);
+		if (res != VK_SUCCESS) return res;
+	}
+	for (uint32_t r = 0; r < tiling->numTiles[1]; r++) {
+		uint32_t rowStart = r * tiling->step;
+		uint32_t outputRowStart = r * tiling->outputStep[1];
+		uint32_t packEnd = (r + 1 < tiling->numTiles[1]) ? outputRowStart + tiling->outputStep[1] - 1 : context->outputHeight;
+		//rows below the image repeat the last row
+		for (uint32_t y = 0; y < tiling->tileSize; y++) {
+			uint32_t inputRow = (rowStart + y < (uint32_t)context->height) ? rowStart + y : context->height - 1;
+			memcpy(staging + (uint64_t)y * context->width * pixelSize, input + (uint64_t)inputRow * context->width * pixelSize, (uint64_t)context->width * pixelSize);
+		}
+		double rowTime = 0;
+		VkResult res = submitRecorded(context, set, set->commandBuffers[r], false, &rowTime);
+		if (res != VK_SUCCESS) return res;
+		totTime += rowTime;
+		memcpy(output + (uint64_t)packStart * context->outputPitch, staging + context->stagingOutputOffset, (uint64_t)(packEnd - packStart) * context->outputPitch);
+		packStart = packEnd;
 	}
+	time[0] = totTime / batch;
+	return VK_SUCCESS;
+}
+VkResult createTimestampQueries(VkResampleContext* context, VkResampleConfiguration* config, VkResampleBufferSet* set) {
+	//query pool for the timestamps written by recordVulkanResample. Stages are: upload, unpack, each forward FFT kernel, shift (DCT spectrum in DCT mode), each inverse FFT kernel, pack and readback
+	VkResult res = VK_SUCCESS;
+	//number of kernels is known only after VkFFT has planned the transform, so it is counted by recording them once without a query pool
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+	commandBufferAllocateInfo.commandPool = set->vkGPU.commandPool;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAllocateInfo.commandBufferCount = 1;
+	VkCommandBuffer commandBuffer = {};
+	res = vkAllocateCommandBuffers(set->vkGPU.device, &commandBufferAllocateInfo, &commandBuffer);
+	if (res != VK_SUCCESS) return res;
+	VkCommandBufferBeginInfo commandBufferBeginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+	commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+	uint32_t numForwardKernels = 0;
+	uint32_t numInverseKernels = 0;
+	VkFFTAppendTimestamps(&set->app_forward, commandBuffer, VK_NULL_HANDLE, &numForwardKernels);
+	VkFFTAppendTimestamps(&set->app_inverse, commandBuffer, VK_NULL_HANDLE, &numInverseKernels);
+	vkEndCommandBuffer(commandBuffer);
+	vkFreeCommandBuffers(set->vkGPU.device, set->vkGPU.commandPool, 1, &commandBuffer);
+
+	if (context->timestampStageNames.size() == 0) {
+		char name[50];
+		context->timestampStageNames.push_back("upload");
+		context->timestampStageNames.push_back("unpack");
+		for (uint32_t i = 0; i < numForwardKernels; i++) {
+			sprintf(name, "forward FFT kernel %d", i);
+			context->timestampStageNames.push_back(name);
+		}
+		context->timestampStageNames.push_back((set->performDCT) ? "dct spectrum" : ((set->performCrop) ? "crop" : "shift"));
+		for (uint32_t i = 0; i < numInverseKernels; i++) {
+			sprintf(name, "inverse FFT kernel %d", i);
+			context->timestampStageNames.push_back(name);
+		}
+		context->timestampStageNames.push_back("sharpen+pack");
+		context->timestampStageNames.push_back("readback");
+		context->timestampStageNames.push_back("whole submit");
+		context->timestampSamples.resize(context->timestampStageNames.size());
+	}
+	//order in which recordVulkanResample writes the timestamps
+	set->timestampStages.push_back(0);
+	set->timestampStages.push_back(1);
+	for (uint32_t i = 0; i < config->numIter; i++) {
+		for (uint32_t j = 0; j < numForwardKernels; j++)
+			set->timestampStages.push_back(2 + j);
+		if (set->performShift || set->performDCT || set->performCrop) set->timestampStages.push_back(2 + numForwardKernels);
+		for (uint32_t j = 0; j < numInverseKernels; j++)
+			set->timestampStages.push_back(3 + numForwardKernels + j);
+	}
+	set->timestampStages.push_back(3 + numForwardKernels + numInverseKernels);
+	set->timestampStages.push_back(4 + numForwardKernels + numInverseKernels);
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = (uint32_t)set->timestampStages.size() + 1;
+	res = vkCreateQueryPool(set->vkGPU.device, &queryPoolCreateInfo, NULL, &set->timestampQueryPool);
+	return res;
+}
+void printTimestamps(VkResampleContext* context) {
+	//min, median and 99th percentile of the GPU time of each stage
+	printf("GPU stage timings, ms:\n");
+	for (uint32_t i = 0; i < context->timestampSamples.size(); i++) {
+		std::vector<double>& samples = context->timestampSamples[i];
+		if (samples.size() == 0) continue;
+		std::sort(samples.begin(), samples.end());
+		uint32_t p99 = (uint32_t)ceil(0.99 * samples.size()) - 1;
+		printf("	%s: min %0.3f median %0.3f p99 %0.3f (%d samples)\n", context->timestampStageNames[i].c_str(), samples[0], samples[samples.size() / 2], samples[p99], (uint32_t)samples.size());
+	}
+}
+static void setInverseBuffers(VkResampleBufferSet* set, VkFFTConfiguration* inverse_configuration, VkBool32 swap) {
+	//spectrum computed out of place by the DCT or crop app is in tempBuffer, then the inverse FFT works on tempBuffer and buffer is swapped in as its temporary buffer
+	VkBuffer* inverseBuffer = (swap) ? &set->tempBuffer : &set->buffer;
+	VkBuffer* inverseTempBuffer = (swap) ? &set->buffer : &set->tempBuffer;
+	inverse_configuration->buffer = inverseBuffer;
+	inverse_configuration->tempBuffer = inverseTempBuffer;
+	inverse_configuration->inputBuffer = inverseBuffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
+	if (inverse_configuration->performR2C)
+		inverse_configuration->outputBuffer = inverseTempBuffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
+	else
+		inverse_configuration->outputBuffer = inverseBuffer;
+}
+VkResult createResampleBufferSet(VkResampleContext* context, VkResampleConfiguration* config, VkResampleBufferSet* set) {
+	//allocate buffers and initialize FFT and shader applications of one buffer set. Each set has its own command pool and fence, device and queue are shared
+	VkResult res = VK_SUCCESS;
+	set->vkGPU = context->vkGPU;
 	//create fence for synchronization 
-	res = createFence(&vkGPU);
+	res = createFence(&set->vkGPU);
 	if (res != VK_SUCCESS) {
 		printf("Fence creation failed, error code: %d\n", res);
 		return res;
 	}
 	//create a place, command buffer memory is allocated from
-	res = createCommandPool(&vkGPU);
+	res = createCommandPool(&set->vkGPU, set->vkGPU.queueFamilyIndex, &set->vkGPU.commandPool);
 	if (res != VK_SUCCESS) {
-		printf("Fence creation failed, error code: %d\n", res);
+		printf("Command pool creation failed, error code: %d\n", res);
 		return res;
 	}
-	vkGetPhysicalDeviceProperties(vkGPU.physicalDevice, &vkGPU.physicalDeviceProperties);
-	vkGetPhysicalDeviceMemoryProperties(vkGPU.physicalDevice, &vkGPU.physicalDeviceMemoryProperties);
+	if (context->transferQueue) {
+		//upload and readback command buffers are recorded from the pool of the transfer queue family, semaphores order them with the compute submit
+		res = createCommandPool(&set->vkGPU, set->vkGPU.transferQueueFamilyIndex, &set->transferCommandPool);
+		if (res != VK_SUCCESS) {
+			printf("Transfer command pool creation failed, error code: %d\n", res);
+			return res;
+		}
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		commandBufferAllocateInfo.commandPool = set->transferCommandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = 2;
+		res = vkAllocateCommandBuffers(set->vkGPU.device, &commandBufferAllocateInfo, set->transferCommandBuffers);
+		if (res != VK_SUCCESS) return res;
+		VkSemaphoreCreateInfo semaphoreCreateInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+		res = vkCreateSemaphore(set->vkGPU.device, &semaphoreCreateInfo, NULL, &set->uploadSemaphore);
+		if (res != VK_SUCCESS) return res;
+		res = vkCreateSemaphore(set->vkGPU.device, &semaphoreCreateInfo, NULL, &set->computeSemaphore);
+		if (res != VK_SUCCESS) return res;
+	}
+	set->inputBufferSize = context->inputBufferSize;
+	set->bufferSize = context->bufferSize;
+	//Allocate buffers for the input data and the FFTs. They share one range: inputBuffer is dead after the forward FFT, so tempBuffer overlaps it, unless the forward FFT transposes through tempBuffer or -n repeats the forward FFT
+	VkBuffer* fftBuffers[3] = { &set->inputBuffer, &set->buffer, &set->tempBuffer };
+	VkDeviceSize fftBufferSizes[3] = { set->inputBufferSize, set->bufferSize, set->bufferSize };
+	res = allocateAliasedBuffers(&set->vkGPU, 3, fftBuffers, fftBufferSizes, context->fftRangeStages, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &set->fftAllocation);
+	if (res != VK_SUCCESS) return res;
+	res = allocateFFTBuffer(&set->vkGPU, &set->rgbBuffer, &set->rgbBufferAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context->rgbBufferSize);
+	if (res != VK_SUCCESS) return res;
+	if (context->tiled) {
+		res = allocateFFTBuffer(&set->vkGPU, &set->tileBuffer, &set->tileBufferAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context->tiling.tileBufferSize);
+		if (res != VK_SUCCESS) return res;
+	}
+	if (context->chromaBufferSize) {
+		res = allocateFFTBuffer(&set->vkGPU, &set->chromaBuffer, &set->chromaBufferAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, context->chromaBufferSize);
+		if (res != VK_SUCCESS) return res;
+	}
 
-	uint32_t isCompilerInitialized = 1;
-	if (config.threadId == 0)
-		printf("VkResample - FFT based upscaling\n");
-	uint32_t complexSize = 2 * sizeof(float);
-	uint32_t complexSizeCalc = 2 * sizeof(float);
-	switch (config.precision) {
-	case 0: {
-		complexSize = 2 * sizeof(float);
-		break;
+	//After this, configuration file contains pointers to Vulkan objects needed to work with the GPU: VkDevice* device - created device, [VkDeviceSize *bufferSize, VkBuffer *buffer, VkDeviceMemory* bufferDeviceMemory] - allocated GPU memory FFT is performed on. [VkDeviceSize *kernelSize, VkBuffer *kernel, VkDeviceMemory* kernelDeviceMemory] - allocated GPU memory, where kernel for convolution is stored.
+	VkFFTConfiguration forward_configuration = context->forward_configuration;
+	forward_configuration.device = &set->vkGPU.device;
+	forward_configuration.queue = &set->vkGPU.queue; //to allocate memory for LUT, we have to pass a queue, vkGPU.fence, commandPool and physicalDevice pointers 
+	forward_configuration.fence = &set->vkGPU.fence;
+	forward_configuration.commandPool = &set->vkGPU.commandPool;
+	forward_configuration.physicalDevice = &set->vkGPU.physicalDevice;
+	forward_configuration.buffer = &set->buffer;
+	forward_configuration.tempBuffer = &set->tempBuffer;
+	forward_configuration.inputBuffer = &set->inputBuffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
+	forward_configuration.outputBuffer = &set->buffer;
+
+	forward_configuration.bufferSize = &set->bufferSize;
+	forward_configuration.tempBufferSize = &set->bufferSize;
+	forward_configuration.inputBufferSize = &set->inputBufferSize;
+	forward_configuration.outputBufferSize = &set->bufferSize;
+
+	VkFFTConfiguration inverse_configuration = context->inverse_configuration;
+	inverse_configuration.device = forward_configuration.device;
+	inverse_configuration.queue = forward_configuration.queue;
+	inverse_configuration.fence = forward_configuration.fence;
+	inverse_configuration.commandPool = forward_configuration.commandPool;
+	inverse_configuration.physicalDevice = forward_configuration.physicalDevice;
+	inverse_configuration.bufferSize = &set->bufferSize;
+	inverse_configuration.tempBufferSize = &set->bufferSize;
+	inverse_configuration.inputBufferSize = &set->bufferSize;
+	inverse_configuration.outputBufferSize = &set->bufferSize;
+	//DCT spectrum and the cropped spectrum are computed out of place from buffer to tempBuffer
+	set->performDCT = (config->transform == 1) ? true : false;
+	VkBool32 downscale = ((inverse_configuration.size[0] < forward_configuration.size[0]) || (inverse_configuration.size[1] < forward_configuration.size[1])) ? true : false;
+	//if the other axis is upscaled, the spectrum is cropped and zero-padded out of place
+	VkBool32 anamorphic = ((downscale) && ((inverse_configuration.size[0] > forward_configuration.size[0]) || (inverse_configuration.size[1] > forward_configuration.size[1]))) ? true : false;
+	set->performCrop = ((downscale) && ((config->shiftPass) || (anamorphic)) && (!set->performDCT)) ? true : false;
+	setInverseBuffers(set, &inverse_configuration, (set->performDCT) || (set->performCrop));
+
+	//Initialize applications. This function loads shaders, creates pipeline and configures FFT based on configuration file. No buffer allocations inside VkFFT library.  
+	res = initializeVulkanFFT(&set->app_forward, forward_configuration);
+	if (res != VK_SUCCESS) return res;
+	if ((VkFFTPlanUsesTempBuffer(&set->app_forward)) && (!context->forwardUsesTempBuffer)) {
+		//tempBuffer overlaps inputBuffer, which the forward FFT still reads
+		printf("Forward FFT uses tempBuffer, but the memory plan expected it not to\n");
+		return VK_ERROR_INITIALIZATION_FAILED;
 	}
-	case 1: {
-		complexSize = 2 * sizeof(double);
-		complexSizeCalc = 2 * sizeof(double);
-		break;
+	//inverse FFT reads the upper frequencies from where the forward FFT left them, so no separate shift dispatch is needed. DCT spectrum is not wrapped, so there is nothing to shift
+	inverse_configuration.splitSpectrum = ((config->shiftPass) || (set->performDCT) || (downscale)) ? false : true;
+	//downscaled inverse FFT reads only the retained band of the forward spectrum, the spectrum of the output size is never stored
+	inverse_configuration.cropSpectrum = ((downscale) && (!set->performCrop) && (!set->performDCT)) ? true : false;
+	res = initializeVulkanFFT(&set->app_inverse, inverse_configuration);
+	if (res == VK_ERROR_FEATURE_NOT_PRESENT) {
+		//four step inverse FFT can not read the split or cropped spectrum in place
+		deleteVulkanFFT(&set->app_inverse);
+		inverse_configuration.splitSpectrum = false;
+		if (inverse_configuration.cropSpectrum) {
+			inverse_configuration.cropSpectrum = false;
+			set->performCrop = true;
+			setInverseBuffers(set, &inverse_configuration, true);
+		}
+		res = initializeVulkanFFT(&set->app_inverse, inverse_configuration);
 	}
-	case 2: {
-		complexSize = 2 * sizeof(half);
-		break;
+	if (res != VK_SUCCESS) return res;
+	set->performShift = ((inverse_configuration.splitSpectrum) || (set->performDCT) || (downscale)) ? false : true;
+
+	VkShiftApplication* appShift = &set->appShift;
+	appShift->r2c = forward_configuration.performR2C;
+	appShift->precision = config->precision;
+	if (appShift->precision == 2) appShift->precision = 0;
+	if (forward_configuration.performR2C)
+		appShift->size[0] = forward_configuration.size[0] / 2;
+	else
+		appShift->size[0] = forward_configuration.size[0];
+	appShift->size[1] = forward_configuration.size[1];
+	appShift->size[2] = forward_configuration.size[2];
+	//appShift->localSize[0] = forward_configuration.coalescedMemory / complexSize;
+	//appShift->localSize[1] = forward_configuration.coalescedMemory / complexSize;
+	uint32_t availablePow2 = log2(forward_configuration.warpSize);
+	appShift->localSize[0] = 1;
+	appShift->localSize[1] = 1;
+	for (uint32_t i = 0; i < log2(forward_configuration.warpSize) + 1; i++) {
+		if (appShift->size[0] % ((uint32_t)pow(2, i)) != 0) {
+			availablePow2 = i - 1;
+			i = log2(forward_configuration.warpSize) + 1;
+		}
+	}
+	appShift->localSize[0] = pow(2, availablePow2);
+	if (pow(2, availablePow2) < forward_configuration.warpSize) {
+		uint32_t availablePow2y = log2(forward_configuration.warpSize) - availablePow2;
+		for (uint32_t i = 0; i < log2(forward_configuration.warpSize) + 1 - availablePow2; i++) {
+			if (appShift->size[1] % ((uint32_t)pow(2, i)) != 0) {
+				availablePow2y = i - 1;
+				i = log2(forward_configuration.warpSize) + 1 - availablePow2;
+			}
+		}
+		appShift->localSize[1] = pow(2, availablePow2y);
+	}
+
+	appShift->localSize[2] = 1;
+	if (forward_configuration.performR2C) {
+		appShift->inputStride[0] = forward_configuration.bufferStride[0] / 2;
+		appShift->inputStride[1] = forward_configuration.bufferStride[1];
+		appShift->inputStride[2] = (forward_configuration.bufferStride[0] / 2 + 1) * forward_configuration.bufferStride[1];
 	}
+	else
+	{
+		appShift->inputStride[0] = forward_configuration.bufferStride[0];
+		appShift->inputStride[1] = forward_configuration.bufferStride[1];
+		appShift->inputStride[2] = (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1];
 	}
+	appShift->numCoordinates = context->planes * forward_configuration.numberBatches;
+	appShift->inputBuffer = &set->buffer;
+	appShift->inputBufferSize = set->bufferSize;
+	appShift->outputBuffer = &set->buffer;
+	appShift->outputBufferSize = set->bufferSize;
 
-	//Configuration + FFT application .
-	VkFFTConfiguration forward_configuration = defaultVkFFTConfiguration;
-	VkFFTConfiguration inverse_configuration = defaultVkFFTConfiguration;
-	VkFFTApplication app_forward;
-	VkFFTApplication app_inverse;
+	if (set->performShift) {
+		res = createShiftApp(&set->vkGPU, appShift);
+		if (res != VK_SUCCESS) return res;
+	}
+	if (set->performDCT) {
+		VkShiftApplication* appDCT = &set->appDCT;
+		*appDCT = *appShift;
+		appDCT->imageSize[0] = forward_configuration.size[0];
+		appDCT->imageSize[1] = forward_configuration.size[1];
+		appDCT->fftSize[0] = inverse_configuration.size[0];
+		appDCT->fftSize[1] = inverse_configuration.size[1];
+		appDCT->size[0] = (forward_configuration.performR2C) ? inverse_configuration.size[0] / 2 + 1 : inverse_configuration.size[0];
+		appDCT->size[1] = inverse_configuration.size[1];
+		appDCT->localSize[0] = 32;
+		appDCT->localSize[1] = 4;
+		appDCT->outputBuffer = &set->tempBuffer;
+		res = createDCTApp(&set->vkGPU, appDCT);
+		if (res != VK_SUCCESS) return res;
+	}
+	if (set->performCrop) {
+		VkShiftApplication* appCrop = &set->appCrop;
+		*appCrop = *appShift;
+		appCrop->imageSize[0] = forward_configuration.size[0];
+		appCrop->imageSize[1] = forward_configuration.size[1];
+		appCrop->fftSize[0] = inverse_configuration.size[0];
+		appCrop->fftSize[1] = inverse_configuration.size[1];
+		appCrop->size[0] = (forward_configuration.performR2C) ? inverse_configuration.size[0] / 2 + 1 : inverse_configuration.size[0];
+		appCrop->size[1] = inverse_configuration.size[1];
+		appCrop->localSize[0] = 32;
+		appCrop->localSize[1] = 4;
+		appCrop->outputBuffer = &set->tempBuffer;
+		res = createCropApp(&set->vkGPU, appCrop);
+		if (res != VK_SUCCESS) return res;
+	}
 
-	int width;
-	int height;
-	int channels;
-	char fileName[512] = "";
-	uint32_t numDigits = log10(config.numFiles) + 1;
-	if (config.fileUpload) {
-		sprintf(fileName, "%s/%06d.png", config.ifolder_prefix, config.threadId + 1);
+	//buffer, that holds the upscaled image after the inverse FFT
+	set->outputBuffer = (inverse_configuration.performR2C) ? inverse_configuration.outputBuffer : inverse_configuration.buffer;
+
+	//8-bit image conversion is done on GPU, so only raw png pixels are transferred
+	VkShiftApplication* appUnpack = &set->appUnpack;
+	appUnpack->r2c = forward_configuration.performR2C;
+	appUnpack->precision = config->precision;
+	appUnpack->size[0] = forward_configuration.size[0];
+	appUnpack->size[1] = forward_configuration.size[1];
+	appUnpack->size[2] = 1;
+	appUnpack->localSize[0] = 32;
+	appUnpack->localSize[1] = 4;
+	appUnpack->localSize[2] = 1;
+	appUnpack->imageSize[0] = context->width;
+	appUnpack->imageSize[1] = context->height;
+	appUnpack->imageSize[2] = context->channels;
+	appUnpack->bitDepth = context->bitDepth;
+	appUnpack->inputStride[0] = context->width;
+	appUnpack->inputStride[2] = (uint32_t)(context->rgbInputSize * 8 / context->bitDepth);
+	appUnpack->tileStep[0] = (context->tiled) ? context->tiling.step : 0;
+	appUnpack->dct = set->performDCT;
+	appUnpack->outputStride[0] = forward_configuration.size[0];
+	appUnpack->outputStride[2] = (forward_configuration.performR2C) ? (forward_configuration.size[0] + 2) * forward_configuration.size[1] : forward_configuration.size[0] * forward_configuration.size[1];
+	appUnpack->numCoordinates = context->planes * forward_configuration.numberBatches;
+	appUnpack->inputBuffer = &set->rgbBuffer;
+	appUnpack->inputBufferSize = context->rgbBufferSize;
+	appUnpack->outputBuffer = &set->inputBuffer;
+	appUnpack->outputBufferSize = set->inputBufferSize;
+	if (context->chromaBufferSize) {
+		appUnpack->color = 1;
+		appUnpack->auxBuffer = &set->chromaBuffer;
+		appUnpack->auxBufferSize = context->chromaBufferSize;
+	}
+	res = createUnpackApp(&set->vkGPU, appUnpack);
+	if (res != VK_SUCCESS) return res;
+
+	VkShiftApplication* appPack = &set->appPack;
+	appPack->r2c = inverse_configuration.performR2C;
+	appPack->precision = config->precision;
+	appPack->sharpenCoeff = config->sharpenConst;
+	appPack->imageSize[0] = context->outputWidth;
+	appPack->imageSize[1] = context->outputHeight;
+	appPack->imageSize[2] = context->channels;
+	appPack->bitDepth = context->bitDepth;
+	appPack->dct = set->performDCT;
+	appPack->fftSize[0] = inverse_configuration.size[0];
+	appPack->fftSize[1] = inverse_configuration.size[1];
+	appPack->size[0] = (context->outputWidth + 3) / 4;
+	appPack->size[1] = context->outputHeight;
+	appPack->size[2] = 1;
+	//128 pixels wide tile rows, so every row of the shared memory tile is loaded by the group as a few whole cache lines, 4 rows of the group keep the 2 halo rows at a third of the tile
+	appPack->localSize[0] = 32;
+	appPack->localSize[1] = 4;
+	appPack->localSize[2] = 1;
+	appPack->inputStride[0] = inverse_configuration.outputBufferStride[0];
+	appPack->inputStride[2] = (inverse_configuration.performR2C) ? (inverse_configuration.outputBufferStride[0] + 2) * inverse_configuration.outputBufferStride[1] : inverse_configuration.outputBufferStride[0] * inverse_configuration.outputBufferStride[1];
+	appPack->outputStride[2] = context->outputSize / 4;
+	appPack->numCoordinates = context->batchSize;
+	appPack->inputBuffer = set->outputBuffer;
+	appPack->inputBufferSize = set->bufferSize;
+	appPack->outputBuffer = &set->rgbBuffer;
+	appPack->outputBufferSize = context->rgbBufferSize;
+	if (context->chromaBufferSize) {
+		appPack->color = 1;
+		appPack->chromaSize[0] = forward_configuration.size[0];
+		appPack->chromaSize[1] = forward_configuration.size[1];
+		appPack->auxBuffer = &set->chromaBuffer;
+		appPack->auxBufferSize = context->chromaBufferSize;
+	}
+	if (context->tiled) {
+		//blend the inverse FFT results of a row of tiles into the accumulator, pack reads finished rows from it to the output strip after the input strip
+		VkShiftApplication* appBlend = &set->appBlend;
+		*appBlend = *appPack;
+		appBlend->imageSize[1] = context->outputHeight;
+		appBlend->size[0] = context->outputWidth;
+		appBlend->size[1] = context->tiling.outputTileSize[1];
+		appBlend->localSize[0] = 32;
+		appBlend->localSize[1] = 4;
+		appBlend->tileSize[0] = context->tiling.outputTileSize[0];
+		appBlend->tileSize[1] = context->tiling.outputTileSize[1];
+		appBlend->tileStep[0] = context->tiling.outputStep[0];
+		appBlend->tileStep[1] = context->tiling.outputStep[1];
+		appBlend->numTiles = context->tiling.numTiles[0];
+		appBlend->ringHeight = context->tiling.ringHeight;
+		appBlend->numCoordinates = 1;
+		appBlend->outputBuffer = &set->tileBuffer;
+		appBlend->outputBufferSize = context->tiling.tileBufferSize;
+		appBlend->pushConstantsSize = 3 * sizeof(uint32_t);
+		res = createBlendApp(&set->vkGPU, appBlend);
+		if (res != VK_SUCCESS) return res;
+		appPack->size[1] = context->tiling.ringHeight;
+		appPack->ringHeight = context->tiling.ringHeight;
+		appPack->outputOffset = (uint32_t)(context->tiling.stripInputSize / 4);
+		appPack->outputStride[2] = 0;
+		appPack->numCoordinates = 1;
+		appPack->inputBuffer = &set->tileBuffer;
+		appPack->inputBufferSize = context->tiling.tileBufferSize;
+		appPack->pushConstantsSize = 2 * sizeof(uint32_t);
+	}
+	res = createPackApp(&set->vkGPU, appPack);
+	if (res != VK_SUCCESS) return res;
+
+	set->timestampQueryPool = VK_NULL_HANDLE;
+	if (config->timestamps && set->vkGPU.timestampValidBits && (!context->tiled))
+		res = createTimestampQueries(context, config, set);
+	return res;
+}
+static void padImage(const unsigned char* input, uint32_t width, uint32_t height, uint32_t pixelSize, uint32_t paddedWidth, uint32_t paddedHeight, std::vector<unsigned char>& output) {
+	//mirror padding of the right and bottom edges, the same as in the unpack shader. Padding wider than the image repeats the first pixel
+	output.resize((uint64_t)paddedWidth * paddedHeight * pixelSize);
+	for (uint32_t j = 0; j < paddedHeight; j++) {
+		uint32_t y = (j < height) ? j : (uint32_t)std::max((int64_t)2 * height - 2 - j, (int64_t)0);
+		for (uint32_t i = 0; i < paddedWidth; i++) {
+			uint32_t x = (i < width) ? i : (uint32_t)std::max((int64_t)2 * width - 2 - i, (int64_t)0);
+			memcpy(&output[((uint64_t)i + (uint64_t)j * paddedWidth) * pixelSize], &input[((uint64_t)x + (uint64_t)y * width) * pixelSize], pixelSize);
+		}
 	}
+}
+static inline double loadSample(const unsigned char* data, uint64_t index, uint32_t bitDepth) {
+	//normalized sample index of an interleaved 8- or 16-bit image
+	return (bitDepth == 16) ? ((const uint16_t*)data)[index] / 65535.0 : data[index] / 255.0;
+}
+static inline void storeSample(unsigned char* data, uint64_t index, uint32_t bitDepth, double value) {
+	//value in [0,1] is truncated, the same as in the pack shader
+	if (bitDepth == 16)
+		((uint16_t*)data)[index] = (uint16_t)(65535.0 * value);
 	else
-		sprintf(fileName, "%s", config.png_input_name);
+		data[index] = (unsigned char)(255.0 * value);
+}
+static inline double pixelLuma(const unsigned char* data, uint64_t index, uint32_t bitDepth) {
+	//BT.601 full range luma of the RGB pixel starting at sample index, the same as in the unpack shader
+	return 0.299 * loadSample(data, index, bitDepth) + 0.587 * loadSample(data, index + 1, bitDepth) + 0.114 * loadSample(data, index + 2, bitDepth);
+}
+static void computeChroma(const unsigned char* input, uint32_t width, uint32_t height, uint32_t channels, uint32_t bitDepth, std::vector<float>& chroma) {
+	//YCbCr mode: Cb plane followed by Cr plane, in the layout of the chroma buffer of one image
+	uint64_t planeSize = (uint64_t)width * height;
+	chroma.resize(2 * planeSize);
+	for (uint64_t i = 0; i < planeSize; i++) {
+		double r = loadSample(input, i * channels, bitDepth);
+		double g = loadSample(input, i * channels + 1, bitDepth);
+		double b = loadSample(input, i * channels + 2, bitDepth);
+		chroma[i] = (float)(-0.168736 * r - 0.331264 * g + 0.5 * b);
+		chroma[i + planeSize] = (float)(0.5 * r - 0.418688 * g - 0.081312 * b);
+	}
+}
+static void packYCbCr(double luma, const float* chroma, uint32_t width, uint32_t height, uint32_t outputWidth, uint32_t outputHeight, uint32_t i, uint32_t j, VkBool32 dct, uint32_t bitDepth, unsigned char* data, uint64_t index) {
+	//YCbCr mode: chroma is sampled bilinearly at the input position of output pixel i, j and converted back to RGB with the sharpened luma, the same as in the pack shader
+	double offset = (dct) ? 0.5 : 0.0;
+	double position[2] = { (i + offset) * width / outputWidth - offset, (j + offset) * height / outputHeight - offset };
+	double size[2] = { (double)width - 1, (double)height - 1 };
+	uint32_t p0[2];
+	uint32_t p1[2];
+	double f[2];
+	for (uint32_t a = 0; a < 2; a++) {
+		position[a] = (position[a] < 0) ? 0 : ((position[a] > size[a]) ? size[a] : position[a]);
+		p0[a] = (uint32_t)position[a];
+		p1[a] = (p0[a] + 1 < size[a]) ? p0[a] + 1 : (uint32_t)size[a];
+		f[a] = position[a] - p0[a];
+	}
+	double cbcr[2];
+	for (uint32_t c = 0; c < 2; c++) {
+		const float* plane = chroma + (uint64_t)c * width * height;
+		double top = plane[p0[0] + (uint64_t)p0[1] * width] * (1 - f[0]) + plane[p1[0] + (uint64_t)p0[1] * width] * f[0];
+		double bottom = plane[p0[0] + (uint64_t)p1[1] * width] * (1 - f[0]) + plane[p1[0] + (uint64_t)p1[1] * width] * f[0];
+		cbcr[c] = top * (1 - f[1]) + bottom * f[1];
+	}
+	luma = (luma < 0.0) ? 0.0 : ((luma > 1.0) ? 1.0 : luma);
+	double rgb[3] = { luma + 1.402 * cbcr[1], luma - 0.344136 * cbcr[0] - 0.714136 * cbcr[1], luma + 1.772 * cbcr[0] };
+	for (uint32_t c = 0; c < 3; c++)
+		storeSample(data, index + c, bitDepth, (rgb[c] < 0.0) ? 0.0 : ((rgb[c] > 1.0) ? 1.0 : rgb[c]));
+}
+static inline VkBool32 retainedFrequency(uint32_t k, uint32_t size, uint32_t outputSize, uint32_t* k_out) {
+	//position of frequency k of a size-point spectrum in the outputSize-point spectrum: lower frequencies stay in place, upper frequencies are moved to its end. Frequencies that do not fit a smaller spectrum are dropped
+	uint32_t n = (size < outputSize) ? size : outputSize;
+	if (k < n / 2) {
+		*k_out = k;
+		return true;
+	}
+	if (k >= size - (n - n / 2)) {
+		*k_out = k + outputSize - size;
+		return true;
+	}
+	return false;
+}
+//CPU backend: the same pipeline as the GPU path for hosts without a usable Vulkan device
+//FFTs are vectorized across independent lines by the kernels of VkResampleCPUFFT.cpp: every element of a transform is a vector of kernel.lanes values of neighbouring rows or columns
+#if defined(VKRESAMPLE_AVX2)
+static VkBool32 cpuSupportsAVX2() {
+	//the AVX2 kernel also uses FMA. The OS has to save the upper halves of ymm registers
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	if (((info[2] & (1 << 12)) == 0) || ((info[2] & (1 << 27)) == 0) || ((info[2] & (1 << 28)) == 0)) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) ? true : false;
+#else
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? true : false;
+#endif
+}
+#endif
+VkResult initCPUFFTPlan(VkResampleCPUFFTPlan* plan, uint32_t size, double sign) {
+	//Stockham autosort plan: radix 4 first, then 2, 3, 5, 7, 11 and 13. Twiddles of each stage are precomputed
+	plan->size = size;
+	uint32_t n = size;
+	const uint32_t radices[7] = { 4, 2, 3, 5, 7, 11, 13 };
+	for (uint32_t i = 0; i < 7; i++) {
+		while (n % radices[i] == 0) {
+			plan->radix.push_back(radices[i]);
+			n /= radices[i];
+		}
+	}
+	if (n != 1) {
+		printf("CPU backend supports sizes decomposable as a multiplication of 2s, 3s, 5s, 7s, 11s and 13s, got %d\n", size);
+		return VK_ERROR_FEATURE_NOT_PRESENT;
+	}
+	n = size;
+	for (uint32_t k = 0; k < plan->radix.size(); k++) {
+		uint32_t p = plan->radix[k];
+		uint32_t m = n / p;
+		std::vector<float> twiddles(2 * (uint64_t)m * p);
+		for (uint32_t j = 0; j < m; j++) {
+			for (uint32_t t = 0; t < p; t++) {
+				twiddles[2 * ((uint64_t)j * p + t)] = (float)cos(sign * 2 * M_PI * j * t / n);
+				twiddles[2 * ((uint64_t)j * p + t) + 1] = (float)sin(sign * 2 * M_PI * j * t / n);
+			}
+		}
+		plan->twiddles.push_back(twiddles);
+		std::vector<float> roots(2 * p);
+		for (uint32_t t = 0; t < p; t++) {
+			roots[2 * t] = (float)cos(sign * 2 * M_PI * t / p);
+			roots[2 * t + 1] = (float)sin(sign * 2 * M_PI * t / p);
+		}
+		plan->roots.push_back(roots);
+		n = m;
+	}
+	plan->sign = sign;
+	plan->stages.size = size;
+	plan->stages.sign = (float)sign;
+	plan->stages.numStages = (uint32_t)plan->radix.size();
+	for (uint32_t k = 0; k < plan->radix.size(); k++) {
+		plan->stages.radix[k] = plan->radix[k];
+		plan->stages.twiddles[k] = plan->twiddles[k].data();
+		plan->stages.roots[k] = plan->roots[k].data();
+	}
+	return VK_SUCCESS;
+}
+static void runCPUTask(VkResampleCPUPool* pool, VkResampleCPUJob* job, std::unique_lock<std::mutex>& lock) {
+	//takes the next task of the job with the pool mutex locked and runs it unlocked. The job leaves the queue when its last task is taken
+	uint32_t i = job->nextTask++;
+	if (job->nextTask == job->numTasks) pool->jobs.erase(std::find(pool->jobs.begin(), pool->jobs.end(), job));
+	lock.unlock();
+	(*job->task)(i);
+	lock.lock();
+	job->numFinished++;
+	if (job->numFinished == job->numTasks) pool->jobFinished.notify_all();
+}
+static void cpuPoolWorker(VkResampleCPUPool* pool) {
+	std::unique_lock<std::mutex> lock(pool->mutex);
+	while (true) {
+		pool->workAvailable.wait(lock, [pool]() { return (pool->stop) || (pool->jobs.size() > 0); });
+		if (pool->jobs.size() == 0) return;
+		runCPUTask(pool, pool->jobs[0], lock);
+	}
+}
+void startCPUPool(VkResampleCPUPool* pool, uint32_t numThreads) {
+	pool->stop = false;
+	for (uint32_t i = 0; i < numThreads; i++)
+		pool->threads.push_back(std::thread(cpuPoolWorker, pool));
+}
+void stopCPUPool(VkResampleCPUPool* pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->stop = true;
+	}
+	pool->workAvailable.notify_all();
+	for (uint32_t i = 0; i < pool->threads.size(); i++)
+		pool->threads[i].join();
+	pool->threads.clear();
+}
+static void parallelFor(VkResampleCPUPool* pool, uint32_t numTasks, const std::function<void(uint32_t)>& task) {
+	//tasks are queued to the persistent pool threads. The calling thread runs tasks of its own job too and returns when all of them are finished
+	if (numTasks == 0) return;
+	VkResampleCPUJob job = { &task, numTasks, 0, 0 };
+	std::unique_lock<std::mutex> lock(pool->mutex);
+	pool->jobs.push_back(&job);
+	pool->workAvailable.notify_all();
+	while (job.nextTask < job.numTasks)
+		runCPUTask(pool, &job, lock);
+	pool->jobFinished.wait(lock, [&job]() { return job.numFinished == job.numTasks; });
+}
+void performCPUResampleImage(VkResampleContext* context, const unsigned char* input, unsigned char* output) {
+	//R2C row pass, column pass with the spectrum shift and zero padding between forward and inverse FFT, C2R row pass, CAS sharpen and pack
+	//Real rows are transformed in pairs, one as the real and one as the imaginary part of a complex FFT. Each pass is split in tasks over planes and blocks of rows or columns
+	//in YCbCr mode the planes are luma and alpha, chroma is upscaled bilinearly in the pack
+	VkResampleCPU* cpu = &context->cpu;
+	const uint32_t L = cpu->kernel.lanes;
+	uint32_t width = context->paddedWidth;
+	uint32_t height = context->paddedHeight;
+	uint32_t channels = context->channels;
+	uint32_t planes = context->planes;
+	uint32_t bitDepth = context->bitDepth;
+	VkBool32 color = context->color;
+	std::vector<unsigned char> paddedInput;
+	if ((width != (uint32_t)context->width) || (height != (uint32_t)context->height)) {
+		padImage(input, context->width, context->height, context->pixelSize, width, height, paddedInput);
+		input = paddedInput.data();
+	}
+	std::vector<float> chroma;
+	if (color) computeChroma(input, width, height, channels, bitDepth, chroma);
+	auto pixel = [&](uint32_t i, uint32_t j, uint32_t v) {
+		uint64_t index = ((uint64_t)i + (uint64_t)j * width) * channels;
+		return (float)(((color) && (v == 0)) ? pixelLuma(input, index, bitDepth) : loadSample(input, index + ((color) ? v + 2 : v), bitDepth));
+	};
+	uint32_t outputWidth = context->resampleWidth;
+	uint32_t outputHeight = context->resampleHeight;
+	uint32_t cropWidth = context->outputWidth;
+	uint32_t cropHeight = context->outputHeight;
+	uint32_t spectrumWidth = width / 2 + 1;
+	uint32_t outputSpectrumWidth = outputWidth / 2 + 1;
+	std::vector<float> spectrumRe((uint64_t)planes * height * spectrumWidth);
+	std::vector<float> spectrumIm((uint64_t)planes * height * spectrumWidth);
+	std::vector<float> outputSpectrumRe((uint64_t)planes * outputHeight * outputSpectrumWidth, 0);
+	std::vector<float> outputSpectrumIm((uint64_t)planes * outputHeight * outputSpectrumWidth, 0);
+	std::vector<float> image((uint64_t)planes * outputHeight * outputWidth);
+	float scale = (float)(1.0 / ((double)width * height));
+
+	//forward R2C along x: 2 * L rows per task
+	uint32_t rowBlocks = (height + 2 * L - 1) / (2 * L);
+	parallelFor(&cpu->pool, planes * rowBlocks, [&](uint32_t task) {
+		uint32_t v = task / rowBlocks;
+		uint32_t j0 = (task % rowBlocks) * 2 * L;
+		std::vector<float> buffer(4 * (uint64_t)width * L);
+		float* re = buffer.data();
+		float* im = re + (uint64_t)width * L;
+		for (uint32_t l = 0; l < L; l++) {
+			for (uint32_t i = 0; i < width; i++) {
+				re[i * L + l] = (j0 + 2 * l < height) ? pixel(i, j0 + 2 * l, v) : 0;
+				im[i * L + l] = (j0 + 2 * l + 1 < height) ? pixel(i, j0 + 2 * l + 1, v) : 0;
+			}
+		}
+		cpu->kernel.fft(&cpu->forwardX.stages, re, im, im + (uint64_t)width * L, im + 2 * (uint64_t)width * L);
+		for (uint32_t l = 0; l < L; l++) {
+			for (uint32_t r = 0; r < 2; r++) {
+				uint32_t j = j0 + 2 * l + r;
+				if (j >= height) break;
+				float* outRe = spectrumRe.data() + ((uint64_t)v * height + j) * spectrumWidth;
+				float* outIm = spectrumIm.data() + ((uint64_t)v * height + j) * spectrumWidth;
+				for (uint32_t i = 0; i < spectrumWidth; i++) {
+					uint32_t i_c = (width - i) % width;
+					float zr = re[i * L + l];
+					float zi = im[i * L + l];
+					float zcr = re[i_c * L + l];
+					float zci = im[i_c * L + l];
+					//separate spectra of the two real rows: X_even = (Z[k] + conj(Z[-k])) / 2, X_odd = (Z[k] - conj(Z[-k])) / 2i
+					outRe[i] = (r == 0) ? 0.5f * (zr + zcr) : 0.5f * (zi + zci);
+					outIm[i] = (r == 0) ? 0.5f * (zi - zci) : 0.5f * (zcr - zr);
+				}
+			}
+		}
+	});
+
+	//column pass: forward FFT along y, shift into the zero-padded spectrum and inverse FFT along y on blocks of L contiguous columns
+	uint32_t columnBlocks = (spectrumWidth + L - 1) / L;
+	parallelFor(&cpu->pool, planes * columnBlocks, [&](uint32_t task) {
+		uint32_t v = task / columnBlocks;
+		uint32_t i0 = (task % columnBlocks) * L;
+		uint32_t numColumns = (spectrumWidth - i0 < L) ? spectrumWidth - i0 : L;
+		std::vector<float> buffer(4 * (uint64_t)height * L + 4 * (uint64_t)outputHeight * L);
+		float* re = buffer.data();
+		float* im = re + (uint64_t)height * L;
+		float* workRe = im + (uint64_t)height * L;
+		float* workIm = workRe + (uint64_t)height * L;
+		float* outRe = workIm + (uint64_t)height * L;
+		float* outIm = outRe + (uint64_t)outputHeight * L;
+		float* outWorkRe = outIm + (uint64_t)outputHeight * L;
+		float* outWorkIm = outWorkRe + (uint64_t)outputHeight * L;
+		for (uint32_t j = 0; j < height; j++) {
+			const float* inRe = spectrumRe.data() + ((uint64_t)v * height + j) * spectrumWidth + i0;
+			const float* inIm = spectrumIm.data() + ((uint64_t)v * height + j) * spectrumWidth + i0;
+			for (uint32_t l = 0; l < L; l++) {
+				re[j * L + l] = (l < numColumns) ? inRe[l] : 0;
+				im[j * L + l] = (l < numColumns) ? inIm[l] : 0;
+			}
+		}
+		cpu->kernel.fft(&cpu->forwardY.stages, re, im, workRe, workIm);
+		memset(outRe, 0, 2 * (uint64_t)outputHeight * L * sizeof(float));
+		for (uint32_t j = 0; j < height; j++) {
+			uint32_t j_out;
+			if (!retainedFrequency(j, height, outputHeight, &j_out)) continue;
+			memcpy(outRe + (uint64_t)j_out * L, re + (uint64_t)j * L, L * sizeof(float));
+			memcpy(outIm + (uint64_t)j_out * L, im + (uint64_t)j * L, L * sizeof(float));
+		}
+		cpu->kernel.fft(&cpu->inverseY.stages, outRe, outIm, outWorkRe, outWorkIm);
+		uint32_t n = (width < outputWidth) ? width : outputWidth;
+		for (uint32_t l = 0; l < numColumns; l++) {
+			uint32_t i = i0 + l;
+			if (i > n / 2) continue;
+			uint32_t i_out = (i < n / 2) ? i : outputWidth / 2;
+			for (uint32_t j = 0; j < outputHeight; j++) {
+				outputSpectrumRe[((uint64_t)v * outputHeight + j) * outputSpectrumWidth + i_out] = outRe[j * L + l];
+				outputSpectrumIm[((uint64_t)v * outputHeight + j) * outputSpectrumWidth + i_out] = outIm[j * L + l];
+			}
+		}
+	});
+
+	//inverse C2R along x: two Hermitian rows are combined as A + iB, so the real and imaginary parts of one complex FFT are the two output rows
+	uint32_t outputRowBlocks = (outputHeight + 2 * L - 1) / (2 * L);
+	parallelFor(&cpu->pool, planes * outputRowBlocks, [&](uint32_t task) {
+		uint32_t v = task / outputRowBlocks;
+		uint32_t j0 = (task % outputRowBlocks) * 2 * L;
+		std::vector<float> buffer(4 * (uint64_t)outputWidth * L);
+		float* re = buffer.data();
+		float* im = re + (uint64_t)outputWidth * L;
+		for (uint32_t l = 0; l < L; l++) {
+			for (uint32_t r = 0; r < 2; r++) {
+				uint32_t j = j0 + 2 * l + r;
+				const float* inRe = outputSpectrumRe.data() + ((uint64_t)v * outputHeight + ((j < outputHeight) ? j : 0)) * outputSpectrumWidth;
+				const float* inIm = outputSpectrumIm.data() + ((uint64_t)v * outputHeight + ((j < outputHeight) ? j : 0)) * outputSpectrumWidth;
+				for (uint32_t i = 0; i < outputWidth; i++) {
+					float ar = 0;
+					float ai = 0;
+					if (j < outputHeight) {
+						//Hermitian extension of the row, imaginary parts of DC and Nyquist are ignored as in C2R
+						uint32_t i_h = (i < outputSpectrumWidth) ? i : outputWidth - i;
+						ar = inRe[i_h];
+						ai = ((i == 0) || (2 * i == outputWidth)) ? 0 : ((i < outputSpectrumWidth) ? inIm[i_h] : -inIm[i_h]);
+					}
+					if (r == 0) {
+						re[i * L + l] = ar;
+						im[i * L + l] = ai;
+					}
+					else {
+						re[i * L + l] -= ai;
+						im[i * L + l] += ar;
+					}
+				}
+			}
+		}
+		cpu->kernel.fft(&cpu->inverseX.stages, re, im, im + (uint64_t)outputWidth * L, im + 2 * (uint64_t)outputWidth * L);
+		for (uint32_t l = 0; l < L; l++) {
+			for (uint32_t r = 0; r < 2; r++) {
+				uint32_t j = j0 + 2 * l + r;
+				if (j >= outputHeight) break;
+				float* out = image.data() + ((uint64_t)v * outputHeight + j) * outputWidth;
+				const float* in = (r == 0) ? re : im;
+				for (uint32_t i = 0; i < outputWidth; i++) {
+					float value = fabsf(in[i * L + l] * scale);
+					out[i] = (value < 1.0f) ? value : 1.0f;
+				}
+			}
+		}
+	});
 
-	unsigned char* png_input = stbi_load(fileName, &width, &height, &channels, 3);
-	unsigned char* png_output = (unsigned char*)malloc((uint32_t)(config.upscale * config.upscale * width * height * channels) * sizeof(char));
-	if (png_input == 0) {
+	//CAS sharpen and 8-bit pack of the cropped part, same formula as the pack shader
+	uint32_t packRows = 16;
+	uint32_t packBlocks = (cropHeight + packRows - 1) / packRows;
+	float sharpenConst = context->cpu.sharpenConst;
+	parallelFor(&cpu->pool, packBlocks, [&](uint32_t task) {
+		for (uint32_t j = task * packRows; (j < (task + 1) * packRows) && (j < cropHeight); j++) {
+			unsigned char* out = output + (uint64_t)j * context->outputPitch;
+			memset(out + (uint64_t)cropWidth * context->pixelSize, 0, context->outputPitch - (uint64_t)cropWidth * context->pixelSize);
+			uint32_t y[3] = { (j > 0) ? j - 1 : 0, j, (j + 1 < cropHeight) ? j + 1 : cropHeight - 1 };
+			for (uint32_t v = 0; v < planes; v++) {
+				const float* rows[3];
+				for (uint32_t r = 0; r < 3; r++)
+					rows[r] = image.data() + ((uint64_t)v * outputHeight + y[r]) * outputWidth;
+				for (uint32_t i = 0; i < cropWidth; i++) {
+					uint32_t x[3] = { (i > 0) ? i - 1 : 0, i, (i + 1 < cropWidth) ? i + 1 : cropWidth - 1 };
+					float l[3][3];
+					for (uint32_t r = 0; r < 3; r++)
+						for (uint32_t c = 0; c < 3; c++)
+							l[r][c] = rows[r][x[c]];
+					float minL0 = std::min(l[0][1], std::min(l[1][0], std::min(l[1][1], std::min(l[1][2], l[2][1]))));
+					float minL1 = std::min(minL0, std::min(l[0][0], std::min(l[0][2], std::min(l[2][0], l[2][2]))));
+					float maxL0 = std::max(l[0][1], std::max(l[1][0], std::max(l[1][1], std::max(l[1][2], l[2][1]))));
+					float maxL1 = std::max(maxL0, std::max(l[0][0], std::max(l[0][2], std::max(l[2][0], l[2][2]))));
+					float minlen = 0.5f * (minL0 + minL1);
+					float maxlen = 0.5f * (maxL0 + maxL1);
+					minlen = minlen / (1.0f - minlen);
+					maxlen = (1.0f - maxlen) / maxlen;
+					float sharpen = -sharpenConst * sqrtf((minlen < maxlen) ? minlen : maxlen);
+					float value = (l[1][1] + sharpen * (l[0][1] + l[1][0] + l[1][2] + l[2][1])) / (1.0f + sharpen * 4.0f);
+					value = (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+					if ((color) && (v == 0))
+						packYCbCr(value, chroma.data(), width, height, outputWidth, outputHeight, i, j, false, bitDepth, out, (uint64_t)i * channels);
+					else
+						storeSample(out, (uint64_t)i * channels + ((color) ? v + 2 : v), bitDepth, value);
+				}
+			}
+		}
+	});
+}
+double performCPUResample(VkResampleContext* context, const unsigned char* input, unsigned char* output, uint32_t batch) {
+	//CPU counterpart of performVulkanResample: busy time is tracked the same way, so throughput of both backends is reported alike
+	auto timeStart = std::chrono::system_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(context->statsMutex);
+		if (context->numInFlight == 0) context->gpuBusyStart = timeStart;
+		context->numInFlight++;
+	}
+	for (uint32_t i = 0; i < batch; i++)
+		performCPUResampleImage(context, input, output);
+	auto timeEnd = std::chrono::system_clock::now();
+	{
+		std::lock_guard<std::mutex> lock(context->statsMutex);
+		context->numInFlight--;
+		if (context->numInFlight == 0) context->gpuBusyTime += std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - context->gpuBusyStart).count() * 0.001;
+	}
+	return std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeStart).count() * 0.001 / batch;
+}
+static VkBool32 isSmoothSize(uint32_t size) {
+	//sizes supported by VkFFT: multiplications of 2s, 3s, 5s and 7s
+	const uint32_t radices[4] = { 2, 3, 5, 7 };
+	for (uint32_t i = 0; i < 4; i++)
+		while (size % radices[i] == 0) size /= radices[i];
+	return (size == 1);
+}
+static uint32_t nextSmoothSize(uint32_t size) {
+	while (!isSmoothSize(size)) size++;
+	return size;
+}
+static VkBool32 selectPaddedSize(uint32_t size, uint32_t outputSize, uint32_t padMode, uint32_t* paddedSize, uint32_t* resampleSize) {
+	//sizes of the forward and inverse FFT of one axis. Input is padded to paddedSize and resampled to resampleSize, output is the first outputSize pixels
+	//smallest padding, for which both sizes are supported by VkFFT and have the ratio of size and outputSize, makes the output an exact crop. It is searched up to 25% above the smallest supported size
+	//otherwise the nearest supported sizes are used and the output is scaled by resampleSize / paddedSize instead of outputSize / size. Returns false then
+	uint32_t start = size;
+	if (padMode == 1) {
+		//Bluestein (chirp-z) transform of any size is a convolution of the next power of two length not smaller than 2 * size - 1
+		start = 1;
+		while (start < 2 * size - 1) start *= 2;
+	}
+	start = nextSmoothSize(start);
+	for (uint32_t padded = start; padded <= start + start / 4; padded++) {
+		if ((!isSmoothSize(padded)) || (((uint64_t)padded * outputSize) % size)) continue;
+		uint32_t resample = (uint32_t)((uint64_t)padded * outputSize / size);
+		if (!isSmoothSize(resample)) continue;
+		*paddedSize = padded;
+		*resampleSize = resample;
+		return 1;
+	}
+	*paddedSize = start;
+	*resampleSize = nextSmoothSize((uint32_t)(((uint64_t)start * outputSize + size - 1) / size));
+	return 0;
+}
+void selectImageFormat(VkResampleContext* context, VkResampleConfiguration* config, const char* fileName, int channels) {
+	//channels and bit depth of the first image are used for all images, the rest are converted to them on load
+	context->channels = channels;
+	context->bitDepth = (stbi_is_16_bit(fileName)) ? 16 : 8;
+	context->pixelSize = context->channels * context->bitDepth / 8;
+	context->color = ((config->color) && (context->channels >= 3)) ? 1 : 0;
+	if ((config->color) && (!context->color)) printf("Grayscale image has no chroma, -color ycbcr is ignored\n");
+	context->planes = (context->color) ? context->channels - 2 : context->channels;
+	if ((context->channels != 3) || (context->bitDepth != 8)) printf("Image format: %d channels, %d-bit\n", context->channels, context->bitDepth);
+}
+void selectOutputSize(VkResampleContext* context, VkResampleConfiguration* config) {
+	//output size is the -W/-H target or the input size multiplied by the upscale factor of each axis. Sizes VkFFT does not support are padded and cropped
+	context->outputWidth = (config->outputWidth) ? config->outputWidth : (uint32_t)(config->upscaleX * context->width);
+	context->outputHeight = (config->outputHeight) ? config->outputHeight : (uint32_t)(config->upscaleY * context->height);
+	//zero factor: a single -W or -H target, the other axis keeps the aspect ratio
+	if (config->upscaleX == 0) context->outputWidth = (uint32_t)((double)context->outputHeight * context->width / context->height + 0.5);
+	if (config->upscaleY == 0) context->outputHeight = (uint32_t)((double)context->outputWidth * context->height / context->width + 0.5);
+	if (context->outputWidth < 1) context->outputWidth = 1;
+	if (context->outputHeight < 1) context->outputHeight = 1;
+	VkBool32 exactWidth = selectPaddedSize(context->width, context->outputWidth, config->padMode, &context->paddedWidth, &context->resampleWidth);
+	VkBool32 exactHeight = selectPaddedSize(context->height, context->outputHeight, config->padMode, &context->paddedHeight, &context->resampleHeight);
+	if ((context->paddedWidth != (uint32_t)context->width) || (context->paddedHeight != (uint32_t)context->height))
+		printf("Input %dx%d is mirror-padded to %dx%d\n", context->width, context->height, context->paddedWidth, context->paddedHeight);
+	if ((context->resampleWidth != context->outputWidth) || (context->resampleHeight != context->outputHeight))
+		printf("Output %dx%d is cropped from %dx%d\n", context->outputWidth, context->outputHeight, context->resampleWidth, context->resampleHeight);
+	if (!exactWidth)
+		printf("Warning: no supported padding of width %d gives an exact crop, x scale is %0.5f instead of %0.5f\n", context->width, context->resampleWidth / (double)context->paddedWidth, context->outputWidth / (double)context->width);
+	if (!exactHeight)
+		printf("Warning: no supported padding of height %d gives an exact crop, y scale is %0.5f instead of %0.5f\n", context->height, context->resampleHeight / (double)context->paddedHeight, context->outputHeight / (double)context->height);
+}
+VkResult createResampleContextCPU(VkResampleContext* context, VkResampleConfiguration* config) {
+	//CPU backend needs no device, only FFT plans for the input and the upscaled resolution
+	if (config->transform == 1) {
+		printf("DCT mode is supported by the Vulkan backend only\n");
+		return VK_ERROR_FEATURE_NOT_PRESENT;
+	}
+	char fileName[512] = "";
+	if (config->fileUpload)
+		sprintf(fileName, "%s/%06d.png", config->ifolder_prefix, 1);
+	else
+		sprintf(fileName, "%s", config->png_input_name);
+	int width;
+	int height;
+	int channels;
+	if (!stbi_info(fileName, &width, &height, &channels)) {
 		printf("Image not found\n");
 		return VK_INCOMPLETE;
 	}
-	channels = 3;
-
-	//Setting up FFT configuration for forward and inverse FFT.
-	switch (vkGPU.physicalDeviceProperties.vendorID) {
+	context->width = width;
+	context->height = height;
+	selectImageFormat(context, config, fileName, channels);
+	context->numFiles = (config->fileUpload) ? config->numFiles : 1;
+	context->validationMinPSNR = INFINITY;
+	context->validationMinSSIM = 1.0;
+	context->batchSize = 1;
+	context->backend = 1;
+	context->cpu.sharpenConst = config->sharpenConst;
+	context->forward_configuration.performR2C = true;//output follows R2C conventions of the GPU path, used by -validate
+	selectOutputSize(context, config);
+	context->outputPitch = context->pixelSize * ((context->outputWidth + 3) / 4) * 4;
+	context->rgbInputSize = (((VkDeviceSize)context->pixelSize * context->width * context->height + 3) / 4) * 4;
+	context->outputSize = (VkDeviceSize)context->outputPitch * context->outputHeight;
+	//worker threads process different images, the rest of the cores split passes of one image
+	uint32_t numCores = std::thread::hardware_concurrency();
+	context->cpu.numThreads = (numCores > config->numThreads) ? numCores / config->numThreads : 1;
+	context->cpu.kernel = getCPUFFTKernelDefault();
+#if defined(VKRESAMPLE_AVX2)
+	if (cpuSupportsAVX2()) context->cpu.kernel = getCPUFFTKernelAVX2();
+#endif
+	VkResult res = initCPUFFTPlan(&context->cpu.forwardX, context->paddedWidth, -1);
+	if (res != VK_SUCCESS) return res;
+	res = initCPUFFTPlan(&context->cpu.forwardY, context->paddedHeight, -1);
+	if (res != VK_SUCCESS) return res;
+	res = initCPUFFTPlan(&context->cpu.inverseX, context->resampleWidth, 1);
+	if (res != VK_SUCCESS) return res;
+	res = initCPUFFTPlan(&context->cpu.inverseY, context->resampleHeight, 1);
+	if (res != VK_SUCCESS) return res;
+	//every worker thread runs the passes of its image and numThreads - 1 pool threads help it
+	startCPUPool(&context->cpu.pool, (context->cpu.numThreads - 1) * config->numThreads);
+	printf("CPU backend: %d threads per image, %s FFT kernel with %d SIMD lanes\n", context->cpu.numThreads, context->cpu.kernel.name, context->cpu.kernel.lanes);
+	return res;
+}
+void printMemoryReport(VkFFTMemoryAllocator* allocator) {
+	//usage of each block of the sub-allocator. Fragmentation is the part of free memory of shared blocks that is outside of the largest free range of its block, so it can only take smaller ranges
+	VkDeviceSize freeSize = 0;
+	VkDeviceSize fragmentedSize = 0;
+	uint32_t numBlocks = 0;
+	for (uint32_t i = 0; i < allocator->numBlocks; i++) {
+		VkFFTMemoryBlock* block = &allocator->blocks[i];
+		if (!block->memory) continue;
+		VkDeviceSize used = 0;
+		for (uint32_t j = 0; j < block->numRanges; j++)
+			used += block->rangeSize[j];
+		VkDeviceSize blockLargestFree = VkFFTMemoryBlockLargestFree(block);
+		VkMemoryPropertyFlags flags = allocator->memoryProperties.memoryTypes[block->memoryTypeIndex].propertyFlags;
+		printf("Memory block %d: %s%s, type %d, %.2f MB, %d ranges, used %.2f MB, largest free range %.2f MB\n", i, (block->dedicated) ? "dedicated " : "", (flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? "device local" : "host visible", block->memoryTypeIndex, block->size / 1024.0 / 1024.0, block->numRanges, used / 1024.0 / 1024.0, blockLargestFree / 1024.0 / 1024.0);
+		if (!block->dedicated) {
+			freeSize += block->size - used;
+			fragmentedSize += block->size - used - blockLargestFree;
+		}
+		numBlocks++;
+	}
+	double fragmentation = (freeSize) ? 100.0 * fragmentedSize / freeSize : 0;
+	printf("Memory allocator: %d ranges in %d blocks, %d vkAllocateMemory calls, %.2f MB used of %.2f MB allocated, fragmentation of free memory %.1f%%\n", allocator->numRanges, numBlocks, allocator->numDeviceAllocations, allocator->usedSize / 1024.0 / 1024.0, allocator->allocatedSize / 1024.0 / 1024.0, fragmentation);
+}
+VkDeviceSize getVRAMBudget(VkResampleContext* context, VkResampleConfiguration* config) {
+	//VRAM all buffer sets may take: -maxvram or half of the largest device local heap, the rest is left for LUTs, the driver and other applications
+	if (config->maxVRAM) return (VkDeviceSize)config->maxVRAM * 1024 * 1024;
+	VkDeviceSize heapSize = 0;
+	for (uint32_t i = 0; i < context->vkGPU.physicalDeviceMemoryProperties.memoryHeapCount; i++) {
+		if ((context->vkGPU.physicalDeviceMemoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && (context->vkGPU.physicalDeviceMemoryProperties.memoryHeaps[i].size > heapSize))
+			heapSize = context->vkGPU.physicalDeviceMemoryProperties.memoryHeaps[i].size;
+	}
+	return heapSize / 2;
+}
+void planFFTMemory(VkResampleContext* context, VkResampleConfiguration* config) {
+	//lifetimes of inputBuffer, buffer and tempBuffer over the stages of one submit and their peak VRAM. Buffer sets plan the same lifetimes with the alignment of the device
+	//unpack writes inputBuffer, only the first forward kernel reads it. tempBuffer is used from the forward FFT if it is a four step one, otherwise from the DCT or crop app, the inverse FFT and pack, which may read it. Stages a set may not run are counted, so the plan holds for all of them
+	VkFFTConfiguration* forward_configuration = &context->forward_configuration;
+	VkFFTConfiguration* inverse_configuration = &context->inverse_configuration;
+	context->forwardUsesTempBuffer = VkFFTConfigurationUsesTempBuffer(*forward_configuration, context->vkGPU.physicalDevice);
+	VkBool32 downscale = ((inverse_configuration->size[0] < forward_configuration->size[0]) || (inverse_configuration->size[1] < forward_configuration->size[1])) ? true : false;
+	VkBool32 tempUsed = ((context->forwardUsesTempBuffer) || (inverse_configuration->performR2C) || (config->transform == 1) || (downscale) || (VkFFTConfigurationUsesTempBuffer(*inverse_configuration, context->vkGPU.physicalDevice))) ? true : false;
+	context->fftRangeStages[0][0] = 0;
+	context->fftRangeStages[0][1] = (config->numIter > 1) ? 3 : 1;//-n repeats the FFTs in one submit, each forward FFT reads inputBuffer again
+	context->fftRangeStages[1][0] = 1;
+	context->fftRangeStages[1][1] = 4;
+	context->fftRangeStages[2][0] = (context->forwardUsesTempBuffer) ? 1 : 2;
+	context->fftRangeStages[2][1] = (tempUsed) ? 4 : 0;
+	VkDeviceSize sizes[3] = { ((context->inputBufferSize + 255) / 256) * 256, ((context->bufferSize + 255) / 256) * 256, ((context->bufferSize + 255) / 256) * 256 };
+	VkDeviceSize offsets[3];
+	context->fftMemorySize = planAliasedRanges(3, sizes, context->fftRangeStages, 256, offsets);
+}
+void configureResampleFFT(VkResampleContext* context, VkResampleConfiguration* config, uint32_t width, uint32_t height, uint32_t outputWidth, uint32_t outputHeight, uint32_t numberBatches) {
+	//Setting up FFT configuration for forward and inverse FFT of numberBatches width x height images upscaled to outputWidth x outputHeight. Sets plan configurations, FFT buffer sizes and their memory plan of the context
+	VkGPU* vkGPU = &context->vkGPU;
+	VkFFTConfiguration forward_configuration = defaultVkFFTConfiguration;
+	VkFFTConfiguration inverse_configuration = defaultVkFFTConfiguration;
+	switch (vkGPU->physicalDeviceProperties.vendorID) {
 	case 0x10DE://NVIDIA
 		forward_configuration.coalescedMemory = 32;
 		forward_configuration.useLUT = false;
@@ -1414,369 +2917,940 @@ static VkResult launchResample(VkResampleConfiguration config) {
 	forward_configuration.inputBufferStride[0] = forward_configuration.size[0];
 	forward_configuration.inputBufferStride[1] = forward_configuration.size[1];
 	forward_configuration.inputBufferStride[2] = 1;
-	forward_configuration.bufferStride[0] = config.upscale * forward_configuration.size[0];
-	forward_configuration.bufferStride[1] = config.upscale * forward_configuration.size[1];
+	//spectrum is stored in the layout of the larger of the input and output sizes: zero-padded for upscale, cropped by the inverse FFT read for downscale
+	forward_configuration.bufferStride[0] = (outputWidth > width) ? outputWidth : width;
+	forward_configuration.bufferStride[1] = (outputHeight > height) ? outputHeight : height;
 	forward_configuration.bufferStride[2] = 1;
-	forward_configuration.halfPrecision = (config.precision == 2) ? true : false;
-	forward_configuration.halfPrecisionMemoryOnly = (config.precision == 2) ? true : false;
-	forward_configuration.doublePrecision = (config.precision == 1) ? true : false;
-	uint32_t temporaryScaleIntel = (vkGPU.physicalDeviceProperties.vendorID == 0x8086) ? 4 : 1;//Temporary measure, until L1 overutilization is enabled
-	forward_configuration.performR2C = (forward_configuration.bufferStride[0] > vkGPU.physicalDeviceProperties.limits.maxComputeSharedMemorySize / (complexSizeCalc) / temporaryScaleIntel) ? false : true; //Perform R2C/C2R transform. Can be combined with all other options. Reduces memory requirements by a factor of 2. Requires special input data alignment: for x*y*z system pad x*y plane to (x+2)*y with last 2*y elements reserved, total array dimensions are (x*y+2y)*z. Memory layout after R2C and before C2R can be found on github.
-	forward_configuration.coordinateFeatures = 3; //Specify dimensionality of the input feature vector (default 1). Each component is stored not as a vector, but as a separate system and padded on it's own according to other options (i.e. for x*y system of 3-vector, first x*y elements correspond to the first dimension, then goes x*y for the second, etc). 
+	forward_configuration.halfPrecision = (config->precision == 2) ? true : false;
+	forward_configuration.halfPrecisionMemoryOnly = (config->precision == 2) ? true : false;
+	forward_configuration.doublePrecision = (config->precision == 1) ? true : false;
+	uint32_t temporaryScaleIntel = (vkGPU->physicalDeviceProperties.vendorID == 0x8086) ? 4 : 1;//Temporary measure, until L1 overutilization is enabled
+	forward_configuration.performR2C = (forward_configuration.bufferStride[0] > vkGPU->physicalDeviceProperties.limits.maxComputeSharedMemorySize / (context->complexSizeCalc) / temporaryScaleIntel) ? false : true; //Perform R2C/C2R transform. Can be combined with all other options. Reduces memory requirements by a factor of 2. Requires special input data alignment: for x*y*z system pad x*y plane to (x+2)*y with last 2*y elements reserved, total array dimensions are (x*y+2y)*z. Memory layout after R2C and before C2R can be found on github.
+	if ((forward_configuration.performR2C) && (forward_configuration.bufferStride[0] % 2)) forward_configuration.bufferStride[0]++;//rows of the R2C layout are bufferStride[0] / 2 complex numbers long, so odd input of a downscale is stored with an even stride
+	forward_configuration.coordinateFeatures = context->planes; //Specify dimensionality of the input feature vector (default 1). Each component is stored not as a vector, but as a separate system and padded on it's own according to other options (i.e. for x*y system of 3-vector, first x*y elements correspond to the first dimension, then goes x*y for the second, etc). 
 	forward_configuration.inverse = false; //Direction of FFT. false - forward, true - inverse.
 	forward_configuration.reorderFourStep = true;//set to true if you want data to return to correct layout after FFT. Set to false if you use convolution routine. Requires additional tempBuffer of bufferSize (see below) to do reordering
-	//After this, configuration file contains pointers to Vulkan objects needed to work with the GPU: VkDevice* device - created device, [VkDeviceSize *bufferSize, VkBuffer *buffer, VkDeviceMemory* bufferDeviceMemory] - allocated GPU memory FFT is performed on. [VkDeviceSize *kernelSize, VkBuffer *kernel, VkDeviceMemory* kernelDeviceMemory] - allocated GPU memory, where kernel for convolution is stored.
-	forward_configuration.device = &vkGPU.device;
-	forward_configuration.queue = &vkGPU.queue; //to allocate memory for LUT, we have to pass a queue, vkGPU.fence, commandPool and physicalDevice pointers 
-	forward_configuration.fence = &vkGPU.fence;
-	forward_configuration.commandPool = &vkGPU.commandPool;
-	forward_configuration.physicalDevice = &vkGPU.physicalDevice;
-	forward_configuration.isCompilerInitialized = isCompilerInitialized;//compiler can be initialized before VkFFT plan creation. if not, VkFFT will create and destroy one after initialization
-
-	//Allocate buffer for the input data.
-	VkDeviceSize inputBufferSize = (forward_configuration.performR2C) ? ((uint64_t)forward_configuration.coordinateFeatures) * complexSize * (forward_configuration.size[0] / 2 + 1) * forward_configuration.size[1] * forward_configuration.size[2] : ((uint64_t)forward_configuration.coordinateFeatures) * complexSize * forward_configuration.size[0] * forward_configuration.size[1] * forward_configuration.size[2];
-	VkDeviceSize bufferSize = (forward_configuration.performR2C) ? ((uint64_t)forward_configuration.coordinateFeatures) * complexSizeCalc * (forward_configuration.bufferStride[0] / 2 + 1) * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2] : ((uint64_t)forward_configuration.coordinateFeatures) * complexSizeCalc * forward_configuration.bufferStride[0] * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2];
-	//VkDeviceSize bufferSize = ((uint64_t)forward_configuration.coordinateFeatures) * sizeof(scalar) * 2 * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2];;
-	VkBuffer inputBuffer = {};
-	VkDeviceMemory inputBufferDeviceMemory = {};
-	VkBuffer buffer = {};
-	VkDeviceMemory bufferDeviceMemory = {};
-	VkBuffer tempBuffer = {};
-	VkDeviceMemory tempBufferDeviceMemory = {};
-	allocateFFTBuffer(&vkGPU, &inputBuffer, &inputBufferDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, inputBufferSize);
-	allocateFFTBuffer(&vkGPU, &buffer, &bufferDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, bufferSize);
-	allocateFFTBuffer(&vkGPU, &tempBuffer, &tempBufferDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, bufferSize);
-
-	if (config.threadId == 0) printf("VRAM per thread: %d MB Total: %d MB\n", ((inputBufferSize + (bufferSize + bufferSize))) / 1024 / 1024, config.numThreads * ((inputBufferSize + (bufferSize + bufferSize))) / 1024 / 1024);
-	forward_configuration.buffer = &buffer;
-	forward_configuration.tempBuffer = &tempBuffer;
-	forward_configuration.inputBuffer = &inputBuffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
-	forward_configuration.outputBuffer = &buffer;
-
-	forward_configuration.bufferSize = &bufferSize;
-	forward_configuration.tempBufferSize = &bufferSize;
-	forward_configuration.inputBufferSize = &inputBufferSize;
-	forward_configuration.outputBufferSize = &bufferSize;
+	forward_configuration.isCompilerInitialized = 1;//compiler can be initialized before VkFFT plan creation. if not, VkFFT will create and destroy one after initialization
+	forward_configuration.shaderCache = vkGPU->shaderCache;//reuse SPIR-V compiled for other buffer sets and in previous runs
+	forward_configuration.stagingRing = &context->staging.ring;//LUT uploads reuse the staging ring
+	forward_configuration.memoryAllocator = vkGPU->memoryAllocator;//LUTs are sub-allocated from the blocks of the buffer sets
+	forward_configuration.numberBatches = numberBatches;
+
+	context->inputBufferSize = (forward_configuration.performR2C) ? ((uint64_t)forward_configuration.coordinateFeatures) * context->complexSize * (forward_configuration.size[0] / 2 + 1) * forward_configuration.size[1] * forward_configuration.size[2] : ((uint64_t)forward_configuration.coordinateFeatures) * context->complexSize * forward_configuration.size[0] * forward_configuration.size[1] * forward_configuration.size[2];
+	context->bufferSize = (forward_configuration.performR2C) ? ((uint64_t)forward_configuration.coordinateFeatures) * context->complexSizeCalc * (forward_configuration.bufferStride[0] / 2 + 1) * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2] : ((uint64_t)forward_configuration.coordinateFeatures) * context->complexSizeCalc * forward_configuration.bufferStride[0] * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2];
+	context->inputBufferSize *= numberBatches;
+	context->bufferSize *= numberBatches;
 
 	//Now we will create a similar configuration for inverse FFT and change inverse parameter to true.
 	inverse_configuration = forward_configuration;
 	inverse_configuration.isInputFormatted = false;
-
-	inverse_configuration.inputBuffer = &buffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
-	inverse_configuration.inputBufferSize = &bufferSize;
-	inverse_configuration.size[0] = inverse_configuration.bufferStride[0]; //Multidimensional FFT dimensions sizes (default 1). For best performance (and stability), order dimensions in descendant size order as: x>y>z.   
-	inverse_configuration.size[1] = inverse_configuration.bufferStride[1];
+	inverse_configuration.size[0] = outputWidth; //Multidimensional FFT dimensions sizes (default 1). For best performance (and stability), order dimensions in descendant size order as: x>y>z.   
+	inverse_configuration.size[1] = outputHeight;
 	inverse_configuration.size[2] = 1;
-	if (inverse_configuration.performR2C) {
-		inverse_configuration.isOutputFormatted = true;
-		inverse_configuration.outputBuffer = &tempBuffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
-		inverse_configuration.outputBufferSize = &bufferSize;
-		inverse_configuration.outputBufferStride[0] = inverse_configuration.size[0];
-		inverse_configuration.outputBufferStride[1] = inverse_configuration.size[1];
-		inverse_configuration.outputBufferStride[2] = 1;
+	inverse_configuration.isOutputFormatted = true;
+	inverse_configuration.outputBufferStride[0] = inverse_configuration.size[0];
+	inverse_configuration.outputBufferStride[1] = inverse_configuration.size[1];
+	inverse_configuration.outputBufferStride[2] = 1;
+	inverse_configuration.inverse = true;
+	inverse_configuration.outputScale = ((double)outputWidth * outputHeight) / ((double)width * height);//compensate normalization of the larger inverse FFT in the write stage, so the sharpen pass reads final values
+	inverse_configuration.outputClamp = true;
+	if (config->transform == 1) {
+		//DCT spectrum is computed for the whole inverse FFT, zeros included, by the DCT app
+		context->forward_configuration = forward_configuration;
+		context->inverse_configuration = inverse_configuration;
+		planFFTMemory(context, config);
+		return;
+	}
+	if ((outputWidth < width) || (outputHeight < height)) {
+		//downscale of at least one axis: the inverse FFT reads the lower and upper frequencies it retains from the forward layout, the rest of the spectrum is dropped. No zero padding, an upscaled axis is padded by the crop app
+		context->forward_configuration = forward_configuration;
+		context->inverse_configuration = inverse_configuration;
+		planFFTMemory(context, config);
+		return;
+	}
+	inverse_configuration.frequencyZeroPadding = 1;
+	inverse_configuration.performZeropadding[0] = true; //Perform padding with zeros on GPU. Still need to properly align input data (no need to fill padding area with meaningful data) but this will increase performance due to the lower amount of the memory reads/writes and omitting sequences only consisting of zeros.
+	inverse_configuration.performZeropadding[1] = true;
+	//zeros are between the lower and upper frequencies of the input, computed from integer sizes so tiles of any upscale map exactly
+	if (forward_configuration.performR2C) {
+		inverse_configuration.fft_zeropad_left[0] = width / 2;
+		inverse_configuration.fft_zeropad_right[0] = outputWidth / 2;
+	}
+	else {
+		inverse_configuration.fft_zeropad_left[0] = width / 2;
+		inverse_configuration.fft_zeropad_right[0] = outputWidth - width + width / 2;
+	}
+	inverse_configuration.fft_zeropad_left[1] = height / 2;
+	inverse_configuration.fft_zeropad_right[1] = outputHeight - height + height / 2;
+	inverse_configuration.performZeropadding[2] = false;
+	context->forward_configuration = forward_configuration;
+	context->inverse_configuration = inverse_configuration;
+	planFFTMemory(context, config);
+}
+uint32_t selectBatchSize(VkResampleContext* context, VkResampleConfiguration* config) {
+	//number of images in one buffer set. Buffer sizes of one image must be set in the context
+	if (!config->fileUpload) return 1;
+	if (config->batchSize) return config->batchSize;
+	VkDeviceSize imageVRAM = context->fftMemorySize + context->rgbBufferSize + context->chromaBufferSize;
+	uint64_t batchSize = getVRAMBudget(context, config) / (config->numBuffers * imageVRAM);
+	//buffers are bound as a whole, so they must fit in maxStorageBufferRange
+	uint64_t maxRangeBatch = context->vkGPU.physicalDeviceProperties.limits.maxStorageBufferRange / context->bufferSize;
+	if (batchSize > maxRangeBatch) batchSize = maxRangeBatch;
+	//a thread decodes the whole batch before the upload, so larger batches only delay the GPU once all threads are busy
+	uint64_t filesPerThread = (context->numFiles + config->numThreads * config->numDevices - 1) / (config->numThreads * config->numDevices);
+	if (batchSize > filesPerThread) batchSize = filesPerThread;
+	if (batchSize > 32) batchSize = 32;//submit overhead is amortized long before this
+	if (batchSize < 1) batchSize = 1;
+	return (uint32_t)batchSize;
+}
+static uint32_t greatestCommonDivisor(uint32_t a, uint32_t b) {
+	while (b) {
+		uint32_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+VkResult selectTiling(VkResampleContext* context, VkResampleConfiguration* config) {
+	//largest square tile, a row of which fits the VRAM budget. Tile sizes and positions are multiples of granularity, so every tile maps to whole output pixels
+	//FFT plans are configured for one row of tiles: tiles of the row are VkFFT batches
+	VkResampleTiling* tiling = &context->tiling;
+	uint32_t width = context->width;
+	uint32_t height = context->height;
+	uint32_t granularityX = width / greatestCommonDivisor(width, context->outputWidth);
+	uint32_t granularityY = height / greatestCommonDivisor(height, context->outputHeight);
+	uint32_t granularity = granularityX / greatestCommonDivisor(granularityX, granularityY) * granularityY;
+	if (granularity % 2) granularity *= 2;
+	uint32_t overlap = ((32 + granularity - 1) / granularity) * granularity;
+	VkDeviceSize budget = getVRAMBudget(context, config);
+	uint32_t maxTileSize = (width > height) ? width : height;
+	maxTileSize = ((maxTileSize + granularity - 1) / granularity) * granularity;
+	for (uint32_t tileSize = maxTileSize; tileSize >= 4 * overlap; tileSize -= granularity) {
+		uint32_t outputTileSize[2] = { tileSize / granularityX * (context->outputWidth / (width / granularityX)), tileSize / granularityY * (context->outputHeight / (height / granularityY)) };
+		if ((!isSmoothSize(tileSize)) || (!isSmoothSize(outputTileSize[0])) || (!isSmoothSize(outputTileSize[1]))) continue;
+		uint32_t step = tileSize - overlap;
+		uint32_t numTiles[2] = { (width > tileSize) ? (width - tileSize + step - 1) / step + 1 : 1, (height > tileSize) ? (height - tileSize + step - 1) / step + 1 : 1 };
+		configureResampleFFT(context, config, tileSize, tileSize, outputTileSize[0], outputTileSize[1], numTiles[0]);
+		//accumulator keeps the rows of the current row of tiles, the last packed row and the row above it
+		uint32_t ringHeight = outputTileSize[1] + 2;
+		VkDeviceSize stripInputSize = (((VkDeviceSize)context->pixelSize * width * tileSize + 3) / 4) * 4;
+		VkDeviceSize stripOutputSize = (VkDeviceSize)context->outputPitch * ringHeight;
+		VkDeviceSize tileBufferSize = (VkDeviceSize)sizeof(float) * context->channels * ringHeight * context->outputWidth;
+		VkDeviceSize setVRAM = context->fftMemorySize + stripInputSize + stripOutputSize + tileBufferSize;
+		if ((config->numBuffers * setVRAM > budget) || (context->bufferSize > context->vkGPU.physicalDeviceProperties.limits.maxStorageBufferRange) || (tileBufferSize > context->vkGPU.physicalDeviceProperties.limits.maxStorageBufferRange)) continue;
+		context->tiled = 1;
+		tiling->tileSize = tileSize;
+		tiling->overlap = overlap;
+		tiling->outputTileSize[0] = outputTileSize[0];
+		tiling->outputTileSize[1] = outputTileSize[1];
+		tiling->step = step;
+		tiling->outputStep[0] = step / granularityX * (context->outputWidth / (width / granularityX));
+		tiling->outputStep[1] = step / granularityY * (context->outputHeight / (height / granularityY));
+		tiling->numTiles[0] = numTiles[0];
+		tiling->numTiles[1] = numTiles[1];
+		tiling->ringHeight = ringHeight;
+		tiling->stripInputSize = stripInputSize;
+		tiling->stripOutputSize = stripOutputSize;
+		tiling->tileBufferSize = tileBufferSize;
+		context->rgbBufferSize = stripInputSize + stripOutputSize;
+		return VK_SUCCESS;
+	}
+	printf("VRAM budget of %d MB is too small to upscale %dx%d image even in tiles\n", (uint32_t)(budget / 1024 / 1024), width, height);
+	return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+VkResult createResampleContext(VkResampleContext* context, VkResampleConfiguration* config) {
+	//create one instance, device and a set of compiled plans shared by all worker threads
+	if (config->backend == 1) return createResampleContextCPU(context, config);
+	VkGPU* vkGPU = &context->vkGPU;
+	vkGPU->device_id = config->device_id;
+	VkResult res = VK_SUCCESS;
+	//create instance - a connection between the application and the Vulkan library 
+	res = createInstance(vkGPU);
+	if (res != VK_SUCCESS) {
+		printf("Instance creation failed, error code: %d\n", res);
+		return res;
+	}
+	//set up the debugging messenger 
+	res = setupDebugMessenger(vkGPU);
+	if (res != VK_SUCCESS) {
+		printf("Debug messenger creation failed, error code: %d\n", res);
+		return res;
+	}
+	//check if there are GPUs that support Vulkan and select one
+	res = findPhysicalDevice(vkGPU);
+	if (res != VK_SUCCESS) {
+		printf("Physical device not found, error code: %d\n", res);
+		return res;
+	}
+	//create logical device representation
+	res = createDevice(vkGPU);
+	if (res != VK_SUCCESS) {
+		printf("Device creation failed, error code: %d\n", res);
+		return res;
+	}
+	vkGetPhysicalDeviceProperties(vkGPU->physicalDevice, &vkGPU->physicalDeviceProperties);
+	vkGetPhysicalDeviceMemoryProperties(vkGPU->physicalDevice, &vkGPU->physicalDeviceMemoryProperties);
+	vkGPU->queueMutex = &context->queueMutex;
+	vkGPU->transferQueueMutex = &context->transferQueueMutex;
+	if (config->timestamps && (vkGPU->timestampValidBits == 0)) printf("Timestamps are not supported by the compute queue\n");
+	//shader cache keeps SPIR-V in memory, so every buffer set reuses shaders compiled for the first one. With -cache it is also stored on disk
+	res = VkFFTInitShaderCache(&context->shaderCache, vkGPU->device, vkGPU->physicalDevice, config->cacheDir);
+	if (res != VK_SUCCESS) {
+		printf("Shader cache creation failed, error code: %d\n", res);
+		return res;
+	}
+	vkGPU->shaderCache = &context->shaderCache;
+	//buffers of all buffer sets, LUTs and the staging ring are ranges of a few large blocks instead of one vkAllocateMemory each
+	res = VkFFTInitMemoryAllocator(&context->memoryAllocator, vkGPU->device, vkGPU->physicalDevice, 64 * 1024 * 1024);
+	if (res != VK_SUCCESS) {
+		printf("Memory allocator creation failed, error code: %d\n", res);
+		return res;
+	}
+	vkGPU->memoryAllocator = &context->memoryAllocator;
+
+	printf("VkResample - FFT based upscaling\n");
+	context->complexSize = 2 * sizeof(float);
+	context->complexSizeCalc = 2 * sizeof(float);
+	switch (config->precision) {
+	case 0: {
+		context->complexSize = 2 * sizeof(float);
+		break;
+	}
+	case 1: {
+		context->complexSize = 2 * sizeof(double);
+		context->complexSizeCalc = 2 * sizeof(double);
+		break;
+	}
+	case 2: {
+		context->complexSize = 2 * sizeof(half);
+		break;
 	}
+	}
+	//all images in a batch must have the same resolution, so plans are configured from the first one
+	char fileName[512] = "";
+	if (config->fileUpload)
+		sprintf(fileName, "%s/%06d.png", config->ifolder_prefix, 1);
 	else
-	{
-		inverse_configuration.isOutputFormatted = true;
-		inverse_configuration.outputBuffer = &buffer; //you can specify first buffer to read data from to be different from the buffer FFT is performed on. FFT is still in-place on the second buffer, this is here just for convenience.
-		inverse_configuration.outputBufferSize = &bufferSize;
-		inverse_configuration.outputBufferStride[0] = inverse_configuration.size[0];
-		inverse_configuration.outputBufferStride[1] = inverse_configuration.size[1];
-		inverse_configuration.outputBufferStride[2] = 1;
+		sprintf(fileName, "%s", config->png_input_name);
+	int width;
+	int height;
+	int channels;
+	if (!stbi_info(fileName, &width, &height, &channels)) {
+		printf("Image not found\n");
+		return VK_INCOMPLETE;
 	}
-	inverse_configuration.inverse = true;
-	inverse_configuration.frequencyZeroPadding = 1;
-	inverse_configuration.performZeropadding[0] = true; //Perform padding with zeros on GPU. Still need to properly align input data (no need to fill padding area with meaningful data) but this will increase performance due to the lower amount of the memory reads/writes and omitting sequences only consisting of zeros.
-	inverse_configuration.performZeropadding[1] = true;
-	if (forward_configuration.performR2C) {
-		inverse_configuration.fft_zeropad_left[0] = forward_configuration.size[0] / 2;
-		inverse_configuration.fft_zeropad_right[0] = inverse_configuration.size[0] / 2;
-		inverse_configuration.fft_zeropad_left[1] = inverse_configuration.size[1] / (2 * config.upscale);
-		inverse_configuration.fft_zeropad_right[1] = (2 * config.upscale - 1) * inverse_configuration.size[1] / (2 * config.upscale);
+	context->width = width;
+	context->height = height;
+	selectImageFormat(context, config, fileName, channels);
+	context->numFiles = (config->fileUpload) ? config->numFiles : 1;
+	context->validationMinPSNR = INFINITY;
+	context->validationMinSSIM = 1.0;
+
+	//Only interleaved 8-bit pixels are transferred, conversion to and from the FFT layout is done by the unpack and pack shaders
+	selectOutputSize(context, config);
+	context->outputPitch = context->pixelSize * ((context->outputWidth + 3) / 4) * 4;
+	context->rgbInputSize = (((VkDeviceSize)context->pixelSize * context->width * context->height + 3) / 4) * 4;
+	context->outputSize = (VkDeviceSize)context->outputPitch * context->outputHeight;
+	context->rgbBufferSize = (context->rgbInputSize > context->outputSize) ? context->rgbInputSize : context->outputSize;
+	//YCbCr mode: chroma planes are kept in float at the padded input size until pack upscales them
+	context->chromaBufferSize = (context->color) ? (VkDeviceSize)2 * sizeof(float) * context->paddedWidth * context->paddedHeight : 0;
+	configureResampleFFT(context, config, context->paddedWidth, context->paddedHeight, context->resampleWidth, context->resampleHeight, 1);
+	//images, whose buffer sets do not fit the VRAM budget, are upscaled in overlapping tiles with a smaller plan
+	VkDeviceSize imageVRAM = context->fftMemorySize + context->rgbBufferSize + context->chromaBufferSize;
+	if ((config->numBuffers * imageVRAM > getVRAMBudget(context, config)) || (context->bufferSize > vkGPU->physicalDeviceProperties.limits.maxStorageBufferRange)) {
+		if (context->color) {
+			printf("YCbCr mode does not support tiled upscaling, increase the VRAM budget with -maxvram\n");
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+		if (config->transform == 1) {
+			printf("DCT mode does not support tiled upscaling, increase the VRAM budget with -maxvram\n");
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+		if ((context->outputWidth < (uint32_t)width) || (context->outputHeight < (uint32_t)height)) {
+			printf("Downscaling does not support tiled mode, increase the VRAM budget with -maxvram\n");
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+		if ((context->paddedWidth != (uint32_t)width) || (context->paddedHeight != (uint32_t)height) || (context->resampleWidth != context->outputWidth) || (context->resampleHeight != context->outputHeight)) {
+			printf("Padded or cropped sizes are not supported in tiled mode, increase the VRAM budget with -maxvram\n");
+			return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+		}
+		res = selectTiling(context, config);
+		if (res != VK_SUCCESS) return res;
+		context->batchSize = 1;
+		printf("Tiled mode: %dx%d tiles of %dx%d pixels, overlap %d pixels\n", context->tiling.numTiles[0], context->tiling.numTiles[1], context->tiling.tileSize, context->tiling.tileSize, context->tiling.overlap);
+		if (config->timestamps) printf("Timestamps are not recorded in tiled mode\n");
 	}
 	else {
-		inverse_configuration.fft_zeropad_left[0] = forward_configuration.size[0] / 2;
-		inverse_configuration.fft_zeropad_right[0] = (2 * config.upscale - 1) * inverse_configuration.size[0] / (2 * config.upscale);
-		inverse_configuration.fft_zeropad_left[1] = inverse_configuration.size[1] / (2 * config.upscale);
-		inverse_configuration.fft_zeropad_right[1] = (2 * config.upscale - 1) * inverse_configuration.size[1] / (2 * config.upscale);
+		//Pack batchSize images in one buffer set. Images are VkFFT batches, so one submit transforms all of them and the barriers between FFT stages are shared by the whole batch
+		context->batchSize = selectBatchSize(context, config);
+		configureResampleFFT(context, config, context->paddedWidth, context->paddedHeight, context->resampleWidth, context->resampleHeight, context->batchSize);
+		context->rgbBufferSize *= context->batchSize;
+		context->chromaBufferSize *= context->batchSize;
 	}
-	inverse_configuration.performZeropadding[2] = false;
 
-	//Initialize applications. This function loads shaders, creates pipeline and configures FFT based on configuration file. No buffer allocations inside VkFFT library.  
-	res = initializeVulkanFFT(&app_forward, forward_configuration);
-	if (res != VK_SUCCESS) return res;
-	res = initializeVulkanFFT(&app_inverse, inverse_configuration);
-	if (res != VK_SUCCESS) return res;
-
-	VkShiftApplication appShift = { 0 };
-	appShift.r2c = forward_configuration.performR2C;
-	appShift.precision = config.precision;
-	if (appShift.precision == 2) appShift.precision = 0;
-	if (forward_configuration.performR2C)
-		appShift.size[0] = forward_configuration.size[0] / 2;
+	//Staging ring: one persistently mapped allocation for the whole run. Each batch takes input and output space from it and releases it after its fence, so per image transfer is a memcpy and a recorded copy
+	context->stagingOutputOffset = ((context->batchSize * context->rgbInputSize + 255) / 256) * 256;
+	context->stagingFrameSize = context->stagingOutputOffset + ((context->batchSize * context->outputSize + 255) / 256) * 256;
+	if (context->tiled) {
+		//tiles are uploaded and read back one row of tiles at a time
+		context->stagingOutputOffset = ((context->tiling.stripInputSize + 255) / 256) * 256;
+		context->stagingFrameSize = context->stagingOutputOffset + ((context->tiling.stripOutputSize + 255) / 256) * 256;
+	}
+	//Staging copies of whole image mode go to the transfer-only queue family, if the device has one. Timestamps of all stages are written on the compute queue and tiled mode waits for each row of tiles on the host, so they keep the copies there
+	context->transferQueue = ((vkGPU->transferQueue) && (!config->singleQueue) && (!config->timestamps) && (!context->tiled)) ? 1 : 0;
+	if (context->transferQueue)
+		printf("Staging copies use transfer queue family %d, compute uses queue family %d\n", vkGPU->transferQueueFamilyIndex, vkGPU->queueFamilyIndex);
+	else if (!vkGPU->transferQueue)
+		printf("Device has no transfer-only queue family, staging copies use the compute queue\n");
 	else
-		appShift.size[0] = forward_configuration.size[0];
-	appShift.size[1] = forward_configuration.size[1];
-	appShift.size[2] = forward_configuration.size[2];
-	//appShift.localSize[0] = forward_configuration.coalescedMemory / complexSize;
-	//appShift.localSize[1] = forward_configuration.coalescedMemory / complexSize;
-	uint32_t availablePow2 = log2(forward_configuration.warpSize);
-	appShift.localSize[0] = 1;
-	appShift.localSize[1] = 1;
-	for (uint32_t i = 0; i < log2(forward_configuration.warpSize) + 1; i++) {
-		if (appShift.size[0] % ((uint32_t)pow(2, i)) != 0) {
-			availablePow2 = i - 1;
-			i = log2(forward_configuration.warpSize) + 1;
+		printf("Staging copies use the compute queue: -singlequeue, -timestamps or tiled mode\n");
+	uint32_t stagingQueueFamilies[2] = { vkGPU->queueFamilyIndex, vkGPU->transferQueueFamilyIndex };
+	res = VkFFTInitStagingRing(&context->staging.ring, vkGPU->device, vkGPU->physicalDevice, (config->numBuffers + 1) * context->stagingFrameSize, (vkGPU->transferQueue) ? 2 : 1, stagingQueueFamilies, vkGPU->memoryAllocator);
+	if (res != VK_SUCCESS) {
+		printf("Staging buffer creation failed, error code: %d\n", res);
+		return res;
+	}
+	vkGPU->staging = &context->staging;
+
+	//Allocate buffer sets. Threads only decode/encode png files and borrow a buffer set for the GPU part, so VRAM does not grow with the number of threads.
+	context->bufferSets.resize(config->numBuffers);
+	for (uint32_t i = 0; i < config->numBuffers; i++) {
+		res = createResampleBufferSet(context, config, &context->bufferSets[i]);
+		if (res != VK_SUCCESS) {
+			printf("Buffer set creation failed, error code: %d\n", res);
+			//sets after the failed one were never touched
+			context->bufferSets.resize(i + 1);
+			return res;
 		}
+		context->freeBufferSets.push_back(&context->bufferSets[i]);
 	}
-	appShift.localSize[0] = pow(2, availablePow2);
-	if (pow(2, availablePow2) < forward_configuration.warpSize) {
-		uint32_t availablePow2y = log2(forward_configuration.warpSize) - availablePow2;
-		for (uint32_t i = 0; i < log2(forward_configuration.warpSize) + 1 - availablePow2; i++) {
-			if (appShift.size[1] % ((uint32_t)pow(2, i)) != 0) {
-				availablePow2y = i - 1;
-				i = log2(forward_configuration.warpSize) + 1 - availablePow2;
-			}
+	//each buffer set keeps one staging frame for the whole run, so its submits are recorded once with fixed copy offsets. LUT uploads of the plans are done and released by now
+	context->recordMode = config->recordMode;
+	for (uint32_t i = 0; i < config->numBuffers; i++) {
+		res = allocateStaging(vkGPU, context->stagingFrameSize, &context->bufferSets[i].stagingOffset);
+		if (res != VK_SUCCESS) {
+			printf("Staging allocation failed, error code: %d\n", res);
+			return res;
+		}
+		if (context->recordMode) continue;
+		res = recordResampleTimed(context, &context->bufferSets[i], config->numIter);
+		if (res != VK_SUCCESS) {
+			printf("Command buffer recording failed, error code: %d\n", res);
+			return res;
 		}
-		appShift.localSize[1] = pow(2, availablePow2y);
 	}
-
-	appShift.localSize[2] = 1;
-	if (forward_configuration.performR2C) {
-		appShift.inputStride[0] = forward_configuration.bufferStride[0] / 2;
-		appShift.inputStride[1] = forward_configuration.bufferStride[1];
-		appShift.inputStride[2] = (forward_configuration.bufferStride[0] / 2 + 1) * forward_configuration.bufferStride[1];
+	if (config->fileUpload) printf("Images per buffer set: %d\n", context->batchSize);
+	//peak VRAM of a set: the planned range of the FFT buffers as it was allocated, plus the buffers that live for the whole submit
+	VkDeviceSize fftVRAM = context->bufferSets[0].fftAllocation.size;
+	VkDeviceSize setVRAM = fftVRAM + context->rgbBufferSize + context->chromaBufferSize + context->tiling.tileBufferSize;
+	printf("VRAM per buffer set: %d MB Total: %d MB (FFT buffers %d MB, %d MB without aliasing)\n", (uint32_t)(setVRAM / 1024 / 1024), (uint32_t)(config->numBuffers * setVRAM / 1024 / 1024), (uint32_t)(fftVRAM / 1024 / 1024), (uint32_t)((context->inputBufferSize + 2 * context->bufferSize) / 1024 / 1024));
+	printMemoryReport(&context->memoryAllocator);
+	return res;
+}
+void deleteResampleBufferSet(VkResampleBufferSet* set) {
+	//destroy previously allocated resources of the buffer set
+	vkDestroyBuffer(set->vkGPU.device, set->inputBuffer, NULL);
+	vkDestroyBuffer(set->vkGPU.device, set->buffer, NULL);
+	vkDestroyBuffer(set->vkGPU.device, set->tempBuffer, NULL);
+	VkFFTAllocatorFree(set->vkGPU.memoryAllocator, &set->fftAllocation);
+	deleteFFTBuffer(&set->vkGPU, &set->rgbBuffer, &set->rgbBufferAllocation);
+	if (set->app_forward.configuration.FFTdim) deleteVulkanFFT(&set->app_forward);
+	if (set->app_inverse.configuration.FFTdim) deleteVulkanFFT(&set->app_inverse);
+	if (set->performShift) deleteShiftApp(&set->vkGPU, &set->appShift);
+	if (set->performDCT) deleteShiftApp(&set->vkGPU, &set->appDCT);
+	if (set->performCrop) deleteShiftApp(&set->vkGPU, &set->appCrop);
+	deleteShiftApp(&set->vkGPU, &set->appUnpack);
+	deleteShiftApp(&set->vkGPU, &set->appPack);
+	if (set->chromaBuffer)
+		deleteFFTBuffer(&set->vkGPU, &set->chromaBuffer, &set->chromaBufferAllocation);
+	if (set->tileBuffer) {
+		deleteFFTBuffer(&set->vkGPU, &set->tileBuffer, &set->tileBufferAllocation);
+		deleteShiftApp(&set->vkGPU, &set->appBlend);
 	}
-	else
-	{
-		appShift.inputStride[0] = forward_configuration.bufferStride[0];
-		appShift.inputStride[1] = forward_configuration.bufferStride[1];
-		appShift.inputStride[2] = (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1];
-	}
-	appShift.numCoordinates = channels;
-	appShift.inputBuffer = &buffer;
-	appShift.inputBufferSize = bufferSize;
-	appShift.outputBuffer = &buffer;
-	appShift.outputBufferSize = bufferSize;
-
-	createShiftApp(&vkGPU, &appShift);
-
-	VkShiftApplication appSharpen = { 0 };
-	appSharpen.r2c = inverse_configuration.performR2C;
-	appSharpen.precision = config.precision;
-	appSharpen.size[0] = inverse_configuration.size[0];
-	appSharpen.size[1] = inverse_configuration.size[1];
-	appSharpen.size[2] = inverse_configuration.size[2];
-
-	availablePow2 = log2(inverse_configuration.warpSize);
-	appSharpen.localSize[0] = 1;
-	appSharpen.localSize[1] = 1;
-	for (uint32_t i = 0; i < log2(inverse_configuration.warpSize) + 1; i++) {
-		if (appSharpen.size[0] % ((uint32_t)pow(2, i)) != 0) {
-			availablePow2 = i - 1;
-			i = log2(inverse_configuration.warpSize) + 1;
-		}
-	}
-	appSharpen.localSize[0] = pow(2, availablePow2);
-	uint32_t availablePow2y = log2(inverse_configuration.warpSize);
-	for (uint32_t i = 0; i < log2(inverse_configuration.warpSize) + 1 - availablePow2; i++) {
-		if (appSharpen.size[1] % ((uint32_t)pow(2, i)) != 0) {
-			availablePow2y = i - 1;
-			i = log2(inverse_configuration.warpSize) + 1 - availablePow2;
-		}
-	}
-	appSharpen.localSize[1] = pow(2, availablePow2y);
-	uint32_t maxThreads = vkGPU.physicalDeviceProperties.limits.maxComputeWorkGroupSize[0];
-	if (maxThreads > 1024) maxThreads = 1024;
-	if (appSharpen.localSize[1] * appSharpen.localSize[0] > maxThreads) appSharpen.localSize[1] = maxThreads / appSharpen.localSize[0];
-	appSharpen.localSize[2] = 1;
-	appSharpen.inputStride[0] = inverse_configuration.bufferStride[0];
-	appSharpen.inputStride[1] = inverse_configuration.bufferStride[1];
-	if (appSharpen.r2c)
-		appSharpen.inputStride[2] = (inverse_configuration.bufferStride[0] + 2) * inverse_configuration.bufferStride[1];
-	else
-		appSharpen.inputStride[2] = (inverse_configuration.bufferStride[0]) * inverse_configuration.bufferStride[1];
-	appSharpen.outputStride[0] = inverse_configuration.bufferStride[0];
-	appSharpen.outputStride[1] = inverse_configuration.bufferStride[1];
-	appSharpen.outputStride[2] = (inverse_configuration.bufferStride[0]) * inverse_configuration.bufferStride[1];
-	appSharpen.numCoordinates = channels;
-	if (inverse_configuration.performR2C) {
-		appSharpen.inputBuffer = &tempBuffer;
-		appSharpen.inputBufferSize = bufferSize;
-		appSharpen.outputBuffer = &buffer;
-		appSharpen.outputBufferSize = bufferSize;
+	if (set->timestampQueryPool) vkDestroyQueryPool(set->vkGPU.device, set->timestampQueryPool, NULL);
+	if (set->commandBuffers.size() > 0) vkFreeCommandBuffers(set->vkGPU.device, set->vkGPU.commandPool, (uint32_t)set->commandBuffers.size(), set->commandBuffers.data());
+	if (set->transferCommandPool) {
+		vkFreeCommandBuffers(set->vkGPU.device, set->transferCommandPool, 2, set->transferCommandBuffers);
+		vkDestroyCommandPool(set->vkGPU.device, set->transferCommandPool, NULL);
+		vkDestroySemaphore(set->vkGPU.device, set->uploadSemaphore, NULL);
+		vkDestroySemaphore(set->vkGPU.device, set->computeSemaphore, NULL);
 	}
-	else {
-		appSharpen.inputBuffer = &buffer;
-		appSharpen.inputBufferSize = bufferSize;
-		appSharpen.outputBuffer = &tempBuffer;
-		appSharpen.outputBufferSize = bufferSize;
-	}
-	appSharpen.upscale = config.upscale * config.upscale;
-	appSharpen.sharpenCoeff = config.sharpenConst;
-	createSharpenApp(&vkGPU, &appSharpen);
-
-	//Fill data on CPU. It is best to perform all operations on GPU after initial upload.
-	void* buffer_input_void = (void*)malloc(inputBufferSize);
-	void* buffer_output_void = (void*)malloc(config.upscale * config.upscale * inputBufferSize);
-	uint32_t numLocalFiles = 1;
-	if (config.fileUpload) {
-		numLocalFiles = ceil(config.numFiles / (float)config.numThreads);
-		if ((numLocalFiles - 1) * config.numThreads + config.threadId > config.numFiles - 1) numLocalFiles--;
-	}
-	for (uint32_t f = 0; f < numLocalFiles; f++) {
-		if (f > 0) {
-			sprintf(fileName, "%s/%06d.png", config.ifolder_prefix, f * config.numThreads + config.threadId + 1);
-			png_input = stbi_load(fileName, &width, &height, &channels, 3);
-			if (png_input == 0) {
-				printf("Image not found\n");
-				return VK_INCOMPLETE;
-			}
+	vkDestroyFence(set->vkGPU.device, set->vkGPU.fence, NULL);
+	vkDestroyCommandPool(set->vkGPU.device, set->vkGPU.commandPool, NULL);
+}
+void deleteResampleContext(VkResampleContext* context) {
+	//also called on a context whose creation failed: objects that were not created yet are zero
+	if (context->backend == 1) {
+		stopCPUPool(&context->cpu.pool);
+		return;
+	}
+	if (context->vkGPU.device) {
+		for (uint32_t i = 0; i < context->bufferSets.size(); i++)
+			deleteResampleBufferSet(&context->bufferSets[i]);
+		if (context->shaderCache.cacheDir[0]) {
+			printf("Shader cache: %d hits, %d misses\n", context->shaderCache.hits, context->shaderCache.misses);
+			VkFFTSaveShaderCache(&context->shaderCache, context->vkGPU.device);
 		}
-		switch (config.precision) {
-		case 0: {
-			float* buffer_input = (float*)buffer_input_void;
-			for (uint32_t v = 0; v < forward_configuration.coordinateFeatures; v++) {
-				for (uint32_t k = 0; k < forward_configuration.size[2]; k++) {
-					for (uint32_t j = 0; j < forward_configuration.size[1]; j++) {
-						for (uint32_t i = 0; i < forward_configuration.size[0]; i++) {
-							if (forward_configuration.performR2C)
-								buffer_input[(i + j * forward_configuration.size[0] + k * (forward_configuration.size[0] + 2) * forward_configuration.size[1] + v * (forward_configuration.size[0] + 2) * forward_configuration.size[1] * forward_configuration.size[2])] = (float)png_input[v + i * channels + j * width * channels] / 255.0;
-							else
-								buffer_input[2 * (i + j * forward_configuration.size[0] + k * (forward_configuration.size[0]) * forward_configuration.size[1] + v * (forward_configuration.size[0]) * forward_configuration.size[1] * forward_configuration.size[2])] = (float)png_input[v + i * channels + j * width * channels] / 255.0;
-						}
-					}
+		VkFFTDestroyShaderCache(&context->shaderCache, context->vkGPU.device);
+		VkFFTDestroyStagingRing(&context->staging.ring, context->vkGPU.device);
+		VkFFTDestroyMemoryAllocator(&context->memoryAllocator);
+		printf("Device name: %s API:%d.%d.%d\n", context->vkGPU.physicalDeviceProperties.deviceName, (context->vkGPU.physicalDeviceProperties.apiVersion >> 22), ((context->vkGPU.physicalDeviceProperties.apiVersion >> 12) & 0x3ff), (context->vkGPU.physicalDeviceProperties.apiVersion & 0xfff));
+		vkDestroyDevice(context->vkGPU.device, NULL);
+	}
+	if (context->vkGPU.instance) DestroyDebugUtilsMessengerEXT(&context->vkGPU, NULL);
+	vkDestroyInstance(context->vkGPU.instance, NULL);
+}
+static void referenceFFT(std::complex<double>* data, uint32_t n, const std::complex<double>* twiddles, uint32_t twiddleStride) {
+	//scalar mixed radix FFT of the CPU reference, decimation in time: p interleaved subsequences of size n/p are transformed and combined with a direct DFT of size p
+	//twiddles[j * twiddleStride] = exp(sign * 2 * pi * i * j / n). Sizes with large prime factors are slow, but correct
+	if (n == 1) return;
+	uint32_t p = 2;
+	while (n % p) p++;
+	uint32_t m = n / p;
+	std::vector<std::complex<double>> sub(n);
+	for (uint32_t r = 0; r < p; r++) {
+		for (uint32_t k = 0; k < m; k++)
+			sub[r * m + k] = data[k * p + r];
+		referenceFFT(&sub[r * m], m, twiddles, twiddleStride * p);
+	}
+	for (uint32_t k = 0; k < m; k++) {
+		for (uint32_t q = 0; q < p; q++) {
+			std::complex<double> sum = 0;
+			for (uint32_t r = 0; r < p; r++)
+				sum += sub[r * m + k] * twiddles[((uint64_t)r * (k + q * m) % n) * twiddleStride];
+			data[q * m + k] = sum;
+		}
+	}
+}
+static void referenceFFT(std::vector<std::complex<double>>& data, double sign) {
+	//unnormalized transform of the whole vector, sign = -1 for forward and 1 for inverse
+	uint32_t n = (uint32_t)data.size();
+	std::vector<std::complex<double>> twiddles(n);
+	for (uint32_t j = 0; j < n; j++)
+		twiddles[j] = std::polar(1.0, sign * 2 * M_PI * j / n);
+	referenceFFT(data.data(), n, twiddles.data(), 1);
+}
+static void referenceResampleDCT(double* data, uint32_t size, uint32_t outputSize, uint64_t stride, uint64_t outputStride, double* output) {
+	//1D DCT resample of the CPU reference: DCT-II coefficients are computed with an FFT of the mirrored line of 2 * size elements, DCT-III of the zero-padded coefficients with an inverse FFT of 2 * outputSize elements
+	std::vector<std::complex<double>> line(2 * size);
+	for (uint32_t i = 0; i < size; i++) {
+		line[i] = data[i * stride];
+		line[2 * size - 1 - i] = data[i * stride];
+	}
+	referenceFFT(line, -1);
+	std::vector<std::complex<double>> outputLine(2 * outputSize);
+	for (uint32_t k = 0; (k < size) && (k < outputSize); k++) {
+		double coefficient = 0.5 * (std::polar(1.0, -M_PI * k / (2.0 * size)) * line[k]).real();
+		outputLine[k] = ((k) ? 2.0 : 1.0) * coefficient / size * std::polar(1.0, M_PI * k / (2.0 * outputSize));
+	}
+	referenceFFT(outputLine, 1);
+	for (uint32_t i = 0; i < outputSize; i++)
+		output[i * outputStride] = outputLine[i].real();
+}
+void referenceResample(const unsigned char* input, uint32_t width, uint32_t height, uint32_t channels, uint32_t outputWidth, uint32_t outputHeight, uint32_t cropWidth, uint32_t cropHeight, uint32_t outputPitch, uint32_t bitDepth, VkBool32 r2c, uint32_t transform, uint32_t color, double sharpenConst, unsigned char* output) {
+	//CPU reference of the GPU pipeline in double precision: forward FFT, spectrum shift into the zero-padded spectrum, inverse FFT of outputWidth x outputHeight, clamp, CAS sharpen and pack of its top-left cropWidth x cropHeight part
+	//R2C mode follows the C2R convention of VkFFT: the x Nyquist column of the input becomes the x Nyquist column of the output and imaginary parts of DC and Nyquist are ignored. C2C mode writes the magnitude of the complex result
+	//DCT mode resamples rows and then columns with the separable DCT-II/DCT-III pair, it has no Nyquist or wraparound special cases
+	//YCbCr mode resamples luma and alpha, chroma is upscaled bilinearly
+	std::vector<double> image((uint64_t)outputWidth * outputHeight);
+	std::vector<std::complex<double>> line;
+	double scale = 1.0 / ((double)width * height);
+	std::vector<float> chroma;
+	if (color) computeChroma(input, width, height, channels, bitDepth, chroma);
+	auto pixel = [&](uint64_t i, uint32_t v) {
+		return ((color) && (v == 0)) ? pixelLuma(input, i * channels, bitDepth) : loadSample(input, i * channels + ((color) ? v + 2 : v), bitDepth);
+	};
+	for (uint32_t v = 0; v < ((color) ? channels - 2 : channels); v++) {
+		if (transform == 1) {
+			std::vector<double> plane((uint64_t)width * height);
+			std::vector<double> rows((uint64_t)outputWidth * height);
+			for (uint64_t i = 0; i < (uint64_t)width * height; i++)
+				plane[i] = pixel(i, v);
+			for (uint32_t j = 0; j < height; j++)
+				referenceResampleDCT(&plane[(uint64_t)j * width], width, outputWidth, 1, 1, &rows[(uint64_t)j * outputWidth]);
+			for (uint32_t i = 0; i < outputWidth; i++)
+				referenceResampleDCT(&rows[i], height, outputHeight, outputWidth, outputWidth, &image[i]);
+			for (uint64_t i = 0; i < (uint64_t)outputWidth * outputHeight; i++)
+				image[i] = (fabs(image[i]) < 1.0) ? fabs(image[i]) : 1.0;
+		}
+		else {
+			uint32_t spectrumWidth = (r2c) ? width / 2 + 1 : width;
+			uint32_t outputSpectrumWidth = (r2c) ? outputWidth / 2 + 1 : outputWidth;
+			std::vector<std::complex<double>> spectrum((uint64_t)spectrumWidth * height);
+			std::vector<std::complex<double>> outputSpectrum((uint64_t)outputSpectrumWidth * outputHeight);
+			line.resize(width);
+			for (uint32_t j = 0; j < height; j++) {
+				for (uint32_t i = 0; i < width; i++)
+					line[i] = pixel((uint64_t)i + (uint64_t)j * width, v);
+				referenceFFT(line, -1);
+				for (uint32_t i = 0; i < spectrumWidth; i++)
+					spectrum[i + (uint64_t)j * spectrumWidth] = line[i];
+			}
+			line.resize(height);
+			for (uint32_t i = 0; i < spectrumWidth; i++) {
+				for (uint32_t j = 0; j < height; j++)
+					line[j] = spectrum[i + (uint64_t)j * spectrumWidth];
+				referenceFFT(line, -1);
+				uint32_t i_out;
+				if (r2c) {
+					uint32_t n = (width < outputWidth) ? width : outputWidth;
+					if (i > n / 2) continue;
+					i_out = (i < n / 2) ? i : outputWidth / 2;
+				}
+				else if (!retainedFrequency(i, width, outputWidth, &i_out)) continue;
+				for (uint32_t j = 0; j < height; j++) {
+					uint32_t j_out;
+					if (retainedFrequency(j, height, outputHeight, &j_out))
+						outputSpectrum[i_out + (uint64_t)j_out * outputSpectrumWidth] = line[j];
+				}
+			}
+			line.resize(outputHeight);
+			for (uint32_t i = 0; i < outputSpectrumWidth; i++) {
+				for (uint32_t j = 0; j < outputHeight; j++)
+					line[j] = outputSpectrum[i + (uint64_t)j * outputSpectrumWidth];
+				referenceFFT(line, 1);
+				for (uint32_t j = 0; j < outputHeight; j++)
+					outputSpectrum[i + (uint64_t)j * outputSpectrumWidth] = line[j];
+			}
+			line.resize(outputWidth);
+			for (uint32_t j = 0; j < outputHeight; j++) {
+				if (r2c) {
+					//C2R: restore the Hermitian half of the row
+					for (uint32_t i = 0; i < outputSpectrumWidth; i++)
+						line[i] = outputSpectrum[i + (uint64_t)j * outputSpectrumWidth];
+					line[0] = line[0].real();
+					if (outputWidth % 2 == 0) line[outputWidth / 2] = line[outputWidth / 2].real();
+					for (uint32_t i = 1; i < (outputWidth + 1) / 2; i++)
+						line[outputWidth - i] = std::conj(line[i]);
+				}
+				else {
+					for (uint32_t i = 0; i < outputWidth; i++)
+						line[i] = outputSpectrum[i + (uint64_t)j * outputSpectrumWidth];
+				}
+				referenceFFT(line, 1);
+				for (uint32_t i = 0; i < outputWidth; i++) {
+					double value = (r2c) ? fabs(line[i].real() * scale) : std::abs(line[i] * scale);
+					image[i + (uint64_t)j * outputWidth] = (value < 1.0) ? value : 1.0;
 				}
 			}
-			break;
 		}
-		case 1: {
-			double* buffer_input = (double*)buffer_input_void;
-			for (uint32_t v = 0; v < forward_configuration.coordinateFeatures; v++) {
-				for (uint32_t k = 0; k < forward_configuration.size[2]; k++) {
-					for (uint32_t j = 0; j < forward_configuration.size[1]; j++) {
-						for (uint32_t i = 0; i < forward_configuration.size[0]; i++) {
-							if (forward_configuration.performR2C)
-								buffer_input[(i + j * forward_configuration.size[0] + k * (forward_configuration.size[0] + 2) * forward_configuration.size[1] + v * (forward_configuration.size[0] + 2) * forward_configuration.size[1] * forward_configuration.size[2])] = (double)png_input[v + i * channels + j * width * channels] / 255.0;
-							else
-								buffer_input[2 * (i + j * forward_configuration.size[0] + k * (forward_configuration.size[0]) * forward_configuration.size[1] + v * (forward_configuration.size[0]) * forward_configuration.size[1] * forward_configuration.size[2])] = (double)png_input[v + i * channels + j * width * channels] / 255.0;
-						}
+		//same CAS formula as the pack shader, edges of the cropped part are clamped
+		for (uint32_t j = 0; j < cropHeight; j++) {
+			for (uint32_t i = 0; i < cropWidth; i++) {
+				double l[3][3];
+				for (int r = 0; r < 3; r++) {
+					for (int c = 0; c < 3; c++) {
+						int64_t x = (int64_t)i + c - 1;
+						int64_t y = (int64_t)j + r - 1;
+						x = (x < 0) ? 0 : ((x > cropWidth - 1) ? cropWidth - 1 : x);
+						y = (y < 0) ? 0 : ((y > cropHeight - 1) ? cropHeight - 1 : y);
+						l[r][c] = image[x + y * outputWidth];
 					}
 				}
+				double minL0 = std::min(l[0][1], std::min(l[1][0], std::min(l[1][1], std::min(l[1][2], l[2][1]))));
+				double minL1 = std::min(minL0, std::min(l[0][0], std::min(l[0][2], std::min(l[2][0], l[2][2]))));
+				double maxL0 = std::max(l[0][1], std::max(l[1][0], std::max(l[1][1], std::max(l[1][2], l[2][1]))));
+				double maxL1 = std::max(maxL0, std::max(l[0][0], std::max(l[0][2], std::max(l[2][0], l[2][2]))));
+				double minlen = 0.5 * (minL0 + minL1);
+				double maxlen = 0.5 * (maxL0 + maxL1);
+				minlen = minlen / (1.0 - minlen);
+				maxlen = (1.0 - maxlen) / maxlen;
+				double sharpen = -sharpenConst * sqrt((minlen < maxlen) ? minlen : maxlen);
+				double value = (l[1][1] + sharpen * (l[0][1] + l[1][0] + l[1][2] + l[2][1])) / (1.0 + sharpen * 4.0);
+				value = (value < 0.0) ? 0.0 : ((value > 1.0) ? 1.0 : value);
+				if ((color) && (v == 0))
+					packYCbCr(value, chroma.data(), width, height, outputWidth, outputHeight, i, j, (transform == 1) ? true : false, bitDepth, output + (uint64_t)j * outputPitch, (uint64_t)i * channels);
+				else
+					storeSample(output + (uint64_t)j * outputPitch, (uint64_t)i * channels + ((color) ? v + 2 : v), bitDepth, value);
 			}
-			break;
 		}
-		case 2: {
-			half* buffer_input = (half*)buffer_input_void;
-			for (uint32_t v = 0; v < forward_configuration.coordinateFeatures; v++) {
-				for (uint32_t k = 0; k < forward_configuration.size[2]; k++) {
-					for (uint32_t j = 0; j < forward_configuration.size[1]; j++) {
-						for (uint32_t i = 0; i < forward_configuration.size[0]; i++) {
-							if (forward_configuration.performR2C)
-								buffer_input[(i + j * forward_configuration.size[0] + k * (forward_configuration.size[0] + 2) * forward_configuration.size[1] + v * (forward_configuration.size[0] + 2) * forward_configuration.size[1] * forward_configuration.size[2])] = (half)png_input[v + i * channels + j * width * channels] / 255.0;
-							else
-								buffer_input[2 * (i + j * forward_configuration.size[0] + k * (forward_configuration.size[0]) * forward_configuration.size[1] + v * (forward_configuration.size[0]) * forward_configuration.size[1] * forward_configuration.size[2])] = (half)png_input[v + i * channels + j * width * channels] / 255.0;
-						}
+	}
+}
+double computeSSIM(const unsigned char* a, const unsigned char* b, uint32_t width, uint32_t height, uint32_t channels, uint32_t bitDepth, uint32_t pitch) {
+	//mean SSIM of 8x8 windows with step 4 on normalized samples, averaged over channels
+	const double c1 = 0.01 * 0.01;
+	const double c2 = 0.03 * 0.03;
+	double sum = 0;
+	uint64_t numWindows = 0;
+	for (uint32_t v = 0; v < channels; v++) {
+		for (uint32_t y = 0; y + 8 <= height; y += 4) {
+			for (uint32_t x = 0; x + 8 <= width; x += 4) {
+				double meanA = 0, meanB = 0, varA = 0, varB = 0, cov = 0;
+				for (uint32_t j = 0; j < 8; j++) {
+					for (uint32_t i = 0; i < 8; i++) {
+						uint64_t id = (uint64_t)(x + i) * channels + v;
+						meanA += loadSample(a + (uint64_t)(y + j) * pitch, id, bitDepth);
+						meanB += loadSample(b + (uint64_t)(y + j) * pitch, id, bitDepth);
 					}
 				}
+				meanA /= 64;
+				meanB /= 64;
+				for (uint32_t j = 0; j < 8; j++) {
+					for (uint32_t i = 0; i < 8; i++) {
+						uint64_t id = (uint64_t)(x + i) * channels + v;
+						double sampleA = loadSample(a + (uint64_t)(y + j) * pitch, id, bitDepth);
+						double sampleB = loadSample(b + (uint64_t)(y + j) * pitch, id, bitDepth);
+						varA += (sampleA - meanA) * (sampleA - meanA);
+						varB += (sampleB - meanB) * (sampleB - meanB);
+						cov += (sampleA - meanA) * (sampleB - meanB);
+					}
+				}
+				varA /= 63;
+				varB /= 63;
+				cov /= 63;
+				sum += ((2 * meanA * meanB + c1) * (2 * cov + c2)) / ((meanA * meanA + meanB * meanB + c1) * (varA + varB + c2));
+				numWindows++;
 			}
-			break;
 		}
+	}
+	return (numWindows > 0) ? sum / numWindows : 1.0;
+}
+VkBool32 validateImage(VkResampleContext* context, VkResampleConfiguration* config, const char* name, const unsigned char* input, const unsigned char* result) {
+	//compare the GPU result with the CPU reference. Thresholds are set about 8 dB below the lowest PSNR of the samples upscaled 0.5x, 1.5x and 2x: 58.6 dB, SSIM 0.9995 in single precision, 56.9 dB, SSIM 0.9991 with half precision input and output buffers. Double precision differs from the reference only in the order of operations
+	//tiled mode blends overlapping tiles, which is not an exact resample of the whole image, so it is only checked for gross errors
+	double minPSNR[3] = { 50.0, 60.0, 48.0 };
+	double minSSIM[3] = { 0.998, 0.9995, 0.997 };
+	double minPSNRTiled = 40.0;
+	double minSSIMTiled = 0.99;
+	//CPU backend computes in single precision
+	uint32_t precision = ((context->backend == 1) || (config->precision > 2)) ? 0 : config->precision;
+	std::vector<unsigned char> reference(context->outputSize);
+	std::vector<unsigned char> paddedInput;
+	if ((context->paddedWidth != (uint32_t)context->width) || (context->paddedHeight != (uint32_t)context->height)) {
+		padImage(input, context->width, context->height, context->pixelSize, context->paddedWidth, context->paddedHeight, paddedInput);
+		input = paddedInput.data();
+	}
+	referenceResample(input, context->paddedWidth, context->paddedHeight, context->channels, context->resampleWidth, context->resampleHeight, context->outputWidth, context->outputHeight, context->outputPitch, context->bitDepth, context->forward_configuration.performR2C, config->transform, context->color, config->sharpenConst, reference.data());
+	//max error is printed in sample units of the image bit depth, PSNR uses the matching peak value
+	double maxValue = (context->bitDepth == 16) ? 65535.0 : 255.0;
+	uint32_t maxError = 0;
+	double squaredError = 0;
+	for (uint32_t j = 0; j < context->outputHeight; j++) {
+		for (uint32_t i = 0; i < context->outputWidth * context->channels; i++) {
+			double error = fabs(loadSample(result + (uint64_t)j * context->outputPitch, i, context->bitDepth) - loadSample(reference.data() + (uint64_t)j * context->outputPitch, i, context->bitDepth)) * maxValue;
+			if ((uint32_t)(error + 0.5) > maxError) maxError = (uint32_t)(error + 0.5);
+			squaredError += error * error;
+		}
+	}
+	double mse = squaredError / ((double)context->outputWidth * context->outputHeight * context->channels);
+	double psnr = (mse > 0) ? 10 * log10(maxValue * maxValue / mse) : INFINITY;
+	double ssim = computeSSIM(result, reference.data(), context->outputWidth, context->outputHeight, context->channels, context->bitDepth, context->outputPitch);
+	VkBool32 passed = (context->tiled) ? (((psnr >= minPSNRTiled) && (ssim >= minSSIMTiled)) ? true : false) : (((psnr >= minPSNR[precision]) && (ssim >= minSSIM[precision])) ? true : false);
+	printf("Validation %s: max abs error %d PSNR %0.2f dB SSIM %0.5f - %s\n", name, maxError, psnr, ssim, (passed) ? "passed" : "FAILED");
+	std::lock_guard<std::mutex> lock(context->statsMutex);
+	if (!passed) context->numValidationFailures++;
+	if (maxError > context->validationMaxError) context->validationMaxError = maxError;
+	if (psnr < context->validationMinPSNR) context->validationMinPSNR = psnr;
+	if (ssim < context->validationMinSSIM) context->validationMinSSIM = ssim;
+	return passed;
+}
+static void appendPNGChunk(std::vector<unsigned char>& png, const char* type, const unsigned char* data, uint32_t size) {
+	//length, type, data and CRC of the type and data
+	unsigned char header[8] = { (unsigned char)(size >> 24), (unsigned char)(size >> 16), (unsigned char)(size >> 8), (unsigned char)size, (unsigned char)type[0], (unsigned char)type[1], (unsigned char)type[2], (unsigned char)type[3] };
+	png.insert(png.end(), header, header + 8);
+	if (size > 0) png.insert(png.end(), data, data + size);
+	uint32_t crc = stbiw__crc32(&png[png.size() - size - 4], size + 4);
+	unsigned char footer[4] = { (unsigned char)(crc >> 24), (unsigned char)(crc >> 16), (unsigned char)(crc >> 8), (unsigned char)crc };
+	png.insert(png.end(), footer, footer + 4);
+}
+int writePNG(const char* fileName, uint32_t width, uint32_t height, uint32_t channels, uint32_t bitDepth, const unsigned char* data, uint32_t pitch) {
+	//stb_image_write only writes 8-bit png files, 16-bit ones are written here with big-endian samples, unfiltered rows and the zlib compressor of stb_image_write
+	if (bitDepth == 8) return stbi_write_png(fileName, width, height, channels, data, pitch);
+	uint64_t rowSize = (uint64_t)width * channels * 2;
+	std::vector<unsigned char> raw((rowSize + 1) * height);
+	for (uint32_t j = 0; j < height; j++) {
+		unsigned char* row = &raw[(rowSize + 1) * j];
+		const uint16_t* samples = (const uint16_t*)(data + (uint64_t)j * pitch);
+		row[0] = 0;
+		for (uint64_t i = 0; i < (uint64_t)width * channels; i++) {
+			row[1 + 2 * i] = (unsigned char)(samples[i] >> 8);
+			row[2 + 2 * i] = (unsigned char)samples[i];
 		}
-		stbi_image_free(png_input);
-		//Sample buffer transfer tool. Uses staging buffer of the same size as destination buffer, which can be reduced if transfer is done sequentially in small buffers.
-		transferDataFromCPU(&vkGPU, buffer_input_void, &inputBuffer, inputBufferSize);
+	}
+	int compressedSize = 0;
+	unsigned char* compressed = stbi_zlib_compress(raw.data(), (int)raw.size(), &compressedSize, 8);
+	if (compressed == 0) return 0;
+	const unsigned char colorTypes[4] = { 0, 4, 2, 6 };
+	unsigned char ihdr[13] = { (unsigned char)(width >> 24), (unsigned char)(width >> 16), (unsigned char)(width >> 8), (unsigned char)width, (unsigned char)(height >> 24), (unsigned char)(height >> 16), (unsigned char)(height >> 8), (unsigned char)height, 16, colorTypes[channels - 1], 0, 0, 0 };
+	const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	std::vector<unsigned char> png(signature, signature + 8);
+	appendPNGChunk(png, "IHDR", ihdr, 13);
+	appendPNGChunk(png, "IDAT", compressed, (uint32_t)compressedSize);
+	appendPNGChunk(png, "IEND", 0, 0);
+	free(compressed);
+	FILE* file = fopen(fileName, "wb");
+	if (file == 0) return 0;
+	size_t written = fwrite(png.data(), 1, png.size(), file);
+	fclose(file);
+	return (written == png.size()) ? 1 : 0;
+}
+VkResampleBufferSet* acquireBufferSet(VkResampleContext* context) {
+	//wait until one of the buffer sets is free
+	std::unique_lock<std::mutex> lock(context->poolMutex);
+	context->poolCondition.wait(lock, [context] { return !context->freeBufferSets.empty(); });
+	VkResampleBufferSet* set = context->freeBufferSets.back();
+	context->freeBufferSets.pop_back();
+	return set;
+}
+void releaseBufferSet(VkResampleContext* context, VkResampleBufferSet* set) {
+	{
+		std::lock_guard<std::mutex> lock(context->poolMutex);
+		context->freeBufferSets.push_back(set);
+	}
+	context->poolCondition.notify_one();
+}
+static void abortResample(VkResampleContext* context, VkResult res) {
+	//threads of all devices share the work queue, so emptying it stops them after their current batch
+	context->nextFile->store(context->numFiles);
+	std::lock_guard<std::mutex> lock(context->statsMutex);
+	if (context->gpuResult == VK_SUCCESS) context->gpuResult = res;
+}
+static VkResult launchResample(VkResampleContext* context, VkResampleConfiguration config) {
+	//worker thread: decodes batches of png files, upscales them on one of the shared buffer sets and encodes the result
+	VkResult res = VK_SUCCESS;
+	int width = context->width;
+	int height = context->height;
+	int channels = context->channels;
+	uint32_t batchSize = context->batchSize;
+	char fileName[512] = "";
+	unsigned char* png_output = (unsigned char*)malloc(batchSize * context->outputSize * sizeof(char));
+	std::vector<unsigned char*> png_input(batchSize);
 
-		//Submit FFT+shift+iFFT.
+	uint32_t numProcessedFiles = 0;
+	double busyTime = 0;
+	double waitTime = 0;
+	double stageTime[4] = { 0, 0, 0, 0 };
+	//threads take batches of files from the shared counter, so a thread that got small png files simply takes more of them
+	for (uint32_t f = context->nextFile->fetch_add(batchSize); f < context->numFiles; f = context->nextFile->fetch_add(batchSize)) {
+		auto timeStart = std::chrono::system_clock::now();
+		uint32_t numImages = (context->numFiles - f < batchSize) ? context->numFiles - f : batchSize;
+		//decode stage
+		uint32_t numDecoded = 0;
+		for (; numDecoded < numImages; numDecoded++) {
+			if (config.fileUpload)
+				sprintf(fileName, "%s/%06d.png", config.ifolder_prefix, f + numDecoded + 1);
+			else
+				sprintf(fileName, "%s", config.png_input_name);
+			int fileChannels;
+			//images are converted to the channels and bit depth of the first one
+			if (context->bitDepth == 16)
+				png_input[numDecoded] = (unsigned char*)stbi_load_16(fileName, &width, &height, &fileChannels, channels);
+			else
+				png_input[numDecoded] = stbi_load(fileName, &width, &height, &fileChannels, channels);
+			if (png_input[numDecoded] == 0) {
+				printf("Image not found\n");
+				res = VK_INCOMPLETE;
+				break;
+			}
+			if ((width != context->width) || (height != context->height)) {
+				printf("Image %s has resolution %dx%d, all images in a batch must be %dx%d\n", fileName, width, height, context->width, context->height);
+				stbi_image_free(png_input[numDecoded]);
+				res = VK_INCOMPLETE;
+				break;
+			}
+		}
+		auto timeDecoded = std::chrono::system_clock::now();
+		stageTime[0] += std::chrono::duration_cast<std::chrono::microseconds>(timeDecoded - timeStart).count() * 0.001;
+		if (res != VK_SUCCESS) {
+			//a missing or mismatched file fails the whole run, like a failed submit
+			for (uint32_t i = 0; i < numDecoded; i++)
+				stbi_image_free(png_input[i]);
+			abortResample(context, res);
+			break;
+		}
+		VkResampleBufferSet* set = 0;
+		double totTime = 0;
+		if (context->backend == 1) {
+			//CPU stage: the same pipeline on the cores left to this thread, output is written to png_output directly
+			totTime = performCPUResample(context, png_input[0], png_output, config.numIter);
+			if (!config.validate) stbi_image_free(png_input[0]);
+		}
+		else {
+			//upload stage: fill data on CPU directly in the mapped staging frame of a free buffer set. It is best to perform all operations on GPU after initial upload.
+			set = acquireBufferSet(context);
+			char* staging = (char*)context->staging.ring.data + set->stagingOffset;
+			auto timeAcquired = std::chrono::system_clock::now();
+			waitTime += std::chrono::duration_cast<std::chrono::microseconds>(timeAcquired - timeDecoded).count() * 0.001;
+			if (context->tiled) {
+				//tiled mode uploads and reads back one row of tiles per submit, upscaled rows are copied to png_output directly
+				res = performTiledResample(context, set, png_input[0], png_output, config.numIter, &totTime);
+				if (!config.validate) stbi_image_free(png_input[0]);
+			}
+			else {
+				//raw png pixels are copied as is, conversion to the FFT layout is done on GPU
+				for (uint32_t i = 0; i < numImages; i++) {
+					memcpy(staging + i * context->rgbInputSize, png_input[i], (uint64_t)width * height * context->pixelSize);
+					if (!config.validate) stbi_image_free(png_input[i]);
+				}
+				stageTime[1] += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - timeAcquired).count() * 0.001;
 
-		double totTime = performVulkanUpscale(&vkGPU, &app_forward, &appShift, &app_inverse, &appSharpen, config.numIter);
+				//GPU stage: upload+unpack+FFT+shift+iFFT+sharpen/pack+readback of the whole batch in one submit of the recorded command buffer. Other threads decode and encode their images meanwhile.
+				res = performVulkanResample(context, set, config.numIter, &totTime);
+			}
+			if (res != VK_SUCCESS) {
+				//staging holds no valid frame: drop the batch and stop all threads of the run
+				if (config.validate) {
+					for (uint32_t i = 0; i < numImages; i++)
+						stbi_image_free(png_input[i]);
+				}
+				releaseBufferSet(context, set);
+				abortResample(context, res);
+				break;
+			}
+		}
 
-		if (!config.fileUpload) printf("VkResample %0.1fx upscale: %dx%d to %dx%d Time: %0.3f ms\n", config.upscale, width, height, (uint32_t)(config.upscale * width), (uint32_t)(config.upscale * height), totTime);
+		if (!config.fileUpload) printf("VkResample %0.2fx%0.2f upscale: %dx%d to %dx%d Time: %0.3f ms\n", context->outputWidth / (float)width, context->outputHeight / (float)height, width, height, context->outputWidth, context->outputHeight, totTime);
 
-		//Transfer data from GPU using staging buffer.
-		if (inverse_configuration.performR2C)
-			transferDataToCPU(&vkGPU, buffer_output_void, &buffer, channels * config.upscale * config.upscale * width * height * complexSize / 2);
-		else
-			transferDataToCPU(&vkGPU, buffer_output_void, &tempBuffer, channels * config.upscale * config.upscale * width * height * complexSize / 2);
+		//readback stage: copy the packed upscaled images from the mapped staging buffer
+		auto timeReadback = std::chrono::system_clock::now();
 
 		bool png_output_name_set = false;
 		if ((!config.fileUpload) && (config.png_output_name == 0)) {
 			png_output_name_set = true;
 			config.png_output_name = (char*)malloc(100 * sizeof(char));
-			sprintf(config.png_output_name, "%d_%d_upscaled.png", forward_configuration.size[0], (uint32_t)(config.upscale * forward_configuration.size[0]));
-		}
-		switch (config.precision) {
-		case 0: {
-			float* buffer_output = (float*)buffer_output_void;
-			for (uint32_t v = 0; v < inverse_configuration.coordinateFeatures; v++) {
-				for (uint32_t k = 0; k < inverse_configuration.size[2]; k++) {
-					for (uint32_t j = 0; j < inverse_configuration.size[1]; j++) {
-						for (uint32_t i = 0; i < inverse_configuration.size[0]; i++) {
-							png_output[v + i * channels + j * (uint32_t)(config.upscale * width) * channels] = 255.0 * (buffer_output[(i + j * forward_configuration.bufferStride[0] + k * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] + v * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2])]);
-						}
-					}
-				}
-			}
-			break;
+			sprintf(config.png_output_name, "%d_%d_upscaled.png", width, context->outputWidth);
 		}
-		case 1: {
-			double* buffer_output = (double*)buffer_output_void;
-			for (uint32_t v = 0; v < inverse_configuration.coordinateFeatures; v++) {
-				for (uint32_t k = 0; k < inverse_configuration.size[2]; k++) {
-					for (uint32_t j = 0; j < inverse_configuration.size[1]; j++) {
-						for (uint32_t i = 0; i < inverse_configuration.size[0]; i++) {
-							png_output[v + i * channels + j * (uint32_t)(config.upscale * width) * channels] = 255.0 * (buffer_output[(i + j * forward_configuration.bufferStride[0] + k * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] + v * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2])]);
-						}
-					}
-				}
-			}
-			break;
+		if (set) {
+			if (!context->tiled) memcpy(png_output, (char*)context->staging.ring.data + set->stagingOffset + context->stagingOutputOffset, numImages * context->outputSize);
+			releaseBufferSet(context, set);
 		}
-		case 2: {
-			half* buffer_output = (half*)buffer_output_void;
-			for (uint32_t v = 0; v < inverse_configuration.coordinateFeatures; v++) {
-				for (uint32_t k = 0; k < inverse_configuration.size[2]; k++) {
-					for (uint32_t j = 0; j < inverse_configuration.size[1]; j++) {
-						for (uint32_t i = 0; i < inverse_configuration.size[0]; i++) {
-							png_output[v + i * channels + j * (uint32_t)(config.upscale * width) * channels] = 255.0 * (buffer_output[(i + j * forward_configuration.bufferStride[0] + k * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] + v * (forward_configuration.bufferStride[0]) * forward_configuration.bufferStride[1] * forward_configuration.bufferStride[2])]);
-						}
-					}
-				}
+		auto timeEncode = std::chrono::system_clock::now();
+		stageTime[2] += std::chrono::duration_cast<std::chrono::microseconds>(timeEncode - timeReadback).count() * 0.001;
+		//encode stage
+		for (uint32_t i = 0; i < numImages; i++) {
+			if (config.fileUpload)
+				sprintf(fileName, "%s/%06d.png", config.ofolder_prefix, f + i + 1);
+			else
+				sprintf(fileName, "%s", config.png_output_name);
+
+			writePNG(fileName, context->outputWidth, context->outputHeight, channels, context->bitDepth, png_output + i * context->outputSize, context->outputPitch);
+			if (config.validate) {
+				validateImage(context, &config, fileName, png_input[i], png_output + i * context->outputSize);
+				stbi_image_free(png_input[i]);
 			}
-			break;
-		}
 		}
-		if (config.fileUpload)
-			sprintf(fileName, "%s/%06d.png", config.ofolder_prefix, f * config.numThreads + config.threadId + 1);
-		else
-			sprintf(fileName, "%s", config.png_output_name);
-
-		stbi_write_png(fileName, (uint32_t)(config.upscale * width), (uint32_t)(config.upscale * height), channels, png_output, (uint32_t)(config.upscale * width * channels));
 		if ((!config.fileUpload) && (config.png_output_name == 0)) {
 			free(config.png_output_name);
 		}
+		auto timeEnd = std::chrono::system_clock::now();
+		stageTime[3] += std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeEncode).count() * 0.001;
+		busyTime += std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeStart).count() * 0.001;
+		numProcessedFiles += numImages;
 	}
 	free(png_output);
-	free(buffer_input_void);
-	free(buffer_output_void);
-	vkDestroyBuffer(vkGPU.device, inputBuffer, NULL);
-	vkFreeMemory(vkGPU.device, inputBufferDeviceMemory, NULL);
-	vkDestroyBuffer(vkGPU.device, buffer, NULL);
-	vkFreeMemory(vkGPU.device, bufferDeviceMemory, NULL);
-	vkDestroyBuffer(vkGPU.device, tempBuffer, NULL);
-	vkFreeMemory(vkGPU.device, tempBufferDeviceMemory, NULL);
-	deleteVulkanFFT(&app_forward);
-	deleteVulkanFFT(&app_inverse);
-	deleteShiftApp(&vkGPU, &appShift);
-	deleteShiftApp(&vkGPU, &appSharpen);
+	{
+		std::lock_guard<std::mutex> lock(context->statsMutex);
+		for (uint32_t i = 0; i < 4; i++)
+			context->stageTime[i] += stageTime[i];
+		context->numProcessedFiles += numProcessedFiles;
+	}
 	//free(buffer_input);
-	printf("Thread %d finished. Device name: %s API:%d.%d.%d\n", config.threadId, vkGPU.physicalDeviceProperties.deviceName, (vkGPU.physicalDeviceProperties.apiVersion >> 22), ((vkGPU.physicalDeviceProperties.apiVersion >> 12) & 0x3ff), (vkGPU.physicalDeviceProperties.apiVersion & 0xfff));
-	vkDestroyFence(vkGPU.device, vkGPU.fence, NULL);
-	vkDestroyCommandPool(vkGPU.device, vkGPU.commandPool, NULL);
-	vkDestroyDevice(vkGPU.device, NULL);
-	DestroyDebugUtilsMessengerEXT(&vkGPU, NULL);
-	vkDestroyInstance(vkGPU.instance, NULL);
-	return VK_SUCCESS;
+	if (config.fileUpload) printf("Thread %d finished: %d files, busy %0.3f s, waited for GPU buffers %0.3f s\n", config.threadId, numProcessedFiles, busyTime / 1000, waitTime / 1000);
+	return res;
+}
+
+static VkResult runResample(VkResampleConfiguration* config, VkResampleRunStats* stats) {
+	//one device, one set of plans and one buffer pool per selected device, threads are split between devices
+	//all threads take files from one shared queue: a device takes its next batch as soon as it is done with the previous one, so its share of the files follows its measured throughput without a static split
+	uint32_t numDevices = ((config->backend == 0) && (config->fileUpload)) ? config->numDevices : 1;
+	std::atomic<uint32_t> nextFile(0);
+	std::vector<VkResampleContext*> contexts(numDevices);
+	std::vector<VkResampleConfiguration> deviceConfigs(numDevices, *config);
+	VkResult res = VK_SUCCESS;
+	for (uint32_t d = 0; d < numDevices; d++) {
+		deviceConfigs[d].device_id = (numDevices > 1) ? config->deviceIds[d] : config->device_id;
+		deviceConfigs[d].numDevices = numDevices;
+		deviceConfigs[d].numThreads = config->numThreads / numDevices + ((d < config->numThreads % numDevices) ? 1 : 0);
+		if (deviceConfigs[d].numBuffers > deviceConfigs[d].numThreads) deviceConfigs[d].numBuffers = deviceConfigs[d].numThreads;
+		if (numDevices > 1) printf("Device %d: %d threads\n", deviceConfigs[d].device_id, deviceConfigs[d].numThreads);
+		contexts[d] = new VkResampleContext();
+		res = createResampleContext(contexts[d], &deviceConfigs[d]);
+		if (res != VK_SUCCESS) {
+			//the context of device d is partially created, deleteResampleContext releases what it holds
+			for (uint32_t i = 0; i <= d; i++) {
+				deleteResampleContext(contexts[i]);
+				delete contexts[i];
+			}
+			return res;
+		}
+		contexts[d]->nextFile = &nextFile;
+	}
+	auto timeStart = std::chrono::system_clock::now();
+	std::vector<std::thread> threads;
+	uint32_t threadId = 0;
+	for (uint32_t d = 0; d < numDevices; d++) {
+		for (uint32_t i = 0; i < deviceConfigs[d].numThreads; i++) {
+			VkResampleConfiguration loc_config = deviceConfigs[d];
+			loc_config.threadId = threadId++;
+			threads.push_back(std::thread(launchResample, contexts[d], loc_config));
+		}
+	}
+
+	for (uint32_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+	for (uint32_t d = 0; d < numDevices; d++) {
+		if ((res == VK_SUCCESS) && (contexts[d]->gpuResult != VK_SUCCESS)) res = contexts[d]->gpuResult;
+	}
+	if (res != VK_SUCCESS) {
+		printf("Upscale aborted, error code: %d\n", res);
+		for (uint32_t d = 0; d < numDevices; d++) {
+			deleteResampleContext(contexts[d]);
+			delete contexts[d];
+		}
+		return res;
+	}
+	double runTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - timeStart).count() * 0.001;
+	uint32_t numProcessedFiles = 0;
+	for (uint32_t d = 0; d < numDevices; d++)
+		numProcessedFiles += contexts[d]->numProcessedFiles;
+	double recordTime = 0;
+	double submitTime = 0;
+	uint32_t numSubmits = 0;
+	for (uint32_t d = 0; d < numDevices; d++) {
+		VkResampleContext* context = contexts[d];
+		VkResampleConfiguration* deviceConfig = &deviceConfigs[d];
+		if (numDevices > 1) {
+			double share = (numProcessedFiles > 0) ? 100.0 * context->numProcessedFiles / numProcessedFiles : 0;
+			printf("Device %d %s: %d frames (%0.1f%%), %0.1f frames/s, GPU %0.1f frames/s\n", deviceConfig->device_id, context->vkGPU.physicalDeviceProperties.deviceName, context->numProcessedFiles, share, (runTime > 0) ? context->numProcessedFiles / (runTime * 0.001) : 0, (context->gpuBusyTime > 0) ? context->numProcessedFiles / (context->gpuBusyTime * 0.001) : 0);
+		}
+		if (context->timestampSamples.size() > 0) printTimestamps(context);
+		if ((deviceConfig->validate) && (context->numProcessedFiles > 0))
+			printf("Validation against CPU reference: %d of %d images failed, max abs error %d, min PSNR %0.2f dB, min SSIM %0.5f\n", context->numValidationFailures, context->numProcessedFiles, context->validationMaxError, context->validationMinPSNR, context->validationMinSSIM);
+		stats->numValidationFailures += context->numValidationFailures;
+		if ((deviceConfig->fileUpload) && (context->numProcessedFiles > 0)) {
+			//steady-state throughput of each stage. CPU stages run on all threads of the device in parallel, GPU stage is limited by one queue. The slowest stage bounds the total
+			uint32_t frames = context->numProcessedFiles;
+			printf("Stage throughput, frames/s: decode %0.1f upload %0.1f %s %0.1f readback %0.1f encode %0.1f\n", frames * deviceConfig->numThreads / (context->stageTime[0] * 0.001), (context->stageTime[1] > 0) ? frames * deviceConfig->numThreads / (context->stageTime[1] * 0.001) : 0, (context->backend == 1) ? "CPU" : "GPU", (context->gpuBusyTime > 0) ? frames / (context->gpuBusyTime * 0.001) : 0, (context->stageTime[2] > 0) ? frames * deviceConfig->numThreads / (context->stageTime[2] * 0.001) : 0, frames * deviceConfig->numThreads / (context->stageTime[3] * 0.001));
+		}
+		if (context->tiled) {
+			//tiles overlap and the last ones extend past the image, so they transform more pixels than the whole image
+			double tiledArea = (double)context->tiling.numTiles[0] * context->tiling.numTiles[1] * context->tiling.tileSize * context->tiling.tileSize / ((double)context->width * context->height);
+			printf("Tiled mode: tiles cover %0.2fx the image area, expected throughput loss against whole image mode is at least %0.1f%%\n", tiledArea, 100.0 * (1.0 - 1.0 / tiledArea));
+		}
+		if (context->tiled) stats->tiled = 1;
+		//devices work in parallel, so their GPU throughputs add up
+		stats->gpuImagesPerSecond += (context->gpuBusyTime > 0) ? context->numProcessedFiles / (context->gpuBusyTime * 0.001) : 0;
+		recordTime += context->recordTime;
+		submitTime += context->submitTime;
+		numSubmits += context->numSubmits;
+	}
+	stats->paddedWidth = contexts[0]->paddedWidth;
+	stats->paddedHeight = contexts[0]->paddedHeight;
+	stats->batchSize = contexts[0]->batchSize;
+	stats->imagesPerSecond = (runTime > 0) ? numProcessedFiles / (runTime * 0.001) : 0;
+	if (numDevices > 1) printf("All %d devices: %d frames, %0.1f frames/s, GPU %0.1f frames/s\n", numDevices, numProcessedFiles, stats->imagesPerSecond, stats->gpuImagesPerSecond);
+	if (numSubmits > 0) {
+		//recorded once: recording time of all buffer sets is spread over all submits
+		stats->recordTimePerSubmit = recordTime / numSubmits;
+		stats->submitTimePerSubmit = submitTime / numSubmits;
+		printf("CPU time per submit: recording %0.4f ms, vkQueueSubmit %0.4f ms (command buffers %s)\n", stats->recordTimePerSubmit, stats->submitTimePerSubmit, (config->recordMode) ? "recorded before every submit" : "recorded once and replayed");
+	}
+	for (uint32_t d = 0; d < numDevices; d++) {
+		deleteResampleContext(contexts[d]);
+		delete contexts[d];
+	}
+	return res;
 }
 
 bool findFlag(char** start, char** end, const std::string& flag) {
@@ -1795,25 +3869,61 @@ char* getFlagValue(char** start, char** end, const std::string& flag)
 int main(int argc, char* argv[])
 {
 	VkResampleConfiguration config;
-	config.upscale = 1;
+	config.upscaleX = 1;
+	config.upscaleY = 1;
+	config.outputWidth = 0;
+	config.outputHeight = 0;
 	config.precision = 0;
 	config.numIter = 1;
 	config.device_id = 0;
+	config.numDevices = 1;
+	config.deviceIds[0] = 0;
 	config.numThreads = 1;
 	config.sharpenConst = 0.2;
 	config.png_output_name = 0;
+	config.cacheDir = 0;
+	config.numBuffers = 0;
+	config.shiftPass = 0;
+	config.batchSize = 0;
+	config.batchSweep = 0;
+	config.timestamps = 0;
+	config.validate = 0;
+	config.backend = 0;
+	config.maxVRAM = 0;
+	config.tileCompare = 0;
+	config.transform = 0;
+	config.color = 0;
+	config.padMode = 0;
+	config.padBenchmark = 0;
+	config.recordMode = 0;
+	config.singleQueue = 0;
+	config.recordBenchmark = 0;
 	if (findFlag(argv, argv + argc, "-h"))
 	{
 		//print help
 		printf("VkResample v1.0.2 (16-01-2021). Author: Tolmachev Dmitrii\n");
-		printf("Works with png images only, for now!\n");
+		printf("Works with png images only, for now! Grayscale, gray+alpha, RGB and RGBA images with 8 or 16 bits per sample are supported\n");
 		printf("	-h: print help\n");
 		printf("	-devices: print the list of available GPU devices\n");
-		printf("	-d X: select GPU device (default 0)\n");
-		printf("	-u X: specify upscale factor (float, make sure that upscaled image can be represented as a multiplication of 2s, 3s, 5s and 7s)\n");
+		printf("	-d X: select GPU device (default 0). A comma separated list like 0,1 or all shards batched mode files across the devices, each with its own plans and buffer sets and numthreads / number of devices threads\n");
+		printf("	-u X: specify upscale factor of both axes (float, default 1). Values below 1 downscale by cropping the spectrum\n");
+		printf("	-ux X, -uy X: specify upscale factor of x or y axis only\n");
+		printf("	-W X, -H X: specify output width or height. With only one of them the aspect ratio is kept. Sizes VkFFT can not transform are resampled to the nearest larger supported size and cropped\n");
 		printf("	-p X: specify precision (0 - single, 1 - double, 2 - half, default - single)\n");
 		printf("	-s X: specify sharpening factor, range 0.0-0.2 (default 0.2) \n");
 		printf("	-n X: specify how many times to perform upscale. This removes dispatch overhead and will show the real application performance (default 1)\n");
+		printf("	-cache DIR: store compiled shaders and pipeline cache in DIR, so next launches skip shader compilation\n");
+		printf("	-transform X: specify transform, fft or dct. DCT has no wraparound, so image edges do not ring (default fft)\n");
+		printf("	-color X: specify color space, rgb or ycbcr. In ycbcr only luma is resampled with the FFT and sharpened, chroma is upscaled bilinearly. Alpha is resampled as its own plane. This takes a third of the FFT work (default rgb)\n");
+		printf("	-shiftpass: shift (crop when downscaling) the spectrum with a separate dispatch instead of reading it split (cropped) in the inverse FFT. Use with -n to compare timings\n");
+		printf("	-singlequeue: submit staging copies to the compute queue even if the device has a transfer-only queue family. Use with -n to compare timings\n");
+		printf("	-recordbench: also run with the command buffers recorded before every submit instead of recorded once per buffer set and replayed, and compare CPU time per submit\n");
+		printf("	-timestamps: measure GPU time of each stage and each VkFFT kernel with timestamp queries and print min/median/p99\n");
+		printf("	-backend X: run the pipeline on vulkan or cpu. CPU backend uses multithreaded SIMD FFTs in single precision (default vulkan)\n");
+		printf("	-maxvram X: specify VRAM budget of all buffer sets in MB. Images that do not fit it are upscaled in overlapping tiles (default - half of VRAM)\n");
+		printf("	-tilecompare: in tiled mode also run whole image mode with the default budget and print the throughput lost to tiling\n");
+		printf("	-padbench: also run the images padded to the Bluestein convolution length (next power of two not smaller than 2N - 1) and compare it with the padding to supported sizes. A Bluestein transform runs two FFTs of this length, so the printed slowdown is a lower bound\n");
+		printf("	-validate: compare every upscaled image with a double precision CPU reference and print max abs error, PSNR and SSIM. Exit code is 1 if any image is below the threshold for the selected precision\n");
 		printf("Single image mode:\n");
 		printf("	-i NAME: specify input png file path\n");
 		printf("	-o NAME: specify output png file path (default X_X_upscale.png)\n");
@@ -1822,9 +3932,27 @@ int main(int argc, char* argv[])
 		printf("	-ofolder X: specify output folder plus file prefix, like outp/img\n");
 		printf("	-numfiles X: specify how many images to upscale. They should have names like prefix + 000001.png with numbers padded with zeros to six digits. Temporary limitation.\n");
 		printf("	-numthreads X: specify how many threads to launch. Used to speed up png reads\n");
+		printf("	-numbuffers X: specify how many GPU buffer sets are shared by the threads. VRAM usage scales with this number, not with the number of threads (default min(numthreads, 3))\n");
+		printf("	-batch X: specify how many images are packed in one buffer set and transformed by one submit (default - as many as fit in half of VRAM, up to 32)\n");
+		printf("	-batchsweep: also run with batch sizes 1, 2, 4, ... below the selected one and print images/s for each of them\n");
 		return 0;
 	}
 	glslang_initialize_process();//compiler can be initialized before VkFFT
+	if (findFlag(argv, argv + argc, "-backend"))
+	{
+		//select Vulkan or CPU backend
+		char* value = getFlagValue(argv, argv + argc, "-backend");
+		if ((value != 0) && (!strcmp(value, "cpu"))) {
+			config.backend = 1;
+		}
+		else if ((value != 0) && (!strcmp(value, "vulkan"))) {
+			config.backend = 0;
+		}
+		else {
+			printf("No proper backend is selected with -backend flag, use vulkan or cpu\n");
+			return 1;
+		}
+	}
 	if (findFlag(argv, argv + argc, "-devices"))
 	{
 		//print device list
@@ -1835,8 +3963,28 @@ int main(int argc, char* argv[])
 	{
 		//select device_id
 		char* value = getFlagValue(argv, argv + argc, "-d");
-		if (value != 0) {
-			sscanf(value, "%d", &config.device_id);
+		if ((value != 0) && (!strcmp(value, "all"))) {
+			uint32_t deviceCount = 0;
+			VkResult res = getDeviceCount(&deviceCount);
+			if ((res != VK_SUCCESS) || (deviceCount == 0)) {
+				printf("No devices found for -d all\n");
+				return 1;
+			}
+			config.numDevices = (deviceCount < 16) ? deviceCount : 16;
+			for (uint32_t i = 0; i < config.numDevices; i++)
+				config.deviceIds[i] = i;
+		}
+		else if (value != 0) {
+			//comma separated list of device ids
+			config.numDevices = 0;
+			for (char* id = value; (id != 0) && (config.numDevices < 16); id = strchr(id, ',')) {
+				if (id[0] == ',') id++;
+				if (sscanf(id, "%d", &config.deviceIds[config.numDevices]) == 1) config.numDevices++;
+			}
+			if (config.numDevices == 0) {
+				printf("No device is selected with -d flag\n");
+				return 1;
+			}
 		}
 		else {
 			printf("No device is selected with -d flag\n");
@@ -1876,19 +4024,129 @@ int main(int argc, char* argv[])
 			return 1;
 		}
 	}
+	if (findFlag(argv, argv + argc, "-transform"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-transform");
+		if ((value != 0) && (!strcmp(value, "dct"))) {
+			config.transform = 1;
+		}
+		else if ((value != 0) && (!strcmp(value, "fft"))) {
+			config.transform = 0;
+		}
+		else {
+			printf("No proper transform is selected with -transform flag, use fft or dct\n");
+			return 1;
+		}
+	}
+	if (findFlag(argv, argv + argc, "-color"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-color");
+		if ((value != 0) && (!strcmp(value, "ycbcr"))) {
+			config.color = 1;
+		}
+		else if ((value != 0) && (!strcmp(value, "rgb"))) {
+			config.color = 0;
+		}
+		else {
+			printf("No proper color space is selected with -color flag, use rgb or ycbcr\n");
+			return 1;
+		}
+	}
+	if (findFlag(argv, argv + argc, "-shiftpass"))
+		config.shiftPass = 1;
+	if (findFlag(argv, argv + argc, "-timestamps"))
+		config.timestamps = 1;
+	if (findFlag(argv, argv + argc, "-recordbench"))
+		config.recordBenchmark = 1;
+	if (findFlag(argv, argv + argc, "-singlequeue"))
+		config.singleQueue = 1;
+	if (findFlag(argv, argv + argc, "-validate"))
+		config.validate = 1;
+	if (findFlag(argv, argv + argc, "-maxvram"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-maxvram");
+		if (value != 0) {
+			sscanf(value, "%d", &config.maxVRAM);
+		}
+		else {
+			printf("No VRAM budget is selected with -maxvram flag\n");
+			return 1;
+		}
+	}
+	if (findFlag(argv, argv + argc, "-tilecompare"))
+		config.tileCompare = 1;
+	if (findFlag(argv, argv + argc, "-padbench"))
+		config.padBenchmark = 1;
+	if (findFlag(argv, argv + argc, "-cache"))
+	{
+		config.cacheDir = getFlagValue(argv, argv + argc, "-cache");
+		if (config.cacheDir == 0) {
+			printf("No cache directory is selected with -cache flag\n");
+			return 1;
+		}
+#ifdef _WIN32
+		_mkdir(config.cacheDir);
+#else
+		mkdir(config.cacheDir, 0755);
+#endif
+	}
 	if (findFlag(argv, argv + argc, "-u"))
 	{
 		char* value = getFlagValue(argv, argv + argc, "-u");
 		if (value != 0) {
-			sscanf(value, "%f", &config.upscale);
+			sscanf(value, "%f", &config.upscaleX);
+			config.upscaleY = config.upscaleX;
 		}
 		else {
 			printf("No proper upscale factor is selected with -u flag, default 1\n");
 		}
 	}
-	else {
+	else if ((!findFlag(argv, argv + argc, "-ux")) && (!findFlag(argv, argv + argc, "-uy")) && (!findFlag(argv, argv + argc, "-W")) && (!findFlag(argv, argv + argc, "-H"))) {
 		printf("No upscale factor is selected with -u flag, default 1\n");
 	}
+	if (findFlag(argv, argv + argc, "-ux"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-ux");
+		if (value != 0) {
+			sscanf(value, "%f", &config.upscaleX);
+		}
+		else {
+			printf("No proper upscale factor is selected with -ux flag\n");
+		}
+	}
+	if (findFlag(argv, argv + argc, "-uy"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-uy");
+		if (value != 0) {
+			sscanf(value, "%f", &config.upscaleY);
+		}
+		else {
+			printf("No proper upscale factor is selected with -uy flag\n");
+		}
+	}
+	if (findFlag(argv, argv + argc, "-W"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-W");
+		if (value != 0) {
+			sscanf(value, "%d", &config.outputWidth);
+			//a single target size keeps the aspect ratio, unless the other axis is scaled explicitly
+			if ((!findFlag(argv, argv + argc, "-H")) && (!findFlag(argv, argv + argc, "-u")) && (!findFlag(argv, argv + argc, "-uy"))) config.upscaleY = 0;
+		}
+		else {
+			printf("No proper output width is selected with -W flag\n");
+		}
+	}
+	if (findFlag(argv, argv + argc, "-H"))
+	{
+		char* value = getFlagValue(argv, argv + argc, "-H");
+		if (value != 0) {
+			sscanf(value, "%d", &config.outputHeight);
+			if ((!findFlag(argv, argv + argc, "-W")) && (!findFlag(argv, argv + argc, "-u")) && (!findFlag(argv, argv + argc, "-ux"))) config.upscaleX = 0;
+		}
+		else {
+			printf("No proper output height is selected with -H flag\n");
+		}
+	}
 
 	if (!findFlag(argv, argv + argc, "-ifolder")) {
 		config.fileUpload = 0;
@@ -1943,6 +4201,30 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 		}
+		if (findFlag(argv, argv + argc, "-numbuffers"))
+		{
+			char* value = getFlagValue(argv, argv + argc, "-numbuffers");
+			if (value != 0) {
+				sscanf(value, "%d", &config.numBuffers);
+			}
+			else {
+				printf("No numBuffers is selected with -numbuffers flag\n");
+				return 1;
+			}
+		}
+		if (findFlag(argv, argv + argc, "-batch"))
+		{
+			char* value = getFlagValue(argv, argv + argc, "-batch");
+			if (value != 0) {
+				sscanf(value, "%d", &config.batchSize);
+			}
+			else {
+				printf("No batch size is selected with -batch flag\n");
+				return 1;
+			}
+		}
+		if (findFlag(argv, argv + argc, "-batchsweep"))
+			config.batchSweep = 1;
 		if (findFlag(argv, argv + argc, "-numfiles"))
 		{
 			char* value = getFlagValue(argv, argv + argc, "-numfiles");
@@ -1955,23 +4237,77 @@ int main(int argc, char* argv[])
 			}
 		}
 	}
+	config.device_id = config.deviceIds[0];
+	if ((config.numDevices > 1) && ((!config.fileUpload) || (config.backend == 1))) {
+		printf("Multiple devices are used in batched mode of the Vulkan backend only, device %d is selected\n", config.device_id);
+		config.numDevices = 1;
+	}
+	if (config.numThreads < config.numDevices) {
+		//every device needs at least one thread to take files from the queue
+		printf("%d threads are used, one per device\n", config.numDevices);
+		config.numThreads = config.numDevices;
+	}
+	if (config.numBuffers == 0) config.numBuffers = (config.numThreads < 3) ? config.numThreads : 3;
+	if (config.numBuffers > config.numThreads) config.numBuffers = config.numThreads;
 	auto timeSubmit = std::chrono::system_clock::now();
-	std::vector<std::thread> threads;
-	//launchResample(&vkGPU, png_input_name, png_output_name, upscale, precision, numIter);
-	for (uint32_t i = 0; i < config.numThreads; i++) {
-		VkResampleConfiguration loc_config = config;
-		loc_config.threadId = i;
-		threads.push_back(std::thread(launchResample, loc_config));
+	VkResampleRunStats stats = {};
+	VkResult res = runResample(&config, &stats);
+	if (res != VK_SUCCESS) return res;
+	if ((config.tileCompare) && (stats.tiled)) {
+		//rerun the same images without the -maxvram budget
+		VkResampleConfiguration whole_config = config;
+		whole_config.maxVRAM = 0;
+		VkResampleRunStats whole_stats = {};
+		res = runResample(&whole_config, &whole_stats);
+		if (res != VK_SUCCESS) return res;
+		if (whole_stats.tiled)
+			printf("Image does not fit half of VRAM in whole image mode either\n");
+		else
+			printf("Tiled mode: %0.1f images/s (GPU %0.1f), whole image mode: %0.1f images/s (GPU %0.1f), %0.1f%% of GPU throughput lost to tiling\n", stats.imagesPerSecond, stats.gpuImagesPerSecond, whole_stats.imagesPerSecond, whole_stats.gpuImagesPerSecond, (whole_stats.gpuImagesPerSecond > 0) ? 100.0 * (1.0 - stats.gpuImagesPerSecond / whole_stats.gpuImagesPerSecond) : 0);
 	}
-
-	for (uint32_t i = 0; i < config.numThreads; i++) {
-		threads[i].join();
+	if ((config.recordBenchmark) && (config.backend == 0)) {
+		//rerun the same images recording the command buffers before every submit, as they were recorded before they were replayed
+		VkResampleConfiguration record_config = config;
+		record_config.recordMode = 1;
+		VkResampleRunStats record_stats = {};
+		res = runResample(&record_config, &record_stats);
+		if (res != VK_SUCCESS) return res;
+		double replayTime = stats.recordTimePerSubmit + stats.submitTimePerSubmit;
+		double recordTime = record_stats.recordTimePerSubmit + record_stats.submitTimePerSubmit;
+		printf("CPU time per submit: replayed %0.4f ms, recorded every submit %0.4f ms, %0.2fx less CPU time\n", replayTime, recordTime, (replayTime > 0) ? recordTime / replayTime : 0);
+	}
+	if (config.padBenchmark) {
+		//rerun the same images padded to the length, a Bluestein transform of the input size would run its FFTs at. It runs two of them per transform, so it is at least two times slower than this run
+		VkResampleConfiguration bluestein_config = config;
+		bluestein_config.padMode = 1;
+		VkResampleRunStats bluestein_stats = {};
+		res = runResample(&bluestein_config, &bluestein_stats);
+		if (res != VK_SUCCESS) return res;
+		printf("Padding to %dx%d: %0.1f images/s (%s %0.1f), padding to Bluestein length %dx%d: %0.1f images/s (%s %0.1f), at least %0.2fx slower (lower bound: one FFT of the Bluestein length per transform, Bluestein runs two)\n", stats.paddedWidth, stats.paddedHeight, stats.imagesPerSecond, (config.backend == 1) ? "CPU" : "GPU", stats.gpuImagesPerSecond, bluestein_stats.paddedWidth, bluestein_stats.paddedHeight, bluestein_stats.imagesPerSecond, (config.backend == 1) ? "CPU" : "GPU", bluestein_stats.gpuImagesPerSecond, (bluestein_stats.gpuImagesPerSecond > 0) ? stats.gpuImagesPerSecond / bluestein_stats.gpuImagesPerSecond : 0);
+	}
+	if (config.fileUpload) {
+		std::vector<VkResampleRunStats> sweep;
+		sweep.push_back(stats);
+		if (config.batchSweep) {
+			//rerun the batch with smaller batch sizes to show how throughput depends on it
+			for (uint32_t batchSize = 1; batchSize < stats.batchSize; batchSize *= 2) {
+				VkResampleConfiguration sweep_config = config;
+				sweep_config.batchSize = batchSize;
+				VkResampleRunStats sweep_stats = {};
+				res = runResample(&sweep_config, &sweep_stats);
+				if (res != VK_SUCCESS) return res;
+				sweep.push_back(sweep_stats);
+			}
+			std::sort(sweep.begin(), sweep.end(), [](const VkResampleRunStats& a, const VkResampleRunStats& b) { return a.batchSize < b.batchSize; });
+		}
+		for (uint32_t i = 0; i < sweep.size(); i++)
+			printf("Batch size: %d images/s: %0.1f %s images/s: %0.1f\n", sweep[i].batchSize, sweep[i].imagesPerSecond, (config.backend == 1) ? "CPU" : "GPU", sweep[i].gpuImagesPerSecond);
 	}
 
 	auto timeEnd = std::chrono::system_clock::now();
 	double totTime = std::chrono::duration_cast<std::chrono::microseconds>(timeEnd - timeSubmit).count() * 0.001;
 	printf("Total time: %0.3f s\n", totTime / 1000);
 	glslang_finalize_process();//destroy compiler after use
-	return VK_SUCCESS;
+	return (stats.numValidationFailures > 0) ? 1 : VK_SUCCESS;
 
 }
@@ -0,0 +1,34 @@
+// This file is part of VkResample, a Vulkan real-time FFT resampling tool
+//
+// Copyright (C) 2020 Dmitrii Tolmachev <dtolm96@gmail.com>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#ifndef VKRESAMPLE_CPU_H
+#define VKRESAMPLE_CPU_H
+#include <stdint.h>
+//FFT kernels of the CPU backend. Each SIMD instruction set is compiled in its own object with its own flags and selected at runtime, so the rest of the program runs on any CPU of the architecture
+//kernels only see this plain struct: standard library code is never instantiated with the flags of a kernel, so the linker can not pick it for the rest of the program
+#define CPU_FFT_MAX_RADIX 13
+#define CPU_FFT_MAX_STAGES 32
+typedef struct {
+	uint32_t size;
+	float sign;//-1 - forward, 1 - inverse
+	uint32_t numStages;
+	uint32_t radix[CPU_FFT_MAX_STAGES];//radix of each Stockham stage
+	const float* twiddles[CPU_FFT_MAX_STAGES];//interleaved twiddles of each stage
+	const float* roots[CPU_FFT_MAX_STAGES];//roots of unity of the radix of each stage
+} VkResampleCPUFFTStages;
+typedef struct {
+	const char* name;
+	uint32_t lanes;//transforms computed at once, element e of lane l is stored at [e * lanes + l]
+	void (*fft)(const VkResampleCPUFFTStages* stages, float* re, float* im, float* workRe, float* workIm);//result is returned in re and im
+} VkResampleCPUFFTKernel;
+//SSE2 on x86-64, NEON on ARM, scalar otherwise
+VkResampleCPUFFTKernel getCPUFFTKernelDefault();
+#if defined(VKRESAMPLE_AVX2)
+//AVX2 and FMA, only call on CPUs that support them
+VkResampleCPUFFTKernel getCPUFFTKernelAVX2();
+#endif
+#endif
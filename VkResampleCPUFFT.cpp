@@ -0,0 +1,166 @@
+// This file is part of VkResample, a Vulkan real-time FFT resampling tool
+//
+// Copyright (C) 2020 Dmitrii Tolmachev <dtolm96@gmail.com>
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at https://mozilla.org/MPL/2.0/.
+#include <string.h>
+#if defined(VKRESAMPLE_CPU_FFT_AVX2) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#include "VkResampleCPU.h"
+//Stockham FFT of the CPU backend, vectorized across independent lines: every element of a transform is a vector of cpuVecLanes values of neighbouring rows or columns
+//this file is compiled once with the default flags and, on x86-64, once more with VKRESAMPLE_CPU_FFT_AVX2 and AVX2 and FMA enabled
+#if defined(VKRESAMPLE_CPU_FFT_AVX2)
+typedef __m256 cpuVec;
+static const uint32_t cpuVecLanes = 8;
+static const char* cpuVecName = "AVX2";
+static inline cpuVec cpuVecLoad(const float* p) { return _mm256_loadu_ps(p); }
+static inline void cpuVecStore(float* p, cpuVec a) { _mm256_storeu_ps(p, a); }
+static inline cpuVec cpuVecSet(float a) { return _mm256_set1_ps(a); }
+static inline cpuVec cpuVecAdd(cpuVec a, cpuVec b) { return _mm256_add_ps(a, b); }
+static inline cpuVec cpuVecSub(cpuVec a, cpuVec b) { return _mm256_sub_ps(a, b); }
+static inline cpuVec cpuVecMul(cpuVec a, cpuVec b) { return _mm256_mul_ps(a, b); }
+static inline cpuVec cpuVecFma(cpuVec a, cpuVec b, cpuVec c) { return _mm256_fmadd_ps(a, b, c); }
+static inline cpuVec cpuVecFms(cpuVec a, cpuVec b, cpuVec c) { return _mm256_fmsub_ps(a, b, c); }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef float32x4_t cpuVec;
+static const uint32_t cpuVecLanes = 4;
+static const char* cpuVecName = "NEON";
+static inline cpuVec cpuVecLoad(const float* p) { return vld1q_f32(p); }
+static inline void cpuVecStore(float* p, cpuVec a) { vst1q_f32(p, a); }
+static inline cpuVec cpuVecSet(float a) { return vdupq_n_f32(a); }
+static inline cpuVec cpuVecAdd(cpuVec a, cpuVec b) { return vaddq_f32(a, b); }
+static inline cpuVec cpuVecSub(cpuVec a, cpuVec b) { return vsubq_f32(a, b); }
+static inline cpuVec cpuVecMul(cpuVec a, cpuVec b) { return vmulq_f32(a, b); }
+static inline cpuVec cpuVecFma(cpuVec a, cpuVec b, cpuVec c) { return vmlaq_f32(c, a, b); }
+static inline cpuVec cpuVecFms(cpuVec a, cpuVec b, cpuVec c) { return vsubq_f32(vmulq_f32(a, b), c); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+typedef __m128 cpuVec;
+static const uint32_t cpuVecLanes = 4;
+static const char* cpuVecName = "SSE2";
+static inline cpuVec cpuVecLoad(const float* p) { return _mm_loadu_ps(p); }
+static inline void cpuVecStore(float* p, cpuVec a) { _mm_storeu_ps(p, a); }
+static inline cpuVec cpuVecSet(float a) { return _mm_set1_ps(a); }
+static inline cpuVec cpuVecAdd(cpuVec a, cpuVec b) { return _mm_add_ps(a, b); }
+static inline cpuVec cpuVecSub(cpuVec a, cpuVec b) { return _mm_sub_ps(a, b); }
+static inline cpuVec cpuVecMul(cpuVec a, cpuVec b) { return _mm_mul_ps(a, b); }
+static inline cpuVec cpuVecFma(cpuVec a, cpuVec b, cpuVec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+static inline cpuVec cpuVecFms(cpuVec a, cpuVec b, cpuVec c) { return _mm_sub_ps(_mm_mul_ps(a, b), c); }
+#else
+typedef float cpuVec;
+static const uint32_t cpuVecLanes = 1;
+static const char* cpuVecName = "scalar";
+static inline cpuVec cpuVecLoad(const float* p) { return p[0]; }
+static inline void cpuVecStore(float* p, cpuVec a) { p[0] = a; }
+static inline cpuVec cpuVecSet(float a) { return a; }
+static inline cpuVec cpuVecAdd(cpuVec a, cpuVec b) { return a + b; }
+static inline cpuVec cpuVecSub(cpuVec a, cpuVec b) { return a - b; }
+static inline cpuVec cpuVecMul(cpuVec a, cpuVec b) { return a * b; }
+static inline cpuVec cpuVecFma(cpuVec a, cpuVec b, cpuVec c) { return a * b + c; }
+static inline cpuVec cpuVecFms(cpuVec a, cpuVec b, cpuVec c) { return a * b - c; }
+#endif
+static void cpuFFT(const VkResampleCPUFFTStages* stages, float* re, float* im, float* workRe, float* workIm) {
+	//cpuVecLanes transforms at once, element e of lane l is stored at [e * cpuVecLanes + l]. Result is returned in re and im
+	const uint32_t L = cpuVecLanes;
+	float* srcRe = re;
+	float* srcIm = im;
+	float* dstRe = workRe;
+	float* dstIm = workIm;
+	uint32_t n = stages->size;
+	uint32_t s = 1;
+	for (uint32_t k = 0; k < stages->numStages; k++) {
+		uint32_t p = stages->radix[k];
+		uint32_t m = n / p;
+		const float* twiddles = stages->twiddles[k];
+		const float* roots = stages->roots[k];
+		for (uint32_t j = 0; j < m; j++) {
+			for (uint32_t q = 0; q < s; q++) {
+				cpuVec ar[CPU_FFT_MAX_RADIX];
+				cpuVec ai[CPU_FFT_MAX_RADIX];
+				cpuVec dr[CPU_FFT_MAX_RADIX];
+				cpuVec di[CPU_FFT_MAX_RADIX];
+				for (uint32_t r = 0; r < p; r++) {
+					uint64_t id = ((uint64_t)q + (uint64_t)s * (j + r * m)) * L;
+					ar[r] = cpuVecLoad(srcRe + id);
+					ai[r] = cpuVecLoad(srcIm + id);
+				}
+				if (p == 2) {
+					dr[0] = cpuVecAdd(ar[0], ar[1]);
+					di[0] = cpuVecAdd(ai[0], ai[1]);
+					dr[1] = cpuVecSub(ar[0], ar[1]);
+					di[1] = cpuVecSub(ai[0], ai[1]);
+				}
+				else if (p == 4) {
+					//(a1 - a3) is multiplied by exp(sign * pi / 2 * i) = sign * i
+					cpuVec sign = cpuVecSet(stages->sign);
+					cpuVec t0r = cpuVecAdd(ar[0], ar[2]);
+					cpuVec t0i = cpuVecAdd(ai[0], ai[2]);
+					cpuVec t1r = cpuVecSub(ar[0], ar[2]);
+					cpuVec t1i = cpuVecSub(ai[0], ai[2]);
+					cpuVec t2r = cpuVecAdd(ar[1], ar[3]);
+					cpuVec t2i = cpuVecAdd(ai[1], ai[3]);
+					cpuVec t3r = cpuVecMul(sign, cpuVecSub(ai[3], ai[1]));
+					cpuVec t3i = cpuVecMul(sign, cpuVecSub(ar[1], ar[3]));
+					dr[0] = cpuVecAdd(t0r, t2r);
+					di[0] = cpuVecAdd(t0i, t2i);
+					dr[2] = cpuVecSub(t0r, t2r);
+					di[2] = cpuVecSub(t0i, t2i);
+					dr[1] = cpuVecAdd(t1r, t3r);
+					di[1] = cpuVecAdd(t1i, t3i);
+					dr[3] = cpuVecSub(t1r, t3r);
+					di[3] = cpuVecSub(t1i, t3i);
+				}
+				else {
+					for (uint32_t t = 0; t < p; t++) {
+						dr[t] = ar[0];
+						di[t] = ai[0];
+						for (uint32_t r = 1; r < p; r++) {
+							uint32_t rt = (r * t) % p;
+							cpuVec wr = cpuVecSet(roots[2 * rt]);
+							cpuVec wi = cpuVecSet(roots[2 * rt + 1]);
+							dr[t] = cpuVecAdd(dr[t], cpuVecFms(ar[r], wr, cpuVecMul(ai[r], wi)));
+							di[t] = cpuVecAdd(di[t], cpuVecFma(ar[r], wi, cpuVecMul(ai[r], wr)));
+						}
+					}
+				}
+				for (uint32_t t = 0; t < p; t++) {
+					uint64_t id = ((uint64_t)q + (uint64_t)s * (p * j + t)) * L;
+					if ((t == 0) || (j == 0)) {
+						cpuVecStore(dstRe + id, dr[t]);
+						cpuVecStore(dstIm + id, di[t]);
+					}
+					else {
+						cpuVec wr = cpuVecSet(twiddles[2 * (j * p + t)]);
+						cpuVec wi = cpuVecSet(twiddles[2 * (j * p + t) + 1]);
+						cpuVecStore(dstRe + id, cpuVecFms(dr[t], wr, cpuVecMul(di[t], wi)));
+						cpuVecStore(dstIm + id, cpuVecFma(dr[t], wi, cpuVecMul(di[t], wr)));
+					}
+				}
+			}
+		}
+		float* swapRe = srcRe;
+		float* swapIm = srcIm;
+		srcRe = dstRe;
+		srcIm = dstIm;
+		dstRe = swapRe;
+		dstIm = swapIm;
+		n = m;
+		s *= p;
+	}
+	if (srcRe != re) {
+		memcpy(re, srcRe, (uint64_t)stages->size * L * sizeof(float));
+		memcpy(im, srcIm, (uint64_t)stages->size * L * sizeof(float));
+	}
+}
+#if defined(VKRESAMPLE_CPU_FFT_AVX2)
+VkResampleCPUFFTKernel getCPUFFTKernelAVX2() {
+#else
+VkResampleCPUFFTKernel getCPUFFTKernelDefault() {
+#endif
+	VkResampleCPUFFTKernel kernel = { cpuVecName, cpuVecLanes, cpuFFT };
+	return kernel;
+}
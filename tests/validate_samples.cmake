@@ -0,0 +1,45 @@
+# Upscales every png of SAMPLES with VKRESAMPLE in precision PRECISION on backend BACKEND and compares it with the double precision CPU reference (-validate)
+# Usage: cmake -DVKRESAMPLE=path -DSAMPLES=dir -DOUTPUT=dir -DPRECISION=0|1|2 [-DBACKEND=vulkan|cpu] [-DDEVICE=X] [-DUPSCALE=X] -P validate_samples.cmake
+# Result of every image and the summary of the precision are printed, the test fails if any image is below the threshold of the precision or the run fails
+if (NOT DEFINED BACKEND)
+	set(BACKEND vulkan)
+endif()
+if (NOT DEFINED DEVICE)
+	set(DEVICE 0)
+endif()
+if (NOT DEFINED UPSCALE)
+	set(UPSCALE 2)
+endif()
+
+file(GLOB images "${SAMPLES}/*.png")
+list(SORT images)
+if (NOT images)
+	message(FATAL_ERROR "No png images found in ${SAMPLES}")
+endif()
+file(MAKE_DIRECTORY "${OUTPUT}")
+
+set(failed "")
+set(numImages 0)
+foreach(image ${images})
+	get_filename_component(name "${image}" NAME_WE)
+	set(output "${OUTPUT}/${name}_${BACKEND}_p${PRECISION}.png")
+	execute_process(COMMAND "${VKRESAMPLE}" -i "${image}" -o "${output}" -u ${UPSCALE} -p ${PRECISION} -backend ${BACKEND} -d ${DEVICE} -validate
+		RESULT_VARIABLE result OUTPUT_VARIABLE log ERROR_VARIABLE log)
+	math(EXPR numImages "${numImages} + 1")
+	string(REGEX MATCH "Validation [^\n]*: max abs error [^\n]*" line "${log}")
+	if (line)
+		string(REGEX REPLACE "^Validation [^\n]*: " "" line "${line}")
+		message(STATUS "${BACKEND} p${PRECISION} ${name}: ${line}")
+	else()
+		message(STATUS "${BACKEND} p${PRECISION} ${name}: no validation result, exit code ${result}\n${log}")
+	endif()
+	if (NOT result EQUAL 0)
+		list(APPEND failed ${name})
+	endif()
+endforeach()
+
+list(LENGTH failed numFailed)
+message(STATUS "${BACKEND} p${PRECISION}: ${numFailed} of ${numImages} images failed")
+if (numFailed GREATER 0)
+	message(FATAL_ERROR "Validation failed for: ${failed}")
+endif()
@@ -16,9 +16,73 @@ extern "C" {
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 #include "vulkan/vulkan.h"
 #include "glslang_c_interface.h"
 	//#include "shaderc/shaderc.h"
+	typedef struct {
+		char cacheDir[512];//directory with cached SPIR-V binaries and serialized VkPipelineCache. Empty string - SPIR-V is kept in memory only, nothing is stored
+		uint8_t deviceUUID[VK_UUID_SIZE];//pipelineCacheUUID of the device, part of the cache key
+		uint32_t driverVersion;//driverVersion of the device, part of the cache key
+		VkPipelineCache pipelineCache;//pipeline cache passed to vkCreateComputePipelines
+		uint32_t hits;//number of shaders loaded from cacheDir
+		uint32_t misses;//number of shaders compiled with glslang
+		uint32_t numEntries;//SPIR-V kept in memory, so plans created with the same cache compile each shader only once
+		uint64_t* entryKeys;
+		uint64_t* entryCodeHashes;//VkFFTHashBytes of the GLSL code of each entry, guards against key collisions
+		uint32_t** entryCode;
+		uint32_t* entrySize;
+		uint32_t numWrittenFiles;//makes temporary file names of one cache unique
+	} VkFFTShaderCache;
+	typedef struct {
+		VkDeviceMemory memory;//memory of the block the range was taken from, VK_NULL_HANDLE if nothing is allocated
+		VkDeviceSize offset;//offset of the range in the block, buffers are bound at it
+		VkDeviceSize size;
+		void* data;//mapped pointer to the range if the block is host-visible, 0 otherwise
+		uint32_t block;//index of the block in the allocator
+	} VkFFTMemoryAllocation;
+	typedef struct {
+		VkDeviceMemory memory;//VK_NULL_HANDLE if the slot is unused
+		uint32_t memoryTypeIndex;
+		VkDeviceSize size;
+		void* data;//persistently mapped pointer to the block if its memory type is host-visible
+		VkBool32 dedicated;//block holds one large range and is freed with it
+		uint32_t numRanges;//allocated ranges, sorted by offset
+		uint32_t maxRanges;
+		VkDeviceSize* rangeOffset;
+		VkDeviceSize* rangeSize;
+	} VkFFTMemoryBlock;
+	typedef struct {
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize blockSize;//maximum size of shared blocks, ranges larger than half of it get a dedicated block
+		uint32_t numBlocks;//block slots, some of them may be unused
+		VkFFTMemoryBlock* blocks;
+		uint32_t numDeviceAllocations;//vkAllocateMemory calls over the lifetime of the allocator
+		uint32_t numRanges;//ranges allocated now
+		VkDeviceSize allocatedSize;//memory of all blocks now
+		VkDeviceSize usedSize;//memory of all ranges now, alignment padding excluded
+		VkDeviceSize peakAllocatedSize;
+		VkDeviceSize peakUsedSize;
+	} VkFFTMemoryAllocator;//block sub-allocator: buffers are bound to aligned ranges of a few large blocks, so the number of vkAllocateMemory calls does not grow with the number of buffers. Not thread-safe, calls from multiple threads must be synchronized by the caller
+#define VKFFT_MAX_STAGING_ALLOCATIONS 64
+	typedef struct {
+		VkBuffer buffer;//host-visible and host-coherent buffer, created once
+		VkFFTMemoryAllocation allocation;
+		VkFFTMemoryAllocator* allocator;//allocator the buffer memory was taken from, 0 - the ring has its own allocation
+		void* data;//persistently mapped pointer to the buffer
+		VkDeviceSize size;
+		VkDeviceSize alignment;//alignment of allocation offsets
+		VkDeviceSize head;//end of the newest allocation
+		uint32_t first;//index of the oldest allocation in the circular list below
+		uint32_t numAllocations;//allocations that can still be used by the GPU
+		VkDeviceSize allocationOffset[VKFFT_MAX_STAGING_ALLOCATIONS];
+		VkBool32 allocationReleased[VKFFT_MAX_STAGING_ALLOCATIONS];
+	} VkFFTStagingRing;//staging ring allocator. Not thread-safe, calls from multiple threads must be synchronized by the caller
 	typedef struct {
 		//WHDCN layout
 		uint32_t size[3]; // WHD -system dimensions 
@@ -91,9 +155,16 @@ extern "C" {
 		uint32_t isCompilerInitialized;
 
 		uint32_t halfThreads;
+		VkFFTShaderCache* shaderCache;//optional shader cache, initialized with VkFFTInitShaderCache. Default 0 - shaders are always compiled with glslang
+		VkFFTStagingRing* stagingRing;//optional staging ring, initialized with VkFFTInitStagingRing. Default 0 - a staging buffer is allocated for each upload
+		double outputScale;//write-side callback of the last inverse FFT kernel: multiply result by this value before it is written. Default 0 - disabled
+		VkBool32 outputClamp;//write-side callback of the last inverse FFT kernel: write magnitude of the result clamped to [0,1] (complex results are written as (magnitude, 0)). Default 0 - disabled
+		VkBool32 splitSpectrum;//inverse FFT with frequencyZeroPadding reads the spectrum without the zero gap: elements past fft_zeropad_right are stored starting at fft_zeropad_left, as the smaller forward FFT left them. Only for 2D transforms with one upload along axis 1, otherwise initializeVulkanFFT returns VK_ERROR_FEATURE_NOT_PRESENT. Default 0 - off
+		VkBool32 cropSpectrum;//inverse FFT of size smaller than bufferStride reads the retained band of the larger spectrum in place, as the forward FFT left it: elements from size / 2 on are read bufferStride - size elements further and R2C Nyquist column is read from column size[0] / 2. Only for 2D transforms with one upload along axis 1, otherwise initializeVulkanFFT returns VK_ERROR_FEATURE_NOT_PRESENT. Default 0 - off
+		VkFFTMemoryAllocator* memoryAllocator;//optional block sub-allocator, initialized with VkFFTInitMemoryAllocator. LUT and staging buffers are bound to its ranges. Default 0 - each buffer has its own allocation
 	} VkFFTConfiguration;
 
-	static VkFFTConfiguration defaultVkFFTConfiguration = { {1,1,1}, {1,1,1}, {1,1,1}, {1,1,1}, {65535,65535,65535},{1024,1024,64}, 1,1,1,1,1,8,0,{0,0,0},{0,0,0},{0,0,0}, {0,0},0,0,0,0,0,0,0,0,0, 0, 0, 0, 0, 32768, 32768, 32, 1, 1, 0, 1,"shaders/", 32, 0,0,0,0,0, 1,1,1,1,1, 0,0,0,0,0, 0,0,0,0,0,0, 0 };
+	static VkFFTConfiguration defaultVkFFTConfiguration = { {1,1,1}, {1,1,1}, {1,1,1}, {1,1,1}, {65535,65535,65535},{1024,1024,64}, 1,1,1,1,1,8,0,{0,0,0},{0,0,0},{0,0,0}, {0,0},0,0,0,0,0,0,0,0,0, 0, 0, 0, 0, 32768, 32768, 32, 1, 1, 0, 1,"shaders/", 32, 0,0,0,0,0, 1,1,1,1,1, 0,0,0,0,0, 0,0,0,0,0,0, 0, 0 };
 
 	typedef struct {
 		uint32_t size[3];
@@ -144,6 +215,13 @@ extern "C" {
 		uint32_t sharedMemSize;
 		uint32_t sharedMemSizePow2;
 		uint32_t normalize;
+		uint32_t outputCallback;
+		double outputScale;
+		uint32_t outputClamp;
+		uint32_t splitSpectrum;
+		uint32_t cropSpectrum;
+		uint32_t cropShift[3];
+		uint32_t cropNyquistStride;
 		uint32_t complexSize;
 		uint32_t maxStageSumLUT;
 		uint32_t unroll;
@@ -179,7 +257,7 @@ extern "C" {
 		VkPipeline pipeline;
 		VkDeviceSize bufferLUTSize;
 		VkBuffer bufferLUT;
-		VkDeviceMemory bufferLUTDeviceMemory;
+		VkFFTMemoryAllocation bufferLUTAllocation;
 	} VkFFTAxis;
 	typedef struct {
 		uint32_t transposeBlock[3];
@@ -205,8 +283,10 @@ extern "C" {
 		VkFFTConfiguration configuration;
 		VkFFTPlan localFFTPlan;
 		VkFFTPlan localFFTPlan_inverse_convolution; //additional inverse plan for convolution.
+		VkQueryPool timestampQueryPool;//set by VkFFTAppendTimestamps for the duration of one append
+		uint32_t* timestampQuery;
 	} VkFFTApplication;
-	static VkFFTApplication defaultVkFFTApplication = { {}, {}, {} };
+	static VkFFTApplication defaultVkFFTApplication = { {}, {}, {}, 0, 0 };
 
 	static inline void appendLicense(char* output) {
 		sprintf(output + strlen(output), "\
@@ -370,11 +450,18 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			char inputOffset[30] = "";
 			if (sc.inputOffset > 0)
 				sprintf(inputOffset, "%d + ", sc.inputOffset);
-			char shiftX[100] = "";
-			if (sc.inputStride[0] == 1)
-				sprintf(shiftX, "index");
+			char index[100] = "index";
+			if (sc.splitSpectrum)//upper part of the spectrum is stored right after the lower part
+				sprintf(index, "(index - ((index %% %d >= %d) ? %d : 0))", sc.fft_dim_full, sc.fft_zeropad_right_read[sc.axis_id], sc.fft_zeropad_right_read[sc.axis_id] - sc.fft_zeropad_left_read[sc.axis_id]);
+			if (sc.cropSpectrum)//upper part of the retained band is stored at the end of the larger spectrum
+				sprintf(index, "(index + ((index %% %d >= %d) ? %d : 0))", sc.fft_dim_full, sc.fft_dim_full / 2, sc.cropShift[sc.axis_id]);
+			char shiftX[150] = "";
+			if (sc.cropNyquistStride)//R2C Nyquist column of the retained band is a column of the larger spectrum
+				sprintf(shiftX, "%s * %d", index, sc.cropNyquistStride);
+			else if (sc.inputStride[0] == 1)
+				sprintf(shiftX, "%s", index);
 			else
-				sprintf(shiftX, "index * %d", sc.inputStride[0]);
+				sprintf(shiftX, "%s * %d", index, sc.inputStride[0]);
 			char shiftY[100] = "";
 			if (sc.size[1] > 1) {
 				if (sc.fftDim == sc.fft_dim_full) {
@@ -426,14 +513,28 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			char inputOffset[30] = "";
 			if (sc.inputOffset > 0)
 				sprintf(inputOffset, "%d + ", sc.inputOffset);
-			char shiftX[100] = "";
+			char index_x[100] = "index_x";
+			char index_y[100] = "index_y";
+			if (sc.splitSpectrum) {
+				//upper part of the spectrum is stored right after the lower part. Axis 0 is not transformed yet, so its gap is also removed here
+				if ((sc.performZeropaddingFull[0]) && (sc.fft_zeropad_right_full[0] < sc.fft_dim_x))
+					sprintf(index_x, "(index_x - ((index_x >= %d) ? %d : 0))", sc.fft_zeropad_right_full[0], sc.fft_zeropad_right_full[0] - sc.fft_zeropad_left_full[0]);
+				sprintf(index_y, "(index_y - ((index_y %% %d >= %d) ? %d : 0))", sc.fft_dim_full, sc.fft_zeropad_right_read[sc.axis_id], sc.fft_zeropad_right_read[sc.axis_id] - sc.fft_zeropad_left_read[sc.axis_id]);
+			}
+			if (sc.cropSpectrum) {
+				//upper part of the retained band is stored at the end of the larger spectrum. Axis 0 is not transformed yet, so it is cropped here too
+				if (sc.cropShift[0] > 0)
+					sprintf(index_x, "(index_x + ((index_x >= %d) ? %d : 0))", sc.size[0] / 2, sc.cropShift[0]);
+				sprintf(index_y, "(index_y + ((index_y %% %d >= %d) ? %d : 0))", sc.fft_dim_full, sc.fft_dim_full / 2, sc.cropShift[sc.axis_id]);
+			}
+			char shiftX[150] = "";
 			if (sc.inputStride[0] == 1)
-				sprintf(shiftX, "index_x");
+				sprintf(shiftX, "%s", index_x);
 			else
-				sprintf(shiftX, "index_x * %d", sc.inputStride[0]);
+				sprintf(shiftX, "%s * %d", index_x, sc.inputStride[0]);
 
-			char shiftY[100] = "";
-			sprintf(shiftY, " + index_y * %d", sc.inputStride[1]);
+			char shiftY[150] = "";
+			sprintf(shiftY, " + %s * %d", index_y, sc.inputStride[1]);
 
 			char shiftZ[100] = "";
 			if (sc.size[2] > 1) {
@@ -2106,7 +2207,11 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		sdata[sharedStride * gl_LocalInvocationID.y + %d - gl_LocalInvocationID.x].y = (-temp_0.y + temp_1.x);\n", i * sc.localSize[0] + 1, i * sc.localSize[0] + 1, sc.fftDim - i * sc.localSize[0] - 1, sc.fftDim - i * sc.localSize[0] - 1);
 						if ((ceil(sc.min_registers_per_thread / 2.0) != sc.min_registers_per_thread / 2) && (i == (ceil(sc.min_registers_per_thread / 2.0) - 1)))
 							sprintf(output + strlen(output), "}\n");
+						if ((uint32_t)ceil(sc.size[1] / 2.0) % sc.localSize[1] != 0)
+							sprintf(output + strlen(output), "		}");
 					}
+					if ((uint32_t)ceil(sc.size[1] / 2.0) % sc.localSize[1] != 0)
+						sprintf(output + strlen(output), "		if(gl_GlobalInvocationID.y%s < %d){", shiftY, (uint32_t)ceil(sc.size[1] / 2.0));
 					sprintf(output + strlen(output), "\
 	if (gl_LocalInvocationID.x==0) \n\
 	{\n");
@@ -2167,7 +2272,11 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		sdata[sharedStride * gl_LocalInvocationID.y + %d - gl_LocalInvocationID.x].y = (-temp_0.y + temp_1.x);\n", i * sc.localSize[0] + 1, i * sc.localSize[0] + 1, sc.fftDim - i * sc.localSize[0] - 1, sc.fftDim - i * sc.localSize[0] - 1);
 						if ((ceil(sc.min_registers_per_thread / 2.0) != sc.min_registers_per_thread / 2) && (i == (ceil(sc.min_registers_per_thread / 2.0) - 1)))
 							sprintf(output + strlen(output), "}\n");
+						if ((uint32_t)ceil(sc.size[1] / 2.0) % sc.localSize[1] != 0)
+							sprintf(output + strlen(output), "		}");
 					}
+					if ((uint32_t)ceil(sc.size[1] / 2.0) % sc.localSize[1] != 0)
+						sprintf(output + strlen(output), "		if(gl_GlobalInvocationID.y%s < %d){", shiftY, (uint32_t)ceil(sc.size[1] / 2.0));
 					sprintf(output + strlen(output), "\
 	if (gl_LocalInvocationID.x==0) \n\
 	{\n");
@@ -3515,11 +3624,38 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		}
 		sprintf(output + strlen(output), sc.disableThreadsEnd);
 	}
+	static inline void appendOutputCallbackVkFFT(char* output, VkFFTSpecializationConstantsLayout sc, const char* floatType) {
+		//write-side callback, applied to the result of the last inverse FFT kernel. Overloaded for real (C2R) and complex outputs
+		char vecType[10];
+		if (!strcmp(floatType, "float")) sprintf(vecType, "vec2");
+		if (!strcmp(floatType, "double")) sprintf(vecType, "dvec2");
+		char scale[50] = "";
+		if (sc.outputScale != 0)
+			sprintf(scale, " * %.17f%s", sc.outputScale, (!strcmp(floatType, "double")) ? "LF" : "");
+		if (sc.outputClamp) {
+			sprintf(output + strlen(output), "\
+%s outputCallback(%s x) {\n\
+	return clamp(abs(x%s), 0.0, 1.0);\n\
+}\n\
+%s outputCallback(%s x) {\n\
+	return %s(clamp(length(x%s), 0.0, 1.0), 0.0);\n\
+}\n", floatType, floatType, scale, vecType, vecType, vecType, scale);
+		}
+		else {
+			sprintf(output + strlen(output), "\
+%s outputCallback(%s x) {\n\
+	return x%s;\n\
+}\n\
+%s outputCallback(%s x) {\n\
+	return x%s;\n\
+}\n", floatType, floatType, scale, vecType, vecType, scale);
+		}
+	}
 	static inline void appendWriteDataVkFFT(char* output, VkFFTSpecializationConstantsLayout sc, const char* floatType, const char* floatTypeMemory, const char* uintType, uint32_t writeType) {
 		char vecType[10];
 		if (!strcmp(floatType, "float")) sprintf(vecType, "vec2");
 		if (!strcmp(floatType, "double")) sprintf(vecType, "dvec2");
-		char convTypeLeft[20] = "";
+		char convTypeLeft[60] = "";
 		char convTypeRight[20] = "";
 		if ((!strcmp(floatTypeMemory, "half")) && (strcmp(floatType, "half"))) {
 			if (writeType == 6) {
@@ -3551,6 +3687,11 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 				sprintf(convTypeRight, ")");
 			}
 		}
+		if (sc.outputCallback) {
+			//all written values pass through the callback, declared by appendOutputCallbackVkFFT
+			sprintf(convTypeLeft + strlen(convTypeLeft), "outputCallback(");
+			sprintf(convTypeRight, "%s", (strlen(convTypeRight) > 0) ? "))" : ")");
+		}
 		char requestCoordinate[100] = "";
 		if (sc.convolutionStep) {
 			if (sc.matrixConvolution > 1) {
@@ -4528,6 +4669,8 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			}
 		}*/
 		appendSharedMemoryVkFFT(output, sc, floatType, uintType, type);
+		if (sc.outputCallback)
+			appendOutputCallbackVkFFT(output, sc, floatType);
 		sprintf(output + strlen(output), "void main() {\n");
 		//if (type==0) sprintf(output + strlen(output), "return;\n");
 		appendInitialization(output, sc, floatType, uintType, type);
@@ -4641,18 +4784,221 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		//printf("%s", output);
 	}
 
-	static inline uint32_t findMemoryType(VkFFTApplication* app, uint32_t memoryTypeBits, uint32_t memorySize, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memoryProperties = { 0 };
-
-		vkGetPhysicalDeviceMemoryProperties(app->configuration.physicalDevice[0], &memoryProperties);
-
-		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
-			if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) && (memoryProperties.memoryHeaps[memoryProperties.memoryTypes[i].heapIndex].size >= memorySize))
-				return i;
+	static inline VkResult VkFFTFindMemoryType(const VkPhysicalDeviceMemoryProperties* memoryProperties, uint32_t memoryTypeBits, VkDeviceSize memorySize, VkMemoryPropertyFlags properties, uint32_t* memoryTypeIndex) {
+		//first memory type allowed by memoryTypeBits that has all property flags. Vulkan orders memory types so that the first match is the best one
+		for (uint32_t i = 0; i < memoryProperties->memoryTypeCount; ++i) {
+			if ((memoryTypeBits & (1 << i)) && ((memoryProperties->memoryTypes[i].propertyFlags & properties) == properties) && (memoryProperties->memoryHeaps[memoryProperties->memoryTypes[i].heapIndex].size >= memorySize)) {
+				memoryTypeIndex[0] = i;
+				return VK_SUCCESS;
+			}
+		}
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+	static inline VkResult VkFFTInitMemoryAllocator(VkFFTMemoryAllocator* allocator, VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize blockSize) {
+		//blocks are allocated on demand. First blocks of a memory type are blockSize / 8 bytes and each next one is twice as large up to blockSize, so small workloads do not reserve whole blocks. Empty shared blocks are kept until the allocator is destroyed, so buffers created and destroyed repeatedly reuse them
+		memset(allocator, 0, sizeof(VkFFTMemoryAllocator));
+		allocator->device = device;
+		allocator->blockSize = blockSize;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &allocator->memoryProperties);
+		return VK_SUCCESS;
+	}
+	static inline VkResult VkFFTMemoryBlockFit(const VkFFTMemoryBlock* block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset, uint32_t* position) {
+		//first fit: the lowest aligned offset in a gap between the allocated ranges. position is the index the new range takes in the sorted list
+		VkDeviceSize start = 0;
+		for (uint32_t i = 0; i <= block->numRanges; i++) {
+			VkDeviceSize alignedStart = ((start + alignment - 1) / alignment) * alignment;
+			VkDeviceSize end = (i < block->numRanges) ? block->rangeOffset[i] : block->size;
+			if (alignedStart + size <= end) {
+				offset[0] = alignedStart;
+				position[0] = i;
+				return VK_SUCCESS;
+			}
+			if (i < block->numRanges) start = block->rangeOffset[i] + block->rangeSize[i];
+		}
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+	static inline VkDeviceSize VkFFTMemoryBlockLargestFree(const VkFFTMemoryBlock* block) {
+		//largest gap between the allocated ranges, alignment not taken into account
+		VkDeviceSize largest = 0;
+		VkDeviceSize start = 0;
+		for (uint32_t i = 0; i <= block->numRanges; i++) {
+			VkDeviceSize end = (i < block->numRanges) ? block->rangeOffset[i] : block->size;
+			if (end - start > largest) largest = end - start;
+			if (i < block->numRanges) start = block->rangeOffset[i] + block->rangeSize[i];
+		}
+		return largest;
+	}
+	static inline VkResult VkFFTAllocatorAllocate(VkFFTMemoryAllocator* allocator, const VkMemoryRequirements* memoryRequirements, VkMemoryPropertyFlags properties, VkFFTMemoryAllocation* allocation) {
+		//take an aligned range of a block of the memory type selected by properties, a new block is allocated if no block has space
+		VkDeviceSize size = memoryRequirements->size;
+		VkDeviceSize alignment = (memoryRequirements->alignment) ? memoryRequirements->alignment : 1;
+		VkBool32 dedicated = (size > allocator->blockSize / 2) ? 1 : 0;
+		uint32_t memoryTypeIndex = 0;
+		VkResult res = VkFFTFindMemoryType(&allocator->memoryProperties, memoryRequirements->memoryTypeBits, size, properties, &memoryTypeIndex);
+		if (res != VK_SUCCESS) return res;
+		uint32_t blockId = allocator->numBlocks;
+		VkDeviceSize offset = 0;
+		uint32_t position = 0;
+		if (!dedicated) {
+			for (uint32_t i = 0; i < allocator->numBlocks; i++) {
+				VkFFTMemoryBlock* block = &allocator->blocks[i];
+				if ((block->memory) && (!block->dedicated) && (block->memoryTypeIndex == memoryTypeIndex) && (VkFFTMemoryBlockFit(block, size, alignment, &offset, &position) == VK_SUCCESS)) {
+					blockId = i;
+					break;
+				}
+			}
+		}
+		if (blockId == allocator->numBlocks) {
+			for (uint32_t i = 0; i < allocator->numBlocks; i++) {
+				if (!allocator->blocks[i].memory) {
+					blockId = i;
+					break;
+				}
+			}
+			if (blockId == allocator->numBlocks) {
+				VkFFTMemoryBlock* blocks = (VkFFTMemoryBlock*)realloc(allocator->blocks, (allocator->numBlocks + 1) * sizeof(VkFFTMemoryBlock));
+				if (!blocks) return VK_ERROR_OUT_OF_HOST_MEMORY;
+				allocator->blocks = blocks;
+				memset(&allocator->blocks[blockId], 0, sizeof(VkFFTMemoryBlock));
+				allocator->numBlocks++;
+			}
+			VkDeviceSize newBlockSize = allocator->blockSize / 8;
+			for (uint32_t i = 0; i < allocator->numBlocks; i++) {
+				if ((allocator->blocks[i].memory) && (!allocator->blocks[i].dedicated) && (allocator->blocks[i].memoryTypeIndex == memoryTypeIndex) && (newBlockSize < allocator->blockSize)) newBlockSize *= 2;
+			}
+			while (newBlockSize < size) newBlockSize *= 2;
+			VkFFTMemoryBlock* block = &allocator->blocks[blockId];
+			VkMemoryAllocateInfo memoryAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+			memoryAllocateInfo.allocationSize = (dedicated) ? size : newBlockSize;
+			memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+			res = vkAllocateMemory(allocator->device, &memoryAllocateInfo, NULL, &block->memory);
+			if ((res != VK_SUCCESS) && (!dedicated)) {
+				//heap can not fit a whole block, allocate only the range
+				dedicated = 1;
+				memoryAllocateInfo.allocationSize = size;
+				res = vkAllocateMemory(allocator->device, &memoryAllocateInfo, NULL, &block->memory);
+			}
+			if (res != VK_SUCCESS) {
+				block->memory = VK_NULL_HANDLE;
+				return res;
+			}
+			block->memoryTypeIndex = memoryTypeIndex;
+			block->size = memoryAllocateInfo.allocationSize;
+			block->dedicated = dedicated;
+			block->data = 0;
+			if (allocator->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+				//a block is mapped once, ranges are written through pointers into it
+				res = vkMapMemory(allocator->device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->data);
+				if (res != VK_SUCCESS) {
+					vkFreeMemory(allocator->device, block->memory, NULL);
+					block->memory = VK_NULL_HANDLE;
+					return res;
+				}
+			}
+			allocator->numDeviceAllocations++;
+			allocator->allocatedSize += block->size;
+			if (allocator->allocatedSize > allocator->peakAllocatedSize) allocator->peakAllocatedSize = allocator->allocatedSize;
+			offset = 0;
+			position = 0;
+		}
+		VkFFTMemoryBlock* block = &allocator->blocks[blockId];
+		if (block->numRanges == block->maxRanges) {
+			uint32_t maxRanges = (block->maxRanges) ? 2 * block->maxRanges : 16;
+			VkDeviceSize* rangeOffset = (VkDeviceSize*)realloc(block->rangeOffset, maxRanges * sizeof(VkDeviceSize));
+			if (!rangeOffset) return VK_ERROR_OUT_OF_HOST_MEMORY;
+			block->rangeOffset = rangeOffset;
+			VkDeviceSize* rangeSize = (VkDeviceSize*)realloc(block->rangeSize, maxRanges * sizeof(VkDeviceSize));
+			if (!rangeSize) return VK_ERROR_OUT_OF_HOST_MEMORY;
+			block->rangeSize = rangeSize;
+			block->maxRanges = maxRanges;
+		}
+		memmove(block->rangeOffset + position + 1, block->rangeOffset + position, (block->numRanges - position) * sizeof(VkDeviceSize));
+		memmove(block->rangeSize + position + 1, block->rangeSize + position, (block->numRanges - position) * sizeof(VkDeviceSize));
+		block->rangeOffset[position] = offset;
+		block->rangeSize[position] = size;
+		block->numRanges++;
+		allocator->numRanges++;
+		allocator->usedSize += size;
+		if (allocator->usedSize > allocator->peakUsedSize) allocator->peakUsedSize = allocator->usedSize;
+		allocation->memory = block->memory;
+		allocation->offset = offset;
+		allocation->size = size;
+		allocation->data = (block->data) ? (char*)block->data + offset : 0;
+		allocation->block = blockId;
+		return VK_SUCCESS;
+	}
+	static inline void VkFFTAllocatorFree(VkFFTMemoryAllocator* allocator, VkFFTMemoryAllocation* allocation) {
+		//return the range to its block. Dedicated blocks are freed with their range
+		if (!allocation->memory) return;
+		VkFFTMemoryBlock* block = &allocator->blocks[allocation->block];
+		for (uint32_t i = 0; i < block->numRanges; i++) {
+			if (block->rangeOffset[i] == allocation->offset) {
+				memmove(block->rangeOffset + i, block->rangeOffset + i + 1, (block->numRanges - i - 1) * sizeof(VkDeviceSize));
+				memmove(block->rangeSize + i, block->rangeSize + i + 1, (block->numRanges - i - 1) * sizeof(VkDeviceSize));
+				block->numRanges--;
+				allocator->numRanges--;
+				allocator->usedSize -= allocation->size;
+				break;
+			}
+		}
+		if ((block->dedicated) && (block->numRanges == 0)) {
+			if (block->data) vkUnmapMemory(allocator->device, block->memory);
+			vkFreeMemory(allocator->device, block->memory, NULL);
+			allocator->allocatedSize -= block->size;
+			block->memory = VK_NULL_HANDLE;
+			block->data = 0;
+		}
+		memset(allocation, 0, sizeof(VkFFTMemoryAllocation));
+	}
+	static inline VkResult VkFFTAllocatorCreateBuffer(VkFFTMemoryAllocator* allocator, VkBuffer* buffer, VkFFTMemoryAllocation* allocation, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceSize size, uint32_t queueFamilyIndexCount, const uint32_t* queueFamilyIndices) {
+		//create a buffer and bind it to a range of the allocator. Buffers used by more than one queue family are shared concurrently. On failure the buffer and the range are released
+		VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bufferCreateInfo.sharingMode = (queueFamilyIndexCount > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bufferCreateInfo.queueFamilyIndexCount = (queueFamilyIndexCount > 1) ? queueFamilyIndexCount : 0;
+		bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		bufferCreateInfo.size = size;
+		bufferCreateInfo.usage = usageFlags;
+		VkResult res = vkCreateBuffer(allocator->device, &bufferCreateInfo, NULL, buffer);
+		if (res != VK_SUCCESS) return res;
+		VkMemoryRequirements memoryRequirements = { 0 };
+		vkGetBufferMemoryRequirements(allocator->device, buffer[0], &memoryRequirements);
+		res = VkFFTAllocatorAllocate(allocator, &memoryRequirements, propertyFlags, allocation);
+		if (res != VK_SUCCESS) {
+			vkDestroyBuffer(allocator->device, buffer[0], NULL);
+			buffer[0] = VK_NULL_HANDLE;
+			return res;
+		}
+		res = vkBindBufferMemory(allocator->device, buffer[0], allocation->memory, allocation->offset);
+		if (res != VK_SUCCESS) {
+			vkDestroyBuffer(allocator->device, buffer[0], NULL);
+			buffer[0] = VK_NULL_HANDLE;
+			VkFFTAllocatorFree(allocator, allocation);
 		}
-		return -1;
+		return res;
+	}
+	static inline void VkFFTAllocatorDestroyBuffer(VkFFTMemoryAllocator* allocator, VkBuffer* buffer, VkFFTMemoryAllocation* allocation) {
+		vkDestroyBuffer(allocator->device, buffer[0], NULL);
+		buffer[0] = VK_NULL_HANDLE;
+		VkFFTAllocatorFree(allocator, allocation);
+	}
+	static inline void VkFFTDestroyMemoryAllocator(VkFFTMemoryAllocator* allocator) {
+		for (uint32_t i = 0; i < allocator->numBlocks; i++) {
+			VkFFTMemoryBlock* block = &allocator->blocks[i];
+			if (block->memory) {
+				if (block->data) vkUnmapMemory(allocator->device, block->memory);
+				vkFreeMemory(allocator->device, block->memory, NULL);
+			}
+			free(block->rangeOffset);
+			free(block->rangeSize);
+		}
+		free(allocator->blocks);
+		memset(allocator, 0, sizeof(VkFFTMemoryAllocator));
 	}
-	static inline void allocateFFTBuffer(VkFFTApplication* app, VkBuffer* buffer, VkDeviceMemory* deviceMemory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceSize size) {
+	static inline VkResult allocateFFTBuffer(VkFFTApplication* app, VkBuffer* buffer, VkFFTMemoryAllocation* allocation, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags propertyFlags, VkDeviceSize size) {
+		//on failure the buffer and its memory are released and set to VK_NULL_HANDLE
+		if (app->configuration.memoryAllocator) {
+			return VkFFTAllocatorCreateBuffer(app->configuration.memoryAllocator, buffer, allocation, usageFlags, propertyFlags, size, 0, 0);
+		}
 		uint32_t queueFamilyIndices;
 		VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
 		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -4660,25 +5006,160 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		bufferCreateInfo.pQueueFamilyIndices = &queueFamilyIndices;
 		bufferCreateInfo.size = size;
 		bufferCreateInfo.usage = usageFlags;
-		vkCreateBuffer(app->configuration.device[0], &bufferCreateInfo, NULL, buffer);
+		memset(allocation, 0, sizeof(VkFFTMemoryAllocation));
+		VkResult res = vkCreateBuffer(app->configuration.device[0], &bufferCreateInfo, NULL, buffer);
+		if (res != VK_SUCCESS) {
+			buffer[0] = VK_NULL_HANDLE;
+			return res;
+		}
 		VkMemoryRequirements memoryRequirements = { 0 };
 		vkGetBufferMemoryRequirements(app->configuration.device[0], buffer[0], &memoryRequirements);
+		VkPhysicalDeviceMemoryProperties memoryProperties = { 0 };
+		vkGetPhysicalDeviceMemoryProperties(app->configuration.physicalDevice[0], &memoryProperties);
+		VkMemoryAllocateInfo memoryAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+		memoryAllocateInfo.allocationSize = memoryRequirements.size;
+		res = VkFFTFindMemoryType(&memoryProperties, memoryRequirements.memoryTypeBits, memoryRequirements.size, propertyFlags, &memoryAllocateInfo.memoryTypeIndex);
+		if (res == VK_SUCCESS) res = vkAllocateMemory(app->configuration.device[0], &memoryAllocateInfo, NULL, &allocation->memory);
+		if (res == VK_SUCCESS) {
+			allocation->size = memoryRequirements.size;
+			res = vkBindBufferMemory(app->configuration.device[0], buffer[0], allocation->memory, 0);
+		}
+		if (res != VK_SUCCESS) {
+			vkDestroyBuffer(app->configuration.device[0], buffer[0], NULL);
+			buffer[0] = VK_NULL_HANDLE;
+			if (allocation->memory) vkFreeMemory(app->configuration.device[0], allocation->memory, NULL);
+			memset(allocation, 0, sizeof(VkFFTMemoryAllocation));
+		}
+		return res;
+	}
+	static inline void deleteFFTBuffer(VkFFTApplication* app, VkBuffer* buffer, VkFFTMemoryAllocation* allocation) {
+		if (app->configuration.memoryAllocator) {
+			VkFFTAllocatorDestroyBuffer(app->configuration.memoryAllocator, buffer, allocation);
+			return;
+		}
+		vkDestroyBuffer(app->configuration.device[0], buffer[0], NULL);
+		vkFreeMemory(app->configuration.device[0], allocation->memory, NULL);
+	}
+	static inline VkResult VkFFTInitStagingRing(VkFFTStagingRing* ring, VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, uint32_t queueFamilyIndexCount, const uint32_t* queueFamilyIndices, VkFFTMemoryAllocator* allocator) {
+		//create one persistently mapped host-visible buffer, that is sub-allocated for all uploads and readbacks. With allocator it is bound to a range of a host-visible block
+		//if it is used by more than one queue family (like compute and transfer-only ones), it is shared concurrently, so copies of any family can use it without ownership transfers
+		memset(ring, 0, sizeof(VkFFTStagingRing));
+		ring->alignment = 256;
+		ring->size = ((size + ring->alignment - 1) / ring->alignment) * ring->alignment;
+		VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		if (allocator) {
+			ring->allocator = allocator;
+			VkResult res = VkFFTAllocatorCreateBuffer(allocator, &ring->buffer, &ring->allocation, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, ring->size, queueFamilyIndexCount, queueFamilyIndices);
+			ring->data = ring->allocation.data;
+			return res;
+		}
+		VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		bufferCreateInfo.sharingMode = (queueFamilyIndexCount > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		bufferCreateInfo.queueFamilyIndexCount = (queueFamilyIndexCount > 1) ? queueFamilyIndexCount : 0;
+		bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
+		bufferCreateInfo.size = ring->size;
+		bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		VkResult res = vkCreateBuffer(device, &bufferCreateInfo, NULL, &ring->buffer);
+		if (res != VK_SUCCESS) return res;
+		VkMemoryRequirements memoryRequirements = { 0 };
+		vkGetBufferMemoryRequirements(device, ring->buffer, &memoryRequirements);
+		VkPhysicalDeviceMemoryProperties memoryProperties = { 0 };
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 		VkMemoryAllocateInfo memoryAllocateInfo = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
 		memoryAllocateInfo.allocationSize = memoryRequirements.size;
-		memoryAllocateInfo.memoryTypeIndex = findMemoryType(app, memoryRequirements.memoryTypeBits, memoryRequirements.size, propertyFlags);
-		vkAllocateMemory(app->configuration.device[0], &memoryAllocateInfo, NULL, deviceMemory);
-		vkBindBufferMemory(app->configuration.device[0], buffer[0], deviceMemory[0], 0);
+		res = VkFFTFindMemoryType(&memoryProperties, memoryRequirements.memoryTypeBits, 0, properties, &memoryAllocateInfo.memoryTypeIndex);
+		if (res != VK_SUCCESS) return VK_ERROR_OUT_OF_HOST_MEMORY;
+		res = vkAllocateMemory(device, &memoryAllocateInfo, NULL, &ring->allocation.memory);
+		if (res != VK_SUCCESS) return res;
+		ring->allocation.size = memoryRequirements.size;
+		res = vkBindBufferMemory(device, ring->buffer, ring->allocation.memory, 0);
+		if (res != VK_SUCCESS) return res;
+		res = vkMapMemory(device, ring->allocation.memory, 0, ring->size, 0, &ring->data);
+		return res;
 	}
-	static inline void transferDataFromCPU(VkFFTApplication* app, void* arr, VkBuffer* buffer, VkDeviceSize bufferSize) {
+	static inline void VkFFTDestroyStagingRing(VkFFTStagingRing* ring, VkDevice device) {
+		if (ring->allocator) {
+			VkFFTAllocatorDestroyBuffer(ring->allocator, &ring->buffer, &ring->allocation);
+		}
+		else {
+			if (ring->data) vkUnmapMemory(device, ring->allocation.memory);
+			vkDestroyBuffer(device, ring->buffer, NULL);
+			vkFreeMemory(device, ring->allocation.memory, NULL);
+		}
+		memset(ring, 0, sizeof(VkFFTStagingRing));
+	}
+	static inline VkResult VkFFTStagingRingAllocate(VkFFTStagingRing* ring, VkDeviceSize size, VkDeviceSize* offset) {
+		//allocate size bytes after the newest allocation, wrapping to the start of the ring. Returns VK_NOT_READY if the space is still used by the GPU
+		size = ((size + ring->alignment - 1) / ring->alignment) * ring->alignment;
+		if ((size == 0) || (size > ring->size)) return VK_ERROR_OUT_OF_HOST_MEMORY;
+		if (ring->numAllocations == VKFFT_MAX_STAGING_ALLOCATIONS) return VK_NOT_READY;
+		VkDeviceSize newOffset = 0;
+		if (ring->numAllocations > 0) {
+			VkDeviceSize oldest = ring->allocationOffset[ring->first];
+			if (ring->head > oldest) {
+				if (ring->head + size <= ring->size)
+					newOffset = ring->head;
+				else if (size <= oldest)
+					newOffset = 0;
+				else
+					return VK_NOT_READY;
+			}
+			else {
+				if (ring->head + size <= oldest)
+					newOffset = ring->head;
+				else
+					return VK_NOT_READY;
+			}
+		}
+		uint32_t id = (ring->first + ring->numAllocations) % VKFFT_MAX_STAGING_ALLOCATIONS;
+		ring->allocationOffset[id] = newOffset;
+		ring->allocationReleased[id] = 0;
+		ring->numAllocations++;
+		ring->head = newOffset + size;
+		offset[0] = newOffset;
+		return VK_SUCCESS;
+	}
+	static inline void VkFFTStagingRingRelease(VkFFTStagingRing* ring, VkDeviceSize offset) {
+		//release an allocation after the fence of the submit that used it has signaled. Space is reused once all older allocations are released too
+		for (uint32_t i = 0; i < ring->numAllocations; i++) {
+			uint32_t id = (ring->first + i) % VKFFT_MAX_STAGING_ALLOCATIONS;
+			if ((ring->allocationOffset[id] == offset) && (!ring->allocationReleased[id])) {
+				ring->allocationReleased[id] = 1;
+				break;
+			}
+		}
+		while ((ring->numAllocations > 0) && (ring->allocationReleased[ring->first])) {
+			ring->first = (ring->first + 1) % VKFFT_MAX_STAGING_ALLOCATIONS;
+			ring->numAllocations--;
+		}
+		if (ring->numAllocations == 0) ring->head = 0;
+	}
+	static inline VkResult transferDataFromCPU(VkFFTApplication* app, void* arr, VkBuffer* buffer, VkDeviceSize bufferSize) {
 		VkDeviceSize stagingBufferSize = bufferSize;
 		VkBuffer stagingBuffer = { 0 };
-		VkDeviceMemory stagingBufferMemory = { 0 };
-		allocateFFTBuffer(app, &stagingBuffer, &stagingBufferMemory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
-
-		void* data;
-		vkMapMemory(app->configuration.device[0], stagingBufferMemory, 0, stagingBufferSize, 0, &data);
-		memcpy(data, arr, stagingBufferSize);
-		vkUnmapMemory(app->configuration.device[0], stagingBufferMemory);
+		VkFFTMemoryAllocation stagingAllocation = { 0 };
+		VkDeviceSize stagingOffset = 0;
+		VkFFTStagingRing* ring = app->configuration.stagingRing;
+		if ((ring) && (VkFFTStagingRingAllocate(ring, stagingBufferSize, &stagingOffset) == VK_SUCCESS)) {
+			//reuse the mapped staging ring, no allocations
+			stagingBuffer = ring->buffer;
+			memcpy((char*)ring->data + stagingOffset, arr, stagingBufferSize);
+		}
+		else {
+			ring = 0;
+			VkResult res = allocateFFTBuffer(app, &stagingBuffer, &stagingAllocation, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
+			if (res != VK_SUCCESS) return res;
+			if (stagingAllocation.data) {
+				//blocks of the allocator are mapped already
+				memcpy(stagingAllocation.data, arr, stagingBufferSize);
+			}
+			else {
+				void* data;
+				vkMapMemory(app->configuration.device[0], stagingAllocation.memory, 0, stagingBufferSize, 0, &data);
+				memcpy(data, arr, stagingBufferSize);
+				vkUnmapMemory(app->configuration.device[0], stagingAllocation.memory);
+			}
+		}
 		VkCommandBufferAllocateInfo commandBufferAllocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
 		commandBufferAllocateInfo.commandPool = app->configuration.commandPool[0];
 		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -4689,7 +5170,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
 		VkBufferCopy copyRegion = { 0 };
-		copyRegion.srcOffset = 0;
+		copyRegion.srcOffset = stagingOffset;
 		copyRegion.dstOffset = 0;
 		copyRegion.size = stagingBufferSize;
 		vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer[0], 1, &copyRegion);
@@ -4701,8 +5182,403 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		vkWaitForFences(app->configuration.device[0], 1, app->configuration.fence, VK_TRUE, 100000000000);
 		vkResetFences(app->configuration.device[0], 1, app->configuration.fence);
 		vkFreeCommandBuffers(app->configuration.device[0], app->configuration.commandPool[0], 1, &commandBuffer);
-		vkDestroyBuffer(app->configuration.device[0], stagingBuffer, NULL);
-		vkFreeMemory(app->configuration.device[0], stagingBufferMemory, NULL);
+		if (ring) {
+			VkFFTStagingRingRelease(ring, stagingOffset);
+		}
+		else {
+			deleteFFTBuffer(app, &stagingBuffer, &stagingAllocation);
+		}
+		return VK_SUCCESS;
+	}
+	static inline uint64_t VkFFTHashShader(VkFFTShaderCache* cache, const char* code, VkBool32 halfPrecision) {
+		//FNV-1a hash of the shader code, salted with device UUID, driver version and compilation target
+		uint64_t hash = 14695981039346656037ULL;
+		for (const char* c = code; *c; c++) {
+			hash ^= (uint8_t)*c;
+			hash *= 1099511628211ULL;
+		}
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+			hash ^= cache->deviceUUID[i];
+			hash *= 1099511628211ULL;
+		}
+		for (uint32_t i = 0; i < 4; i++) {
+			hash ^= (cache->driverVersion >> (8 * i)) & 0xff;
+			hash *= 1099511628211ULL;
+		}
+		hash ^= halfPrecision;
+		hash *= 1099511628211ULL;
+		return hash;
+	}
+	static inline uint64_t VkFFTHashBytes(const void* data, size_t size) {
+		//64-bit multiply-xorshift hash, independent of the FNV-1a cache key. Used to validate the source and SPIR-V of cache entries
+		const uint8_t* bytes = (const uint8_t*)data;
+		uint64_t hash = 0x9e3779b97f4a7c15ULL ^ size;
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 29;
+		}
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+	static inline void VkFFTShaderCachePath(VkFFTShaderCache* cache, char* path, uint64_t key) {
+		sprintf(path, "%s/%08x%08x.spv", cache->cacheDir, (uint32_t)(key >> 32), (uint32_t)key);
+	}
+	static inline void VkFFTPipelineCachePath(VkFFTShaderCache* cache, char* path) {
+		sprintf(path, "%s/pipeline_cache_", cache->cacheDir);
+		for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+			sprintf(path + strlen(path), "%02x", cache->deviceUUID[i]);
+		sprintf(path + strlen(path), "_%08x.bin", cache->driverVersion);
+	}
+	static inline void VkFFTWriteCacheFile(VkFFTShaderCache* cache, const char* path, const void* header, size_t headerSize, const void* data, size_t dataSize) {
+		//write to a temporary file first, so concurrent processes never see a partially written cache entry. Its name is unique per process, cache and write
+		char tempPath[700];
+#ifdef _WIN32
+		uint32_t pid = (uint32_t)_getpid();
+#else
+		uint32_t pid = (uint32_t)getpid();
+#endif
+		sprintf(tempPath, "%s.%u.%p.%u.tmp", path, pid, (void*)cache, cache->numWrittenFiles++);
+		FILE* file = fopen(tempPath, "wb");
+		if (file == 0) return;
+		size_t written = (headerSize) ? fwrite(header, 1, headerSize, file) : 0;
+		written += fwrite(data, 1, dataSize, file);
+		fclose(file);
+		remove(path);
+		if ((written != headerSize + dataSize) || (rename(tempPath, path) != 0))
+			remove(tempPath);
+	}
+	static inline VkResult VkFFTInitShaderCache(VkFFTShaderCache* cache, VkDevice device, VkPhysicalDevice physicalDevice, const char* cacheDir) {
+		//load serialized VkPipelineCache (if any) and create pipeline cache. Cache key depends on the device UUID and driver version
+		VkPhysicalDeviceProperties physicalDeviceProperties = {};
+		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+		memset(cache, 0, sizeof(VkFFTShaderCache));
+		if (cacheDir) {
+			if (strlen(cacheDir) > 400) return VK_ERROR_INITIALIZATION_FAILED;
+			sprintf(cache->cacheDir, "%s", cacheDir);
+		}
+		memcpy(cache->deviceUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+		cache->driverVersion = physicalDeviceProperties.driverVersion;
+		void* initialData = 0;
+		size_t initialDataSize = 0;
+		if (cache->cacheDir[0]) {
+			char path[600];
+			VkFFTPipelineCachePath(cache, path);
+			FILE* file = fopen(path, "rb");
+			if (file) {
+				fseek(file, 0, SEEK_END);
+				long fileSize = ftell(file);
+				fseek(file, 0, SEEK_SET);
+				if (fileSize > 0) {
+					initialData = malloc(fileSize);
+					initialDataSize = fread(initialData, 1, fileSize, file);
+				}
+				fclose(file);
+			}
+		}
+		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		pipelineCacheCreateInfo.initialDataSize = initialDataSize;
+		pipelineCacheCreateInfo.pInitialData = initialData;
+		VkResult res = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, NULL, &cache->pipelineCache);
+		if (res != VK_SUCCESS) {
+			//driver rejected stored data, start from an empty cache
+			pipelineCacheCreateInfo.initialDataSize = 0;
+			pipelineCacheCreateInfo.pInitialData = 0;
+			res = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, NULL, &cache->pipelineCache);
+		}
+		free(initialData);
+		return res;
+	}
+	static inline VkResult VkFFTSaveShaderCache(VkFFTShaderCache* cache, VkDevice device) {
+		//serialize VkPipelineCache to cacheDir
+		if (!cache->cacheDir[0]) return VK_SUCCESS;
+		size_t dataSize = 0;
+		VkResult res = vkGetPipelineCacheData(device, cache->pipelineCache, &dataSize, NULL);
+		if ((res != VK_SUCCESS) || (dataSize == 0)) return res;
+		void* data = malloc(dataSize);
+		res = vkGetPipelineCacheData(device, cache->pipelineCache, &dataSize, data);
+		if (res == VK_SUCCESS) {
+			char path[600];
+			VkFFTPipelineCachePath(cache, path);
+			VkFFTWriteCacheFile(cache, path, 0, 0, data, dataSize);
+		}
+		free(data);
+		return res;
+	}
+	static inline void VkFFTDestroyShaderCache(VkFFTShaderCache* cache, VkDevice device) {
+		vkDestroyPipelineCache(device, cache->pipelineCache, NULL);
+		cache->pipelineCache = VK_NULL_HANDLE;
+		for (uint32_t i = 0; i < cache->numEntries; i++)
+			free(cache->entryCode[i]);
+		free(cache->entryKeys);
+		free(cache->entryCodeHashes);
+		free(cache->entryCode);
+		free(cache->entrySize);
+		cache->numEntries = 0;
+		cache->entryKeys = 0;
+		cache->entryCodeHashes = 0;
+		cache->entryCode = 0;
+		cache->entrySize = 0;
+	}
+	static inline void VkFFTStoreShaderCacheEntry(VkFFTShaderCache* cache, uint64_t key, uint64_t codeHash, const uint32_t* code, uint32_t size) {
+		//keep a copy of SPIR-V in memory
+		uint32_t* entry = (uint32_t*)malloc(size);
+		if (entry == 0) return;
+		memcpy(entry, code, size);
+		cache->entryKeys = (uint64_t*)realloc(cache->entryKeys, (cache->numEntries + 1) * sizeof(uint64_t));
+		cache->entryCodeHashes = (uint64_t*)realloc(cache->entryCodeHashes, (cache->numEntries + 1) * sizeof(uint64_t));
+		cache->entryCode = (uint32_t**)realloc(cache->entryCode, (cache->numEntries + 1) * sizeof(uint32_t*));
+		cache->entrySize = (uint32_t*)realloc(cache->entrySize, (cache->numEntries + 1) * sizeof(uint32_t));
+		cache->entryKeys[cache->numEntries] = key;
+		cache->entryCodeHashes[cache->numEntries] = codeHash;
+		cache->entryCode[cache->numEntries] = entry;
+		cache->entrySize[cache->numEntries] = size;
+		cache->numEntries++;
+	}
+	static inline VkResult VkFFTCompileShader(VkFFTShaderCache* cache, VkDevice device, const char* code, VkBool32 halfPrecision, VkShaderModule* shaderModule) {
+		//create shader module from GLSL code. If shader cache is provided, SPIR-V is looked up in the cache directory first
+		VkResult res = VK_SUCCESS;
+		VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+		uint64_t key = 0;
+		//magic, version, code length, SPIR-V size in bytes, hash of the whole code and hash of the SPIR-V (low and high words). An entry is used only if all of them match, anything else is compiled again
+		size_t codeLength = strlen(code);
+		uint64_t codeHash = VkFFTHashBytes(code, codeLength);
+		uint32_t header[8] = { 0x53464b56, 2, (uint32_t)codeLength, 0, (uint32_t)codeHash, (uint32_t)(codeHash >> 32), 0, 0 };
+		char path[600];
+		if (cache) {
+			key = VkFFTHashShader(cache, code, halfPrecision);
+			for (uint32_t i = 0; i < cache->numEntries; i++) {
+				if ((cache->entryKeys[i] == key) && (cache->entryCodeHashes[i] == codeHash)) {
+					createInfo.pCode = cache->entryCode[i];
+					createInfo.codeSize = cache->entrySize[i];
+					res = vkCreateShaderModule(device, &createInfo, NULL, shaderModule);
+					if (res == VK_SUCCESS) return res;
+					break;
+				}
+			}
+		}
+		if ((cache) && (cache->cacheDir[0])) {
+			VkFFTShaderCachePath(cache, path, key);
+			FILE* file = fopen(path, "rb");
+			if (file) {
+				uint32_t storedHeader[8];
+				uint32_t* spirv = 0;
+				if ((fread(storedHeader, sizeof(uint32_t), 8, file) == 8) && (memcmp(storedHeader, header, 3 * sizeof(uint32_t)) == 0) && (storedHeader[4] == header[4]) && (storedHeader[5] == header[5]) && (storedHeader[3] >= sizeof(uint32_t)) && (storedHeader[3] % sizeof(uint32_t) == 0)) {
+					spirv = (uint32_t*)malloc(storedHeader[3]);
+					if ((spirv) && (fread(spirv, 1, storedHeader[3], file) == storedHeader[3])) {
+						uint64_t spirvHash = VkFFTHashBytes(spirv, storedHeader[3]);
+						//0x07230203 - SPIR-V magic number
+						if ((spirv[0] != 0x07230203) || (storedHeader[6] != (uint32_t)spirvHash) || (storedHeader[7] != (uint32_t)(spirvHash >> 32))) {
+							free(spirv);
+							spirv = 0;
+						}
+					}
+					else {
+						free(spirv);
+						spirv = 0;
+					}
+				}
+				fclose(file);
+				if (spirv) {
+					createInfo.pCode = spirv;
+					createInfo.codeSize = storedHeader[3];
+					res = vkCreateShaderModule(device, &createInfo, NULL, shaderModule);
+					if (res == VK_SUCCESS) {
+						VkFFTStoreShaderCacheEntry(cache, key, codeHash, spirv, storedHeader[3]);
+						cache->hits++;
+					}
+					free(spirv);
+					if (res == VK_SUCCESS) return res;
+				}
+			}
+		}
+		const glslang_resource_t default_resource = {
+			/* .MaxLights = */ 32,
+			/* .MaxClipPlanes = */ 6,
+			/* .MaxTextureUnits = */ 32,
+			/* .MaxTextureCoords = */ 32,
+			/* .MaxVertexAttribs = */ 64,
+			/* .MaxVertexUniformComponents = */ 4096,
+			/* .MaxVaryingFloats = */ 64,
+			/* .MaxVertexTextureImageUnits = */ 32,
+			/* .MaxCombinedTextureImageUnits = */ 80,
+			/* .MaxTextureImageUnits = */ 32,
+			/* .MaxFragmentUniformComponents = */ 4096,
+			/* .MaxDrawBuffers = */ 32,
+			/* .MaxVertexUniformVectors = */ 128,
+			/* .MaxVaryingVectors = */ 8,
+			/* .MaxFragmentUniformVectors = */ 16,
+			/* .MaxVertexOutputVectors = */ 16,
+			/* .MaxFragmentInputVectors = */ 15,
+			/* .MinProgramTexelOffset = */ -8,
+			/* .MaxProgramTexelOffset = */ 7,
+			/* .MaxClipDistances = */ 8,
+			/* .MaxComputeWorkGroupCountX = */ 65535,
+			/* .MaxComputeWorkGroupCountY = */ 65535,
+			/* .MaxComputeWorkGroupCountZ = */ 65535,
+			/* .MaxComputeWorkGroupSizeX = */ 1024,
+			/* .MaxComputeWorkGroupSizeY = */ 1024,
+			/* .MaxComputeWorkGroupSizeZ = */ 64,
+			/* .MaxComputeUniformComponents = */ 1024,
+			/* .MaxComputeTextureImageUnits = */ 16,
+			/* .MaxComputeImageUniforms = */ 8,
+			/* .MaxComputeAtomicCounters = */ 8,
+			/* .MaxComputeAtomicCounterBuffers = */ 1,
+			/* .MaxVaryingComponents = */ 60,
+			/* .MaxVertexOutputComponents = */ 64,
+			/* .MaxGeometryInputComponents = */ 64,
+			/* .MaxGeometryOutputComponents = */ 128,
+			/* .MaxFragmentInputComponents = */ 128,
+			/* .MaxImageUnits = */ 8,
+			/* .MaxCombinedImageUnitsAndFragmentOutputs = */ 8,
+			/* .MaxCombinedShaderOutputResources = */ 8,
+			/* .MaxImageSamples = */ 0,
+			/* .MaxVertexImageUniforms = */ 0,
+			/* .MaxTessControlImageUniforms = */ 0,
+			/* .MaxTessEvaluationImageUniforms = */ 0,
+			/* .MaxGeometryImageUniforms = */ 0,
+			/* .MaxFragmentImageUniforms = */ 8,
+			/* .MaxCombinedImageUniforms = */ 8,
+			/* .MaxGeometryTextureImageUnits = */ 16,
+			/* .MaxGeometryOutputVertices = */ 256,
+			/* .MaxGeometryTotalOutputComponents = */ 1024,
+			/* .MaxGeometryUniformComponents = */ 1024,
+			/* .MaxGeometryVaryingComponents = */ 64,
+			/* .MaxTessControlInputComponents = */ 128,
+			/* .MaxTessControlOutputComponents = */ 128,
+			/* .MaxTessControlTextureImageUnits = */ 16,
+			/* .MaxTessControlUniformComponents = */ 1024,
+			/* .MaxTessControlTotalOutputComponents = */ 4096,
+			/* .MaxTessEvaluationInputComponents = */ 128,
+			/* .MaxTessEvaluationOutputComponents = */ 128,
+			/* .MaxTessEvaluationTextureImageUnits = */ 16,
+			/* .MaxTessEvaluationUniformComponents = */ 1024,
+			/* .MaxTessPatchComponents = */ 120,
+			/* .MaxPatchVertices = */ 32,
+			/* .MaxTessGenLevel = */ 64,
+			/* .MaxViewports = */ 16,
+			/* .MaxVertexAtomicCounters = */ 0,
+			/* .MaxTessControlAtomicCounters = */ 0,
+			/* .MaxTessEvaluationAtomicCounters = */ 0,
+			/* .MaxGeometryAtomicCounters = */ 0,
+			/* .MaxFragmentAtomicCounters = */ 8,
+			/* .MaxCombinedAtomicCounters = */ 8,
+			/* .MaxAtomicCounterBindings = */ 1,
+			/* .MaxVertexAtomicCounterBuffers = */ 0,
+			/* .MaxTessControlAtomicCounterBuffers = */ 0,
+			/* .MaxTessEvaluationAtomicCounterBuffers = */ 0,
+			/* .MaxGeometryAtomicCounterBuffers = */ 0,
+			/* .MaxFragmentAtomicCounterBuffers = */ 1,
+			/* .MaxCombinedAtomicCounterBuffers = */ 1,
+			/* .MaxAtomicCounterBufferSize = */ 16384,
+			/* .MaxTransformFeedbackBuffers = */ 4,
+			/* .MaxTransformFeedbackInterleavedComponents = */ 64,
+			/* .MaxCullDistances = */ 8,
+			/* .MaxCombinedClipAndCullDistances = */ 8,
+			/* .MaxSamples = */ 4,
+			/* .maxMeshOutputVerticesNV = */ 256,
+			/* .maxMeshOutputPrimitivesNV = */ 512,
+			/* .maxMeshWorkGroupSizeX_NV = */ 32,
+			/* .maxMeshWorkGroupSizeY_NV = */ 1,
+			/* .maxMeshWorkGroupSizeZ_NV = */ 1,
+			/* .maxTaskWorkGroupSizeX_NV = */ 32,
+			/* .maxTaskWorkGroupSizeY_NV = */ 1,
+			/* .maxTaskWorkGroupSizeZ_NV = */ 1,
+			/* .maxMeshViewCountNV = */ 4,
+			/* .maxDualSourceDrawBuffersEXT = */ 1,
+
+			/* .limits = */ {
+				/* .nonInductiveForLoops = */ 1,
+				/* .whileLoops = */ 1,
+				/* .doWhileLoops = */ 1,
+				/* .generalUniformIndexing = */ 1,
+				/* .generalAttributeMatrixVectorIndexing = */ 1,
+				/* .generalVaryingIndexing = */ 1,
+				/* .generalSamplerIndexing = */ 1,
+				/* .generalVariableIndexing = */ 1,
+				/* .generalConstantMatrixVectorIndexing = */ 1,
+			} };
+		glslang_target_client_version_t client_version = (halfPrecision) ? GLSLANG_TARGET_VULKAN_1_1 : GLSLANG_TARGET_VULKAN_1_0;
+		glslang_target_language_version_t target_language_version = (halfPrecision) ? GLSLANG_TARGET_SPV_1_3 : GLSLANG_TARGET_SPV_1_0;
+		const glslang_input_t input =
+		{
+			GLSLANG_SOURCE_GLSL,
+			GLSLANG_STAGE_COMPUTE,
+			GLSLANG_CLIENT_VULKAN,
+			client_version,
+			GLSLANG_TARGET_SPV,
+			target_language_version,
+			code,
+			450,
+			GLSLANG_NO_PROFILE,
+			1,
+			0,
+			GLSLANG_MSG_DEFAULT_BIT,
+			&default_resource,
+		};
+		//printf("%s\n", code);
+		glslang_shader_t* shader = glslang_shader_create(&input);
+		const char* err;
+		if (!glslang_shader_preprocess(shader, &input))
+		{
+			err = glslang_shader_get_info_log(shader);
+			printf("%s\n", code);
+			printf("%s\n", err);
+			glslang_shader_delete(shader);
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		}
+
+		if (!glslang_shader_parse(shader, &input))
+		{
+			err = glslang_shader_get_info_log(shader);
+			printf("%s\n", code);
+			printf("%s\n", err);
+			glslang_shader_delete(shader);
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		}
+		glslang_program_t* program = glslang_program_create();
+		glslang_program_add_shader(program, shader);
+		if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT))
+		{
+			err = glslang_program_get_info_log(program);
+			printf("%s\n", code);
+			printf("%s\n", err);
+			glslang_shader_delete(shader);
+			glslang_program_delete(program);
+			return VK_ERROR_INITIALIZATION_FAILED;
+
+		}
+
+		glslang_program_SPIRV_generate(program, input.stage);
+
+		if (glslang_program_SPIRV_get_messages(program))
+		{
+			printf("%s", glslang_program_SPIRV_get_messages(program));
+		}
+
+		glslang_shader_delete(shader);
+
+		createInfo.pCode = glslang_program_SPIRV_get_ptr(program);
+		createInfo.codeSize = glslang_program_SPIRV_get_size(program) * sizeof(uint32_t);
+		res = vkCreateShaderModule(device, &createInfo, NULL, shaderModule);
+		if (cache) {
+			if (res == VK_SUCCESS) {
+				VkFFTStoreShaderCacheEntry(cache, key, codeHash, createInfo.pCode, (uint32_t)createInfo.codeSize);
+				if (cache->cacheDir[0]) {
+					uint64_t spirvHash = VkFFTHashBytes(createInfo.pCode, createInfo.codeSize);
+					header[3] = (uint32_t)createInfo.codeSize;
+					header[6] = (uint32_t)spirvHash;
+					header[7] = (uint32_t)(spirvHash >> 32);
+					VkFFTWriteCacheFile(cache, path, header, sizeof(header), createInfo.pCode, createInfo.codeSize);
+				}
+			}
+			cache->misses++;
+		}
+		glslang_program_delete(program);
+		return res;
 	}
 	static inline VkResult VkFFTScheduler(VkFFTApplication* app, VkFFTPlan* FFTPlan, uint32_t axis_id, uint32_t supportAxis) {
 		uint32_t complexSize;
@@ -5341,9 +6217,10 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							}
 						}
 					}
-				allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
-				transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
+				VkResult res = allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
+				if (res == VK_SUCCESS) res = transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
 				free(tempLUT);
+				if (res != VK_SUCCESS) return res;
 			}
 			else {
 				if (axis_upload_id > 0)
@@ -5402,9 +6279,10 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							}
 						}
 					}
-				allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
-				transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
+				VkResult res = allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
+				if (res == VK_SUCCESS) res = transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
 				free(tempLUT);
+				if (res != VK_SUCCESS) return res;
 			}
 		}
 		//axis->groupedBatch = ((axis_upload_id>0)&&(axis->groupedBatch > axis->specializationConstants.stageStartSize)) ? axis->specializationConstants.stageStartSize : axis->groupedBatch;
@@ -5737,6 +6615,10 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			axis->specializationConstants.sharedMemSize = app->configuration.sharedMemorySize;
 			axis->specializationConstants.sharedMemSizePow2 = app->configuration.sharedMemorySizePow2;
 			axis->specializationConstants.normalize = 1;
+			axis->specializationConstants.outputCallback = 0;
+			axis->specializationConstants.splitSpectrum = 0;
+			axis->specializationConstants.cropSpectrum = 0;
+			axis->specializationConstants.cropNyquistStride = 0;
 			axis->specializationConstants.size[0] = app->configuration.size[0];
 			axis->specializationConstants.size[1] = app->configuration.size[1];
 			axis->specializationConstants.size[2] = app->configuration.size[2];
@@ -5753,9 +6635,17 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 					axis->specializationConstants.zeropad[0] = app->configuration.performZeropadding[axis_id];
 					axis->specializationConstants.fft_zeropad_left_read[axis_id] = app->configuration.fft_zeropad_left[axis_id];
 					axis->specializationConstants.fft_zeropad_right_read[axis_id] = app->configuration.fft_zeropad_right[axis_id];
+					axis->specializationConstants.splitSpectrum = app->configuration.splitSpectrum;
 				}
 				else
 					axis->specializationConstants.zeropad[0] = 0;
+				if ((app->configuration.cropSpectrum) && (axis_upload_id == 0)) {
+					//Nyquist column of the retained band is column size[0] / 2 of the main block, rows are bufferStride[0] / 2 complex apart
+					axis->specializationConstants.cropSpectrum = 1;
+					axis->specializationConstants.cropShift[axis_id] = app->configuration.bufferStride[axis_id] - app->configuration.size[axis_id];
+					axis->specializationConstants.cropNyquistStride = app->configuration.bufferStride[0] / 2;
+					axis->specializationConstants.inputOffset = app->configuration.size[0] / 2;
+				}
 				if ((!app->configuration.frequencyZeroPadding) && (((!app->configuration.reorderFourStep) && (axis_upload_id == FFTPlan->numSupportAxisUploads[axis_id - 1] - 1)) || ((app->configuration.reorderFourStep) && (axis_upload_id == 0)))) {
 					axis->specializationConstants.zeropad[1] = app->configuration.performZeropadding[axis_id];
 					axis->specializationConstants.fft_zeropad_left_write[axis_id] = app->configuration.fft_zeropad_left[axis_id];
@@ -5831,209 +6721,20 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			char* code0 = (char*)malloc(sizeof(char) * 200000);
 			shaderGenVkFFT(code0, axis->specializationConstants, floatType, floatTypeInputMemory, floatTypeOutputMemory, floatTypeKernelMemory, uintType, type);
 
-			const glslang_resource_t default_resource = {
-				/* .MaxLights = */ 32,
-				/* .MaxClipPlanes = */ 6,
-				/* .MaxTextureUnits = */ 32,
-				/* .MaxTextureCoords = */ 32,
-				/* .MaxVertexAttribs = */ 64,
-				/* .MaxVertexUniformComponents = */ 4096,
-				/* .MaxVaryingFloats = */ 64,
-				/* .MaxVertexTextureImageUnits = */ 32,
-				/* .MaxCombinedTextureImageUnits = */ 80,
-				/* .MaxTextureImageUnits = */ 32,
-				/* .MaxFragmentUniformComponents = */ 4096,
-				/* .MaxDrawBuffers = */ 32,
-				/* .MaxVertexUniformVectors = */ 128,
-				/* .MaxVaryingVectors = */ 8,
-				/* .MaxFragmentUniformVectors = */ 16,
-				/* .MaxVertexOutputVectors = */ 16,
-				/* .MaxFragmentInputVectors = */ 15,
-				/* .MinProgramTexelOffset = */ -8,
-				/* .MaxProgramTexelOffset = */ 7,
-				/* .MaxClipDistances = */ 8,
-				/* .MaxComputeWorkGroupCountX = */ 65535,
-				/* .MaxComputeWorkGroupCountY = */ 65535,
-				/* .MaxComputeWorkGroupCountZ = */ 65535,
-				/* .MaxComputeWorkGroupSizeX = */ 1024,
-				/* .MaxComputeWorkGroupSizeY = */ 1024,
-				/* .MaxComputeWorkGroupSizeZ = */ 64,
-				/* .MaxComputeUniformComponents = */ 1024,
-				/* .MaxComputeTextureImageUnits = */ 16,
-				/* .MaxComputeImageUniforms = */ 8,
-				/* .MaxComputeAtomicCounters = */ 8,
-				/* .MaxComputeAtomicCounterBuffers = */ 1,
-				/* .MaxVaryingComponents = */ 60,
-				/* .MaxVertexOutputComponents = */ 64,
-				/* .MaxGeometryInputComponents = */ 64,
-				/* .MaxGeometryOutputComponents = */ 128,
-				/* .MaxFragmentInputComponents = */ 128,
-				/* .MaxImageUnits = */ 8,
-				/* .MaxCombinedImageUnitsAndFragmentOutputs = */ 8,
-				/* .MaxCombinedShaderOutputResources = */ 8,
-				/* .MaxImageSamples = */ 0,
-				/* .MaxVertexImageUniforms = */ 0,
-				/* .MaxTessControlImageUniforms = */ 0,
-				/* .MaxTessEvaluationImageUniforms = */ 0,
-				/* .MaxGeometryImageUniforms = */ 0,
-				/* .MaxFragmentImageUniforms = */ 8,
-				/* .MaxCombinedImageUniforms = */ 8,
-				/* .MaxGeometryTextureImageUnits = */ 16,
-				/* .MaxGeometryOutputVertices = */ 256,
-				/* .MaxGeometryTotalOutputComponents = */ 1024,
-				/* .MaxGeometryUniformComponents = */ 1024,
-				/* .MaxGeometryVaryingComponents = */ 64,
-				/* .MaxTessControlInputComponents = */ 128,
-				/* .MaxTessControlOutputComponents = */ 128,
-				/* .MaxTessControlTextureImageUnits = */ 16,
-				/* .MaxTessControlUniformComponents = */ 1024,
-				/* .MaxTessControlTotalOutputComponents = */ 4096,
-				/* .MaxTessEvaluationInputComponents = */ 128,
-				/* .MaxTessEvaluationOutputComponents = */ 128,
-				/* .MaxTessEvaluationTextureImageUnits = */ 16,
-				/* .MaxTessEvaluationUniformComponents = */ 1024,
-				/* .MaxTessPatchComponents = */ 120,
-				/* .MaxPatchVertices = */ 32,
-				/* .MaxTessGenLevel = */ 64,
-				/* .MaxViewports = */ 16,
-				/* .MaxVertexAtomicCounters = */ 0,
-				/* .MaxTessControlAtomicCounters = */ 0,
-				/* .MaxTessEvaluationAtomicCounters = */ 0,
-				/* .MaxGeometryAtomicCounters = */ 0,
-				/* .MaxFragmentAtomicCounters = */ 8,
-				/* .MaxCombinedAtomicCounters = */ 8,
-				/* .MaxAtomicCounterBindings = */ 1,
-				/* .MaxVertexAtomicCounterBuffers = */ 0,
-				/* .MaxTessControlAtomicCounterBuffers = */ 0,
-				/* .MaxTessEvaluationAtomicCounterBuffers = */ 0,
-				/* .MaxGeometryAtomicCounterBuffers = */ 0,
-				/* .MaxFragmentAtomicCounterBuffers = */ 1,
-				/* .MaxCombinedAtomicCounterBuffers = */ 1,
-				/* .MaxAtomicCounterBufferSize = */ 16384,
-				/* .MaxTransformFeedbackBuffers = */ 4,
-				/* .MaxTransformFeedbackInterleavedComponents = */ 64,
-				/* .MaxCullDistances = */ 8,
-				/* .MaxCombinedClipAndCullDistances = */ 8,
-				/* .MaxSamples = */ 4,
-				/* .maxMeshOutputVerticesNV = */ 256,
-				/* .maxMeshOutputPrimitivesNV = */ 512,
-				/* .maxMeshWorkGroupSizeX_NV = */ 32,
-				/* .maxMeshWorkGroupSizeY_NV = */ 1,
-				/* .maxMeshWorkGroupSizeZ_NV = */ 1,
-				/* .maxTaskWorkGroupSizeX_NV = */ 32,
-				/* .maxTaskWorkGroupSizeY_NV = */ 1,
-				/* .maxTaskWorkGroupSizeZ_NV = */ 1,
-				/* .maxMeshViewCountNV = */ 4,
-				/* .maxDualSourceDrawBuffersEXT = */ 1,
-
-				/* .limits = */ {
-					/* .nonInductiveForLoops = */ 1,
-					/* .whileLoops = */ 1,
-					/* .doWhileLoops = */ 1,
-					/* .generalUniformIndexing = */ 1,
-					/* .generalAttributeMatrixVectorIndexing = */ 1,
-					/* .generalVaryingIndexing = */ 1,
-					/* .generalSamplerIndexing = */ 1,
-					/* .generalVariableIndexing = */ 1,
-					/* .generalConstantMatrixVectorIndexing = */ 1,
-				} };
-			glslang_target_client_version_t client_version = (app->configuration.halfPrecision) ? GLSLANG_TARGET_VULKAN_1_1 : GLSLANG_TARGET_VULKAN_1_0;
-			glslang_target_language_version_t target_language_version = (app->configuration.halfPrecision) ? GLSLANG_TARGET_SPV_1_3 : GLSLANG_TARGET_SPV_1_0;
-			const glslang_input_t input =
-			{
-				GLSLANG_SOURCE_GLSL,
-				GLSLANG_STAGE_COMPUTE,
-				GLSLANG_CLIENT_VULKAN,
-				client_version,
-				GLSLANG_TARGET_SPV,
-				target_language_version,
-				code0,
-				450,
-				GLSLANG_NO_PROFILE,
-				1,
-				0,
-				GLSLANG_MSG_DEFAULT_BIT,
-				&default_resource,
-			};
-			glslang_optimization_level_t optimization = GLSLANG_OPT_NONE;
-			glslang_shader_t* shader = glslang_shader_create(&input);
-			const char* err;
-			//printf("%s\n", code0);
-			if (!glslang_shader_preprocess(shader, &input))
-			{
-				err = glslang_shader_get_info_log(shader);
-				printf("%s\n", code0);
-				printf("%s\nVkFFT shader type: %d\n", err, type);
-				glslang_shader_delete(shader);
-				free(code0);
-				return VK_ERROR_INITIALIZATION_FAILED;
-
-			}
-
-			if (!glslang_shader_parse(shader, &input))
-			{
-				err = glslang_shader_get_info_log(shader);
-				printf("%s\n", code0);
-				printf("%s\nVkFFT shader type: %d\n", err, type);
-				glslang_shader_delete(shader);
-				free(code0);
-				return VK_ERROR_INITIALIZATION_FAILED;
-
-			}
-			glslang_program_t* program = glslang_program_create();
-			glslang_program_add_shader(program, shader);
-			if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT))
-			{
-				err = glslang_program_get_info_log(program);
-				printf("%s\n", code0);
-				printf("%s\nVkFFT shader type: %d\n", err, type);
-				glslang_shader_delete(shader);
-				free(code0);
-				return VK_ERROR_INITIALIZATION_FAILED;
-
-			}
-
-			glslang_program_SPIRV_generate(program, input.stage);
-
-			if (glslang_program_SPIRV_get_messages(program))
-			{
-				printf("%s", glslang_program_SPIRV_get_messages(program));
-			}
-
-			glslang_shader_delete(shader);
+			VkResult res = VkFFTCompileShader(app->configuration.shaderCache, app->configuration.device[0], code0, app->configuration.halfPrecision, &pipelineShaderStageCreateInfo.module);
 			free(code0);
-			//shaderGenVkFFT(app->configuration.code0, axis->specializationConstants, floatType, floatTypeMemory, uintType, type);
-			//printf("%s\n", app->configuration.code0);
-			/*shaderc_compiler_t compiler = shaderc_compiler_initialize();
-			shaderc_compile_options_t options = shaderc_compile_options_initialize();
-			shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);*/
-			//shaderc_compilation_result_t result = shaderc_compile_into_spv(app->configuration.compiler[0], app->configuration.code0, strlen(app->configuration.code0), shaderc_glsl_default_compute_shader, "file", "main", app->configuration.options[0]);
-			//memset(app->configuration.code0, 0, strlen(app->configuration.code0));
-			//const char* err = shaderc_result_get_error_message(result);
-			//uint32_t* code = (uint32_t*)shaderc_result_get_bytes(result);
-			//uint32_t filelength = shaderc_result_get_length(result);
-			//if (strcmp(err, "")) printf("%s\n", err);
-
-
-			VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-			createInfo.pCode = glslang_program_SPIRV_get_ptr(program);
-			createInfo.codeSize = glslang_program_SPIRV_get_size(program) * sizeof(uint32_t);
-			vkCreateShaderModule(app->configuration.device[0], &createInfo, NULL, &pipelineShaderStageCreateInfo.module);
-			//shaderc_result_release(result);
-			//free(code0);
-			/*shaderc_compile_options_release(options);
-			shaderc_compiler_release(compiler);*/
+			if (res != VK_SUCCESS) {
+				printf("VkFFT shader type: %d\n", type);
+				return res;
+			}
 
 			pipelineShaderStageCreateInfo.pName = "main";
 			pipelineShaderStageCreateInfo.pSpecializationInfo = 0;// &specializationInfo;
 			computePipelineCreateInfo.stage = pipelineShaderStageCreateInfo;
 			computePipelineCreateInfo.layout = axis->pipelineLayout;
 
-
-
-			vkCreateComputePipelines(app->configuration.device[0], VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &axis->pipeline);
+			vkCreateComputePipelines(app->configuration.device[0], (app->configuration.shaderCache) ? app->configuration.shaderCache->pipelineCache : VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &axis->pipeline);
 			vkDestroyShaderModule(app->configuration.device[0], pipelineShaderStageCreateInfo.module, NULL);
-			glslang_program_delete(program);
 		}
 		return VK_SUCCESS;
 
@@ -6240,9 +6941,10 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							}
 						}
 					}
-				allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
-				transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
+				VkResult res = allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
+				if (res == VK_SUCCESS) res = transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
 				free(tempLUT);
+				if (res != VK_SUCCESS) return res;
 			}
 			else {
 				if (axis_upload_id > 0)
@@ -6301,9 +7003,10 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							}
 						}
 					}
-				allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTDeviceMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
-				transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
+				VkResult res = allocateFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTAllocation, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, axis->bufferLUTSize);
+				if (res == VK_SUCCESS) res = transferDataFromCPU(app, tempLUT, &axis->bufferLUT, axis->bufferLUTSize);
 				free(tempLUT);
+				if (res != VK_SUCCESS) return res;
 			}
 		}
 		//axis->groupedBatch = ((axis_upload_id > 0) && (axis->groupedBatch > axis->specializationConstants.stageStartSize)) ? axis->specializationConstants.stageStartSize : axis->groupedBatch;
@@ -7213,6 +7916,13 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			axis->specializationConstants.sharedMemSize = app->configuration.sharedMemorySize;
 			axis->specializationConstants.sharedMemSizePow2 = app->configuration.sharedMemorySizePow2;
 			axis->specializationConstants.normalize = 1;
+			//write-side callback is applied only in the kernel that writes the final inverse FFT result: axis 0 is executed last, its last upload depends on the four step reordering
+			axis->specializationConstants.outputCallback = ((inverse) && (!app->configuration.performConvolution) && (axis_id == 0) && (axis_upload_id == ((app->configuration.reorderFourStep) ? 0 : FFTPlan->numAxisUploads[0] - 1)) && ((app->configuration.outputScale != 0) || (app->configuration.outputClamp))) ? 1 : 0;
+			axis->specializationConstants.outputScale = app->configuration.outputScale;
+			axis->specializationConstants.outputClamp = app->configuration.outputClamp;
+			axis->specializationConstants.splitSpectrum = 0;
+			axis->specializationConstants.cropSpectrum = 0;
+			axis->specializationConstants.cropNyquistStride = 0;
 			axis->specializationConstants.size[0] = app->configuration.size[0];
 			axis->specializationConstants.size[1] = app->configuration.size[1];
 			axis->specializationConstants.size[2] = app->configuration.size[2];
@@ -7230,9 +7940,16 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 					axis->specializationConstants.zeropad[0] = app->configuration.performZeropadding[axis_id];
 					axis->specializationConstants.fft_zeropad_left_read[axis_id] = app->configuration.fft_zeropad_left[axis_id];
 					axis->specializationConstants.fft_zeropad_right_read[axis_id] = app->configuration.fft_zeropad_right[axis_id];
+					//spectrum is read first by the last axis, the other axes read data already written by VkFFT
+					if (axis_id == app->configuration.FFTdim - 1) axis->specializationConstants.splitSpectrum = app->configuration.splitSpectrum;
 				}
 				else
 					axis->specializationConstants.zeropad[0] = 0;
+				if ((app->configuration.cropSpectrum) && (axis_id == app->configuration.FFTdim - 1) && (axis_upload_id == 0)) {
+					axis->specializationConstants.cropSpectrum = 1;
+					axis->specializationConstants.cropShift[0] = (app->configuration.performR2C) ? 0 : app->configuration.bufferStride[0] - app->configuration.size[0];
+					axis->specializationConstants.cropShift[axis_id] = app->configuration.bufferStride[axis_id] - app->configuration.size[axis_id];
+				}
 				if ((!app->configuration.frequencyZeroPadding) && (((!app->configuration.reorderFourStep) && (axis_upload_id == FFTPlan->numAxisUploads[axis_id] - 1)) || ((app->configuration.reorderFourStep) && (axis_upload_id == 0)))) {
 					axis->specializationConstants.zeropad[1] = app->configuration.performZeropadding[axis_id];
 					axis->specializationConstants.fft_zeropad_left_write[axis_id] = app->configuration.fft_zeropad_left[axis_id];
@@ -7318,230 +8035,27 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			axis->specializationConstants.cacheShuffle = (((axis->specializationConstants.fftDim & (axis->specializationConstants.fftDim - 1)) == 0) && (!app->configuration.doublePrecision) && ((type == 0) || (type == 5) || (type == 6))) ? 1 : 0;
 			char* code0 = (char*)malloc(sizeof(char) * 200000);
 			shaderGenVkFFT(code0, axis->specializationConstants, floatType, floatTypeInputMemory, floatTypeOutputMemory, floatTypeKernelMemory, uintType, type);
-			const glslang_resource_t default_resource = {
-				/* .MaxLights = */ 32,
-				/* .MaxClipPlanes = */ 6,
-				/* .MaxTextureUnits = */ 32,
-				/* .MaxTextureCoords = */ 32,
-				/* .MaxVertexAttribs = */ 64,
-				/* .MaxVertexUniformComponents = */ 4096,
-				/* .MaxVaryingFloats = */ 64,
-				/* .MaxVertexTextureImageUnits = */ 32,
-				/* .MaxCombinedTextureImageUnits = */ 80,
-				/* .MaxTextureImageUnits = */ 32,
-				/* .MaxFragmentUniformComponents = */ 4096,
-				/* .MaxDrawBuffers = */ 32,
-				/* .MaxVertexUniformVectors = */ 128,
-				/* .MaxVaryingVectors = */ 8,
-				/* .MaxFragmentUniformVectors = */ 16,
-				/* .MaxVertexOutputVectors = */ 16,
-				/* .MaxFragmentInputVectors = */ 15,
-				/* .MinProgramTexelOffset = */ -8,
-				/* .MaxProgramTexelOffset = */ 7,
-				/* .MaxClipDistances = */ 8,
-				/* .MaxComputeWorkGroupCountX = */ 65535,
-				/* .MaxComputeWorkGroupCountY = */ 65535,
-				/* .MaxComputeWorkGroupCountZ = */ 65535,
-				/* .MaxComputeWorkGroupSizeX = */ 1024,
-				/* .MaxComputeWorkGroupSizeY = */ 1024,
-				/* .MaxComputeWorkGroupSizeZ = */ 64,
-				/* .MaxComputeUniformComponents = */ 1024,
-				/* .MaxComputeTextureImageUnits = */ 16,
-				/* .MaxComputeImageUniforms = */ 8,
-				/* .MaxComputeAtomicCounters = */ 8,
-				/* .MaxComputeAtomicCounterBuffers = */ 1,
-				/* .MaxVaryingComponents = */ 60,
-				/* .MaxVertexOutputComponents = */ 64,
-				/* .MaxGeometryInputComponents = */ 64,
-				/* .MaxGeometryOutputComponents = */ 128,
-				/* .MaxFragmentInputComponents = */ 128,
-				/* .MaxImageUnits = */ 8,
-				/* .MaxCombinedImageUnitsAndFragmentOutputs = */ 8,
-				/* .MaxCombinedShaderOutputResources = */ 8,
-				/* .MaxImageSamples = */ 0,
-				/* .MaxVertexImageUniforms = */ 0,
-				/* .MaxTessControlImageUniforms = */ 0,
-				/* .MaxTessEvaluationImageUniforms = */ 0,
-				/* .MaxGeometryImageUniforms = */ 0,
-				/* .MaxFragmentImageUniforms = */ 8,
-				/* .MaxCombinedImageUniforms = */ 8,
-				/* .MaxGeometryTextureImageUnits = */ 16,
-				/* .MaxGeometryOutputVertices = */ 256,
-				/* .MaxGeometryTotalOutputComponents = */ 1024,
-				/* .MaxGeometryUniformComponents = */ 1024,
-				/* .MaxGeometryVaryingComponents = */ 64,
-				/* .MaxTessControlInputComponents = */ 128,
-				/* .MaxTessControlOutputComponents = */ 128,
-				/* .MaxTessControlTextureImageUnits = */ 16,
-				/* .MaxTessControlUniformComponents = */ 1024,
-				/* .MaxTessControlTotalOutputComponents = */ 4096,
-				/* .MaxTessEvaluationInputComponents = */ 128,
-				/* .MaxTessEvaluationOutputComponents = */ 128,
-				/* .MaxTessEvaluationTextureImageUnits = */ 16,
-				/* .MaxTessEvaluationUniformComponents = */ 1024,
-				/* .MaxTessPatchComponents = */ 120,
-				/* .MaxPatchVertices = */ 32,
-				/* .MaxTessGenLevel = */ 64,
-				/* .MaxViewports = */ 16,
-				/* .MaxVertexAtomicCounters = */ 0,
-				/* .MaxTessControlAtomicCounters = */ 0,
-				/* .MaxTessEvaluationAtomicCounters = */ 0,
-				/* .MaxGeometryAtomicCounters = */ 0,
-				/* .MaxFragmentAtomicCounters = */ 8,
-				/* .MaxCombinedAtomicCounters = */ 8,
-				/* .MaxAtomicCounterBindings = */ 1,
-				/* .MaxVertexAtomicCounterBuffers = */ 0,
-				/* .MaxTessControlAtomicCounterBuffers = */ 0,
-				/* .MaxTessEvaluationAtomicCounterBuffers = */ 0,
-				/* .MaxGeometryAtomicCounterBuffers = */ 0,
-				/* .MaxFragmentAtomicCounterBuffers = */ 1,
-				/* .MaxCombinedAtomicCounterBuffers = */ 1,
-				/* .MaxAtomicCounterBufferSize = */ 16384,
-				/* .MaxTransformFeedbackBuffers = */ 4,
-				/* .MaxTransformFeedbackInterleavedComponents = */ 64,
-				/* .MaxCullDistances = */ 8,
-				/* .MaxCombinedClipAndCullDistances = */ 8,
-				/* .MaxSamples = */ 4,
-				/* .maxMeshOutputVerticesNV = */ 256,
-				/* .maxMeshOutputPrimitivesNV = */ 512,
-				/* .maxMeshWorkGroupSizeX_NV = */ 32,
-				/* .maxMeshWorkGroupSizeY_NV = */ 1,
-				/* .maxMeshWorkGroupSizeZ_NV = */ 1,
-				/* .maxTaskWorkGroupSizeX_NV = */ 32,
-				/* .maxTaskWorkGroupSizeY_NV = */ 1,
-				/* .maxTaskWorkGroupSizeZ_NV = */ 1,
-				/* .maxMeshViewCountNV = */ 4,
-				/* .maxDualSourceDrawBuffersEXT = */ 1,
-
-				/* .limits = */ {
-					/* .nonInductiveForLoops = */ 1,
-					/* .whileLoops = */ 1,
-					/* .doWhileLoops = */ 1,
-					/* .generalUniformIndexing = */ 1,
-					/* .generalAttributeMatrixVectorIndexing = */ 1,
-					/* .generalVaryingIndexing = */ 1,
-					/* .generalSamplerIndexing = */ 1,
-					/* .generalVariableIndexing = */ 1,
-					/* .generalConstantMatrixVectorIndexing = */ 1,
-				} };
-			glslang_target_client_version_t client_version = (app->configuration.halfPrecision) ? GLSLANG_TARGET_VULKAN_1_1 : GLSLANG_TARGET_VULKAN_1_0;
-			glslang_target_language_version_t target_language_version = (app->configuration.halfPrecision) ? GLSLANG_TARGET_SPV_1_3 : GLSLANG_TARGET_SPV_1_0;
-			const glslang_input_t input =
-			{
-				GLSLANG_SOURCE_GLSL,
-				GLSLANG_STAGE_COMPUTE,
-				GLSLANG_CLIENT_VULKAN,
-				client_version,
-				GLSLANG_TARGET_SPV,
-				target_language_version,
-				code0,
-				450,
-				GLSLANG_NO_PROFILE,
-				1,
-				0,
-				GLSLANG_MSG_DEFAULT_BIT,
-				&default_resource,
-			};
-			//printf("%s\n", code0);
-			glslang_shader_t* shader = glslang_shader_create(&input);
-			const char* err;
-			if (!glslang_shader_preprocess(shader, &input))
-			{
-				err = glslang_shader_get_info_log(shader);
-				printf("%s\n", code0);
-				printf("%s\nVkFFT shader type: %d\n", err, type);
-				glslang_shader_delete(shader);
-				free(code0);
-				return VK_ERROR_INITIALIZATION_FAILED;
-
-			}
-
-			if (!glslang_shader_parse(shader, &input))
-			{
-				err = glslang_shader_get_info_log(shader);
-				printf("%s\n", code0);
-				printf("%s\nVkFFT shader type: %d\n", err, type);
-				glslang_shader_delete(shader);
-				free(code0);
-				return VK_ERROR_INITIALIZATION_FAILED;
-
-			}
-			glslang_program_t* program = glslang_program_create();
-			glslang_program_add_shader(program, shader);
-			if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT))
-			{
-				err = glslang_program_get_info_log(program);
-				printf("%s\n", code0);
-				printf("%s\nVkFFT shader type: %d\n", err, type);
-				glslang_shader_delete(shader);
-				free(code0);
-				return VK_ERROR_INITIALIZATION_FAILED;
-
-			}
-
-			glslang_program_SPIRV_generate(program, input.stage);
-
-			if (glslang_program_SPIRV_get_messages(program))
-			{
-				printf("%s", glslang_program_SPIRV_get_messages(program));
-			}
-
-			glslang_shader_delete(shader);
-			/*char strr[20] = "out.comp";
-			FILE* fname;
-			fname = fopen(strr, "w");
-			fprintf(fname, "%s", code0);
-			fclose(fname);
-			char strr2[20] = "out.spv";
-			char strrSum[50];
-			sprintf(strrSum, "glslangValidator.exe -V %s -o %s", strr, strr2);
-			system(strrSum);
-			uint32_t filelength;
-			uint32_t* code = VkFFTReadShader(&filelength, strr2);*/
+			VkResult res = VkFFTCompileShader(app->configuration.shaderCache, app->configuration.device[0], code0, app->configuration.halfPrecision, &pipelineShaderStageCreateInfo.module);
 			free(code0);
-			//shaderGenVkFFT(app->configuration.code0, axis->specializationConstants, floatType, floatTypeMemory, uintType, type);
-			//printf("%s\n", app->configuration.code0);
-			/*shaderc_compiler_t compiler = shaderc_compiler_initialize();
-			shaderc_compile_options_t options = shaderc_compile_options_initialize();
-			shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);*/
-			//shaderc_compilation_result_t result = shaderc_compile_into_spv(app->configuration.compiler[0], app->configuration.code0, strlen(app->configuration.code0), shaderc_glsl_default_compute_shader, "file", "main", app->configuration.options[0]);
-			//memset(app->configuration.code0, 0, strlen(app->configuration.code0));
-			//const char* err = shaderc_result_get_error_message(result);
-			//uint32_t* code = (uint32_t*)shaderc_result_get_bytes(result);
-			//uint32_t filelength = shaderc_result_get_length(result);
-			//if (strcmp(err, "")) printf("%s\n", err);
-			//sprintf(strrSum, "glslangValidator.exe -V %s -o %s", strr, strr2);
-			//system(strrSum);
-			//uint32_t filelength;
-			//uint32_t* code = VkFFTReadShader(&filelength, strr2);
-
-			VkShaderModuleCreateInfo createInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-			createInfo.pCode = glslang_program_SPIRV_get_ptr(program);
-			createInfo.codeSize = glslang_program_SPIRV_get_size(program) * sizeof(uint32_t);
-			vkCreateShaderModule(app->configuration.device[0], &createInfo, NULL, &pipelineShaderStageCreateInfo.module);
-			//shaderc_result_release(result);
-			//free(code0);
-			/*shaderc_compile_options_release(options);
-			shaderc_compiler_release(compiler);*/
+			if (res != VK_SUCCESS) {
+				printf("VkFFT shader type: %d\n", type);
+				return res;
+			}
 
 			pipelineShaderStageCreateInfo.pName = "main";
 			pipelineShaderStageCreateInfo.pSpecializationInfo = 0;// &specializationInfo;
 			computePipelineCreateInfo.stage = pipelineShaderStageCreateInfo;
 			computePipelineCreateInfo.layout = axis->pipelineLayout;
 
-
-
-			vkCreateComputePipelines(app->configuration.device[0], VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &axis->pipeline);
+			vkCreateComputePipelines(app->configuration.device[0], (app->configuration.shaderCache) ? app->configuration.shaderCache->pipelineCache : VK_NULL_HANDLE, 1, &computePipelineCreateInfo, NULL, &axis->pipeline);
 			vkDestroyShaderModule(app->configuration.device[0], pipelineShaderStageCreateInfo.module, NULL);
-			glslang_program_delete(program);
 		}
 
 		return VK_SUCCESS;
 	}
 	static inline void deleteAxis(VkFFTApplication* app, VkFFTAxis* axis) {
 		if (app->configuration.useLUT) {
-			vkDestroyBuffer(app->configuration.device[0], axis->bufferLUT, NULL);
-			vkFreeMemory(app->configuration.device[0], axis->bufferLUTDeviceMemory, NULL);
+			deleteFFTBuffer(app, &axis->bufferLUT, &axis->bufferLUTAllocation);
 		}
 		vkDestroyDescriptorPool(app->configuration.device[0], axis->descriptorPool, NULL);
 		vkDestroyDescriptorSetLayout(app->configuration.device[0], axis->descriptorSetLayout, NULL);
@@ -7549,6 +8063,34 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		vkDestroyPipeline(app->configuration.device[0], axis->pipeline, NULL);
 
 
+	}
+	static inline VkBool32 VkFFTPlanUsesTempBuffer(VkFFTApplication* app) {
+		//four step FFT of an axis transposes through tempBuffer, if reorderFourStep is enabled
+		if (!app->configuration.reorderFourStep) return 0;
+		for (uint32_t i = 0; i < app->configuration.FFTdim; i++) {
+			if (app->localFFTPlan.numAxisUploads[i] > 1) return 1;
+			if ((app->configuration.performR2C) && (i > 0) && (app->localFFTPlan.numSupportAxisUploads[i - 1] > 1)) return 1;
+		}
+		return 0;
+	}
+	static inline VkBool32 VkFFTConfigurationUsesTempBuffer(VkFFTConfiguration configuration, VkPhysicalDevice physicalDevice) {
+		//same as VkFFTPlanUsesTempBuffer for the plan initializeVulkanFFT would create. Only the scheduler is run, so it can be called before the buffers are allocated
+		if (!configuration.reorderFourStep) return 0;
+		VkFFTApplication* app = (VkFFTApplication*)calloc(1, sizeof(VkFFTApplication));
+		if (!app) return 1;
+		VkPhysicalDeviceProperties physicalDeviceProperties = {};
+		vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+		app->configuration = configuration;
+		app->configuration.sharedMemorySizePow2 = (physicalDeviceProperties.limits.maxComputeSharedMemorySize / 32768) * 32768;
+		app->configuration.registerBoost = 1;
+		app->configuration.registerBoost4Step = 1;
+		VkBool32 usesTempBuffer = 0;
+		for (uint32_t i = 0; i < app->configuration.FFTdim; i++) {
+			app->configuration.sharedMemorySize = ((app->configuration.size[i] & (app->configuration.size[i] - 1)) == 0) ? app->configuration.sharedMemorySizePow2 : physicalDeviceProperties.limits.maxComputeSharedMemorySize;
+			if ((VkFFTScheduler(app, &app->localFFTPlan, i, 0) != VK_SUCCESS) || (app->localFFTPlan.numAxisUploads[i] > 1)) usesTempBuffer = 1;
+		}
+		free(app);
+		return usesTempBuffer;
 	}
 	static inline VkResult initializeVulkanFFT(VkFFTApplication* app, VkFFTConfiguration inputLaunchConfiguration) {
 		VkPhysicalDeviceProperties physicalDeviceProperties = {};
@@ -7579,6 +8121,20 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 		app->configuration.registerBoost4Step = 1;
 		//app->configuration.performHalfBandwidthBoost = 0;
 		VkResult res = VK_SUCCESS;
+		if (app->configuration.splitSpectrum) {
+			//in-place read of the compacted spectrum is safe only if the columns it is read from are not written by the first inverse kernel
+			if ((!app->configuration.inverse) || (!app->configuration.frequencyZeroPadding) || (app->configuration.performConvolution) || (app->configuration.FFTdim != 2) || (!app->configuration.performZeropadding[1]))
+				return VK_ERROR_FEATURE_NOT_PRESENT;
+			if ((!app->configuration.performR2C) && (app->configuration.performZeropadding[0]) && (app->configuration.size[0] - app->configuration.fft_zeropad_right[0] > app->configuration.fft_zeropad_right[0] - app->configuration.fft_zeropad_left[0]))
+				return VK_ERROR_FEATURE_NOT_PRESENT;
+		}
+		if (app->configuration.cropSpectrum) {
+			//same for the cropped read: upper columns of the band must not overlap the columns they are written to
+			if ((!app->configuration.inverse) || (app->configuration.frequencyZeroPadding) || (app->configuration.performConvolution) || (app->configuration.FFTdim != 2) || (app->configuration.bufferStride[0] < app->configuration.size[0]) || (app->configuration.bufferStride[1] < app->configuration.size[1]))
+				return VK_ERROR_FEATURE_NOT_PRESENT;
+			if ((!app->configuration.performR2C) && (app->configuration.bufferStride[0] > app->configuration.size[0]) && (app->configuration.bufferStride[0] - app->configuration.size[0] < app->configuration.size[0] - app->configuration.size[0] / 2))
+				return VK_ERROR_FEATURE_NOT_PRESENT;
+		}
 		if (!app->configuration.isCompilerInitialized)
 			glslang_initialize_process();
 		if (app->configuration.performConvolution) {
@@ -7608,6 +8164,8 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 		if (!app->configuration.isCompilerInitialized)
 			glslang_finalize_process();
+		if (((app->configuration.splitSpectrum) || (app->configuration.cropSpectrum)) && ((app->localFFTPlan.numAxisUploads[1] > 1) || ((app->configuration.performR2C) && (app->localFFTPlan.numSupportAxisUploads[0] > 1))))
+			return VK_ERROR_FEATURE_NOT_PRESENT;//four step FFT reads the spectrum in parts, plan has to be deleted
 		return res;
 	}
 	static inline void dispatchEnhanced(VkFFTApplication* app, VkCommandBuffer commandBuffer, VkFFTAxis* axis, uint32_t* dispatchBlock) {
@@ -7628,6 +8186,14 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 			}
 		}
 	}
+	static inline void appendPipelineBarrierVkFFT(VkFFTApplication* app, VkCommandBuffer commandBuffer, VkMemoryBarrier* memory_barrier) {
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, memory_barrier, 0, NULL, 0, NULL);
+		//kernels are separated by barriers, so a timestamp after each barrier marks the end of the kernels recorded before it
+		if (app->timestampQuery) {
+			if (app->timestampQueryPool) vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, app->timestampQueryPool, *app->timestampQuery);
+			(*app->timestampQuery)++;
+		}
+	}
 	static inline void VkFFTAppend(VkFFTApplication* app, VkCommandBuffer commandBuffer) {
 		VkMemoryBarrier memory_barrier = {
 				VK_STRUCTURE_TYPE_MEMORY_BARRIER,
@@ -7675,7 +8241,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 						//if (app->configuration.performZeropadding[2]) dispatchBlock[2] = ceil(dispatchBlock[2] / 2.0);
 						dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 					}
-					vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+					appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 				}
 			}
 
@@ -7708,7 +8274,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 							}
 							if (l > 0)
-								vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+								appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 
@@ -7732,7 +8298,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							//if (app->configuration.performZeropadding[2]) dispatchBlock[2] = ceil(dispatchBlock[2] / 2.0);
 							dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 						}
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 					}
 				}
@@ -7760,7 +8326,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 								}
 								if (l > 0)
-									vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+									appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 							}
 						}
@@ -7783,7 +8349,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 								//if (app->configuration.performZeropadding[2]) dispatchBlock[2] = ceil(dispatchBlock[2] / 2.0);
 								dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 							}
-							vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+							appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -7815,7 +8381,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 							}
 							if (l > 0)
-								vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+								appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -7839,7 +8405,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 
 						}
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 					}
 				}
@@ -7863,7 +8429,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 								}
 								if (l > 0)
-									vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+									appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 							}
 						}
@@ -7884,7 +8450,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 								if (app->configuration.performR2C == 1) dispatchBlock[0] = ceil(dispatchBlock[0] / 2.0);
 								dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 							}
-							vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+							appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -7917,7 +8483,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 								}
 								if (l > 0)
-									vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+									appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 							}
 						}
@@ -7939,7 +8505,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 								if (app->configuration.performR2C == 1) dispatchBlock[0] = ceil(dispatchBlock[0] / 2.0);
 								dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 							}
-							vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+							appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -7966,7 +8532,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 								dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 							}
 							if (l < app->localFFTPlan_inverse_convolution.numSupportAxisUploads[0] - 1)
-								vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+								appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -7989,7 +8555,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 
 						}
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 					}
 				}
@@ -8020,7 +8586,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 								}
 								if (l > 0)
-									vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+									appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 							}
 						}
@@ -8046,7 +8612,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 								dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 
 							}
-							vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+							appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -8087,7 +8653,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							//if (app->configuration.performZeropadding[2]) dispatchBlock[2] = ceil(dispatchBlock[2] / 2.0);
 							dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 						}
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 					}
 				}
@@ -8115,7 +8681,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 
 						}
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 					}
 				}
@@ -8149,7 +8715,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							}
 							if (!app->configuration.reorderFourStep) l = app->localFFTPlan.numSupportAxisUploads[1] - 1 - l;
 							if (l > 0)
-								vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+								appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -8175,7 +8741,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							if (app->configuration.performR2C == 1) dispatchBlock[0] = ceil(dispatchBlock[0] / 2.0);
 							dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 						}
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 						if (!app->configuration.reorderFourStep) l = app->localFFTPlan.numAxisUploads[2] - 1 - l;
 					}
 				}
@@ -8208,7 +8774,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 							}
 							if (!app->configuration.reorderFourStep) l = app->localFFTPlan.numSupportAxisUploads[0] - 1 - l;
 							if (l > 0)
-								vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+								appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 						}
 					}
@@ -8236,7 +8802,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 						}
 						if (!app->configuration.reorderFourStep) l = app->localFFTPlan.numAxisUploads[1] - 1 - l;
 
-						vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+						appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 					}
 				}
@@ -8282,7 +8848,7 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 						dispatchEnhanced(app, commandBuffer, axis, dispatchBlock);
 					}
 					if (!app->configuration.reorderFourStep) l = app->localFFTPlan.numAxisUploads[0] - 1 - l;
-					vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memory_barrier, 0, NULL, 0, NULL);
+					appendPipelineBarrierVkFFT(app, commandBuffer, &memory_barrier);
 
 				}
 			}
@@ -8290,6 +8856,15 @@ layout(std430, binding = %d) readonly buffer DataLUT {\n\
 
 		}
 	}
+	static inline void VkFFTAppendTimestamps(VkFFTApplication* app, VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t* query) {
+		//same as VkFFTAppend, but writes a timestamp to queryPool after each kernel, starting at *query. *query is advanced by the number of written timestamps
+		//with queryPool == VK_NULL_HANDLE nothing is written and only the number of timestamps is counted
+		app->timestampQueryPool = queryPool;
+		app->timestampQuery = query;
+		VkFFTAppend(app, commandBuffer);
+		app->timestampQueryPool = VK_NULL_HANDLE;
+		app->timestampQuery = 0;
+	}
 	static inline void deleteVulkanFFT(VkFFTApplication* app) {
 		for (uint32_t i = 0; i < app->configuration.FFTdim; i++) {
 			for (uint32_t j = 0; j < app->localFFTPlan.numAxisUploads[i]; j++)